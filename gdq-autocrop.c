@@ -0,0 +1,431 @@
+#include <stdlib.h>
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include "gdq-crop.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AUTOCROP_SSE2
+#endif
+
+/*
+ * Black border detection for the "Auto" crop preset.  Every few frames the
+ * target is drawn into a small render target and staged; the copy staged on
+ * the previous capture is mapped, which has long finished by then, so the
+ * graphics thread never waits on the GPU.  The mapped pixels are handed to a
+ * worker thread that looks for the active picture and only reports a new
+ * rect once the same one has been found a few times in a row.
+ */
+
+/* frames between two captures */
+#define AUTOCROP_INTERVAL               15
+/* the reduced copy is at most this large */
+#define AUTOCROP_MAX_WIDTH              640
+#define AUTOCROP_MAX_HEIGHT             480
+/* channel values up to this are border */
+#define AUTOCROP_THRESHOLD              24
+/* a row or column is picture once this fraction of it is not border */
+#define AUTOCROP_MIN_FRACTION           64
+/* detections of the same rect needed before it is reported */
+#define AUTOCROP_STABLE                 3
+
+struct autocrop_surface {
+	gs_stagesurf_t                 *stagesurf;
+	uint32_t                       cx;
+	uint32_t                       cy;
+	uint32_t                       width;
+	uint32_t                       height;
+	bool                           staged;
+};
+
+struct autocrop_image {
+	uint8_t                        *data;
+	size_t                         capacity;
+	uint32_t                       cx;
+	uint32_t                       cy;
+	uint32_t                       width;
+	uint32_t                       height;
+};
+
+struct gdq_autocrop {
+	/* graphics thread */
+	gs_texrender_t                 *texrender;
+	struct autocrop_surface        surfaces[2];
+	size_t                         cur;
+	uint32_t                       frames;
+
+	/* handed from the graphics thread to the worker under mutex */
+	pthread_mutex_t                mutex;
+	struct autocrop_image          pending;
+	bool                           has_pending;
+	struct crop_rect               applied;
+	bool                           has_applied;
+	bool                           changed;
+
+	/* worker thread */
+	pthread_t                      thread;
+	os_event_t                     *event;
+	volatile bool                  stop;
+	struct autocrop_image          work;
+	struct crop_rect               candidate;
+	int                            stable;
+};
+
+
+#ifdef AUTOCROP_SSE2
+static const uint8_t popcount4[16] = {
+	0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+};
+#endif
+
+/* Finds the active picture of an RGBA image: the rows and columns where
+ * enough pixels have a color channel above threshold; alpha is ignored.
+ * rect receives what is border on each edge.  Returns false if the whole
+ * image is border. */
+bool gdq_autocrop_detect(const uint8_t *rgba, uint32_t linesize,
+	uint32_t width, uint32_t height, uint8_t threshold,
+	struct crop_rect *rect)
+{
+	uint32_t min_row = width / AUTOCROP_MIN_FRACTION;
+	uint32_t min_col = height / AUTOCROP_MIN_FRACTION;
+	int32_t *cols;
+	int64_t top = -1;
+	int64_t bottom = -1;
+	int64_t left = -1;
+	int64_t right = -1;
+#ifdef AUTOCROP_SSE2
+	const __m128i thr = _mm_set1_epi8((char)threshold);
+	const __m128i color = _mm_set1_epi32(0x00FFFFFF);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_cmpeq_epi32(zero, zero);
+#endif
+
+	if (!width || !height)
+		return false;
+
+	if (!min_row)
+		min_row = 1;
+	if (!min_col)
+		min_col = 1;
+
+	/* lit pixels per column, counted while the rows are scanned */
+	cols = bzalloc(width * sizeof(*cols));
+
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t *row = rgba + (size_t)y * linesize;
+		uint32_t lit = 0;
+		uint32_t x = 0;
+
+#ifdef AUTOCROP_SSE2
+		for (; x + 4 <= width; x += 4) {
+			__m128i v = _mm_loadu_si128((const __m128i *)(row + x * 4));
+			__m128i over = _mm_and_si128(_mm_subs_epu8(v, thr), color);
+			__m128i dark = _mm_cmpeq_epi32(over, zero);
+			__m128i count = _mm_loadu_si128((const __m128i *)(cols + x));
+			int mask;
+
+			/* dark lanes are all ones, lit lanes count down by -1 */
+			count = _mm_sub_epi32(count, _mm_xor_si128(dark, ones));
+			_mm_storeu_si128((__m128i *)(cols + x), count);
+
+			mask = _mm_movemask_ps(_mm_castsi128_ps(dark));
+			lit += popcount4[~mask & 0xF];
+		}
+#endif
+
+		for (; x < width; x++) {
+			const uint8_t *px = row + x * 4;
+
+			if (px[0] > threshold || px[1] > threshold ||
+				px[2] > threshold) {
+				cols[x]++;
+				lit++;
+			}
+		}
+
+		if (lit >= min_row) {
+			if (top < 0)
+				top = y;
+			bottom = y;
+		}
+	}
+
+	for (uint32_t x = 0; x < width; x++) {
+		if ((uint32_t)cols[x] >= min_col) {
+			if (left < 0)
+				left = x;
+			right = x;
+		}
+	}
+
+	bfree(cols);
+
+	if (top < 0 || left < 0)
+		return false;
+
+	rect->left = (int)left;
+	rect->right = (int)(width - 1 - right);
+	rect->top = (int)top;
+	rect->bottom = (int)(height - 1 - bottom);
+	return true;
+}
+
+
+static int autocrop_scale(int value, uint32_t from, uint32_t to)
+{
+	return (int)(((int64_t)value * to + from / 2) / from);
+}
+
+
+static bool autocrop_close(const struct crop_rect *a,
+	const struct crop_rect *b, int tolerance)
+{
+	return abs(a->left - b->left) <= tolerance &&
+		abs(a->right - b->right) <= tolerance &&
+		abs(a->top - b->top) <= tolerance &&
+		abs(a->bottom - b->bottom) <= tolerance;
+}
+
+
+/* Runs the detection on the image the graphics thread handed over last and
+ * reports a rect once it held still for AUTOCROP_STABLE detections. */
+static void autocrop_process(struct gdq_autocrop *ac)
+{
+	struct autocrop_image *img = &ac->work;
+	struct crop_rect rect;
+	int tolerance;
+
+	if (!gdq_autocrop_detect(img->data, img->cx * 4, img->cx, img->cy,
+		AUTOCROP_THRESHOLD, &rect)) {
+		/* a fade to black says nothing about the borders */
+		ac->stable = 0;
+		return;
+	}
+
+	rect.left = autocrop_scale(rect.left, img->cx, img->width);
+	rect.right = autocrop_scale(rect.right, img->cx, img->width);
+	rect.top = autocrop_scale(rect.top, img->cy, img->height);
+	rect.bottom = autocrop_scale(rect.bottom, img->cy, img->height);
+
+	/* one pixel of the reduced copy */
+	tolerance = (int)((img->width + img->cx - 1) / img->cx);
+
+	if (ac->stable && autocrop_close(&rect, &ac->candidate, tolerance)) {
+		ac->stable++;
+	} else {
+		ac->candidate = rect;
+		ac->stable = 1;
+	}
+
+	if (ac->stable < AUTOCROP_STABLE)
+		return;
+
+	pthread_mutex_lock(&ac->mutex);
+	if (!ac->has_applied ||
+		!autocrop_close(&ac->candidate, &ac->applied, tolerance)) {
+		ac->applied = ac->candidate;
+		ac->has_applied = true;
+		ac->changed = true;
+	}
+	pthread_mutex_unlock(&ac->mutex);
+}
+
+
+static void *autocrop_thread(void *data)
+{
+	struct gdq_autocrop *ac = data;
+	struct autocrop_image swap;
+	bool has_image;
+
+	os_set_thread_name("gdq-autocrop");
+
+	while (os_event_wait(ac->event) == 0) {
+		if (os_atomic_load_bool(&ac->stop))
+			break;
+
+		pthread_mutex_lock(&ac->mutex);
+		has_image = ac->has_pending;
+		if (has_image) {
+			swap = ac->work;
+			ac->work = ac->pending;
+			ac->pending = swap;
+			ac->has_pending = false;
+		}
+		pthread_mutex_unlock(&ac->mutex);
+
+		if (has_image)
+			autocrop_process(ac);
+	}
+
+	return NULL;
+}
+
+
+struct gdq_autocrop *gdq_autocrop_create(void)
+{
+	struct gdq_autocrop *ac = bzalloc(sizeof(*ac));
+
+	if (pthread_mutex_init(&ac->mutex, NULL) != 0)
+		goto fail_mutex;
+	if (os_event_init(&ac->event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail_event;
+	if (pthread_create(&ac->thread, NULL, autocrop_thread, ac) != 0)
+		goto fail_thread;
+
+	return ac;
+
+fail_thread:
+	os_event_destroy(ac->event);
+fail_event:
+	pthread_mutex_destroy(&ac->mutex);
+fail_mutex:
+	bfree(ac);
+	return NULL;
+}
+
+
+void gdq_autocrop_destroy(struct gdq_autocrop *ac)
+{
+	if (!ac)
+		return;
+
+	os_atomic_set_bool(&ac->stop, true);
+	os_event_signal(ac->event);
+	pthread_join(ac->thread, NULL);
+
+	obs_enter_graphics();
+	gs_texrender_destroy(ac->texrender);
+	gs_stagesurface_destroy(ac->surfaces[0].stagesurf);
+	gs_stagesurface_destroy(ac->surfaces[1].stagesurf);
+	obs_leave_graphics();
+
+	os_event_destroy(ac->event);
+	pthread_mutex_destroy(&ac->mutex);
+	bfree(ac->pending.data);
+	bfree(ac->work.data);
+	bfree(ac);
+}
+
+
+/* Copies what the previous capture staged over to the worker. */
+static void autocrop_collect(struct gdq_autocrop *ac,
+	struct autocrop_surface *surf)
+{
+	struct autocrop_image *img = &ac->pending;
+	size_t row = (size_t)surf->cx * 4;
+	uint8_t *data;
+	uint32_t linesize;
+
+	if (!surf->staged)
+		return;
+
+	surf->staged = false;
+	if (!gs_stagesurface_map(surf->stagesurf, &data, &linesize))
+		return;
+
+	pthread_mutex_lock(&ac->mutex);
+
+	if (img->capacity < row * surf->cy) {
+		bfree(img->data);
+		img->capacity = row * surf->cy;
+		img->data = bmalloc(img->capacity);
+	}
+
+	for (uint32_t y = 0; y < surf->cy; y++)
+		memcpy(img->data + y * row, data + (size_t)y * linesize, row);
+
+	img->cx = surf->cx;
+	img->cy = surf->cy;
+	img->width = surf->width;
+	img->height = surf->height;
+	ac->has_pending = true;
+
+	pthread_mutex_unlock(&ac->mutex);
+
+	gs_stagesurface_unmap(surf->stagesurf);
+	os_event_signal(ac->event);
+}
+
+
+/* Called from video_render, before the filter draws; every
+ * AUTOCROP_INTERVAL frames it stages a reduced copy of target. */
+void gdq_autocrop_capture(struct gdq_autocrop *ac, obs_source_t *target,
+	uint32_t width, uint32_t height)
+{
+	struct autocrop_surface *surf;
+	uint32_t div;
+	uint32_t cx;
+	uint32_t cy;
+
+	if (!width || !height || ac->frames++ % AUTOCROP_INTERVAL != 0)
+		return;
+
+	/* the other surface was staged a whole interval ago */
+	autocrop_collect(ac, &ac->surfaces[ac->cur ^ 1]);
+
+	div = (width + AUTOCROP_MAX_WIDTH - 1) / AUTOCROP_MAX_WIDTH;
+	if (div < (height + AUTOCROP_MAX_HEIGHT - 1) / AUTOCROP_MAX_HEIGHT)
+		div = (height + AUTOCROP_MAX_HEIGHT - 1) / AUTOCROP_MAX_HEIGHT;
+	cx = width / div;
+	cy = height / div;
+	if (!cx || !cy)
+		return;
+
+	surf = &ac->surfaces[ac->cur];
+	if (!surf->stagesurf || surf->cx != cx || surf->cy != cy) {
+		gs_stagesurface_destroy(surf->stagesurf);
+		surf->stagesurf = gs_stagesurface_create(cx, cy, GS_RGBA);
+		surf->cx = cx;
+		surf->cy = cy;
+	}
+
+	if (!ac->texrender)
+		ac->texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	else
+		gs_texrender_reset(ac->texrender);
+
+	if (!surf->stagesurf || !gdq_render_region(ac->texrender, target,
+		0.0f, 0.0f, (float)width, (float)height, cx, cy))
+		return;
+
+	gs_stage_texture(surf->stagesurf,
+		gs_texrender_get_texture(ac->texrender));
+	surf->width = width;
+	surf->height = height;
+	surf->staged = true;
+
+	ac->cur ^= 1;
+}
+
+
+/* Takes a rect reported since the last call. */
+bool gdq_autocrop_result(struct gdq_autocrop *ac, struct crop_rect *rect)
+{
+	bool changed;
+
+	pthread_mutex_lock(&ac->mutex);
+	changed = ac->changed;
+	if (changed)
+		*rect = ac->applied;
+	ac->changed = false;
+	pthread_mutex_unlock(&ac->mutex);
+
+	return changed;
+}
+
+
+/* The last rect reported, if there was one. */
+bool gdq_autocrop_last(struct gdq_autocrop *ac, struct crop_rect *rect)
+{
+	bool has_applied;
+
+	pthread_mutex_lock(&ac->mutex);
+	has_applied = ac->has_applied;
+	if (has_applied)
+		*rect = ac->applied;
+	pthread_mutex_unlock(&ac->mutex);
+
+	return has_applied;
+}
@@ -0,0 +1,227 @@
+#include <obs-module.h>
+#include <util/darray.h>
+#include <util/threading.h>
+#include "gdq-crop.h"
+
+/*
+ * Batch preset application.  A layout swap switches the presets (and the
+ * aspects) of several runner feeds at once; doing that with one update per
+ * source from outside lets the feeds land on different frames.  The
+ * module's "gdq_apply_presets" proc takes the whole swap as
+ *
+ *     {"entries": [{"source": <name>, "preset": <name>, "aspect": <aspect>},
+ *                  ...]}
+ *
+ * where the preset or the aspect may be left out, resolves every entry
+ * against the presets and the filters of its source right away, and commits
+ * all the resulting filter updates together from a tick callback, which
+ * runs before any source ticks.  The filters then pick them up in their own
+ * video_tick of that same frame.
+ */
+
+#define S_RESOLUTION                    "resolution"
+
+struct batch_change {
+	obs_weak_source_t              *filter;
+	obs_data_t                     *settings;
+};
+
+struct batch_resolve {
+	const struct crop_rect         *rect;
+	const char                     *aspect_name;
+	const char                     *resolution;
+	size_t                         staged;
+};
+
+static DARRAY(struct batch_change) pending;
+static pthread_mutex_t pending_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool started;
+
+
+static bool batch_is_crop_filter(obs_source_t *filter)
+{
+	const char *id = obs_source_get_id(filter);
+
+	return strcmp(id, "gdq_crop_console_filter") == 0 ||
+		strcmp(id, "gdq_crop_scale_filter") == 0;
+}
+
+
+/* Called with pending_mutex held. */
+static void batch_stage(obs_source_t *filter, obs_data_t *settings)
+{
+	struct batch_change *change = da_push_back_new(pending);
+
+	change->filter = obs_source_get_weak_source(filter);
+	change->settings = settings;
+}
+
+
+/* Called with pending_mutex held. */
+static void batch_resolve_filter(obs_source_t *parent, obs_source_t *filter,
+	void *param)
+{
+	struct batch_resolve *resolve = param;
+	obs_data_t *settings = NULL;
+
+	if (batch_is_crop_filter(filter)) {
+		settings = obs_data_create();
+
+		if (resolve->rect) {
+			obs_data_set_int(settings, "left", resolve->rect->left);
+			obs_data_set_int(settings, "right", resolve->rect->right);
+			obs_data_set_int(settings, "top", resolve->rect->top);
+			obs_data_set_int(settings, "bottom",
+				resolve->rect->bottom);
+		}
+
+		/* only the console filter lists aspects; the crop-scale
+		 * filter's resolution is a size of its own */
+		if (resolve->aspect_name && strcmp(obs_source_get_id(filter),
+			"gdq_crop_console_filter") == 0)
+			obs_data_set_string(settings, S_RESOLUTION,
+				resolve->aspect_name);
+
+	} else if (resolve->resolution && gdq_is_scale_filter(filter)) {
+		settings = obs_data_create();
+		obs_data_set_string(settings, S_RESOLUTION,
+			resolve->resolution);
+	}
+
+	if (settings) {
+		batch_stage(filter, settings);
+		resolve->staged++;
+	}
+
+	UNUSED_PARAMETER(parent);
+}
+
+
+/* Stages the filter updates for one entry; returns how many there are. */
+static size_t batch_resolve_entry(obs_data_t *entry)
+{
+	const char *name = obs_data_get_string(entry, "source");
+	const char *preset = obs_data_get_string(entry, "preset");
+	const char *aspect = obs_data_get_string(entry, "aspect");
+	struct batch_resolve resolve = {0};
+	struct crop_rect rect = {0};
+	obs_source_t *source;
+
+	if (*preset && (strcmp(preset, "None") == 0 ||
+		gdq_presets_find(preset, &rect)))
+		resolve.rect = &rect;
+	else if (*preset)
+		GDQ_LOG(LOG_WARNING, "gdq_apply_presets: no preset '%s'", preset);
+
+	if (*aspect) {
+		resolve.aspect_name = gdq_aspect_name(aspect);
+		resolve.resolution = gdq_aspect_resolution(aspect);
+		if (!resolve.aspect_name)
+			GDQ_LOG(LOG_WARNING, "gdq_apply_presets: no aspect '%s'",
+				aspect);
+	}
+
+	if (!resolve.rect && !resolve.aspect_name)
+		return 0;
+
+	source = obs_get_source_by_name(name);
+	if (!source) {
+		GDQ_LOG(LOG_WARNING, "gdq_apply_presets: no source '%s'", name);
+		return 0;
+	}
+
+	obs_source_enum_filters(source, batch_resolve_filter, &resolve);
+	obs_source_release(source);
+
+	return resolve.staged;
+}
+
+
+/* void gdq_apply_presets(in string entries, out int staged) */
+static void batch_apply_proc(void *data, calldata_t *cd)
+{
+	const char *json = calldata_string(cd, "entries");
+	obs_data_t *request = json ? obs_data_create_from_json(json) : NULL;
+	obs_data_array_t *entries = obs_data_get_array(request, "entries");
+	size_t count = obs_data_array_count(entries);
+	size_t staged = 0;
+
+	/* staged as a whole, so a tick never commits half a call */
+	pthread_mutex_lock(&pending_mutex);
+
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *entry = obs_data_array_item(entries, i);
+
+		staged += batch_resolve_entry(entry);
+		obs_data_release(entry);
+	}
+
+	pthread_mutex_unlock(&pending_mutex);
+
+	calldata_set_int(cd, "staged", (long long)staged);
+
+	obs_data_array_release(entries);
+	obs_data_release(request);
+	UNUSED_PARAMETER(data);
+}
+
+
+static void batch_tick(void *param, float seconds)
+{
+	struct batch_change *changes;
+	size_t count;
+
+	pthread_mutex_lock(&pending_mutex);
+	changes = pending.array;
+	count = pending.num;
+	da_init(pending);
+	pthread_mutex_unlock(&pending_mutex);
+
+	if (!count)
+		return;
+
+	for (size_t i = 0; i < count; i++) {
+		obs_source_t *filter =
+			obs_weak_source_get_source(changes[i].filter);
+
+		/* a filter removed since the call is skipped */
+		if (filter) {
+			obs_source_update(filter, changes[i].settings);
+			obs_source_release(filter);
+		}
+
+		obs_weak_source_release(changes[i].filter);
+		obs_data_release(changes[i].settings);
+	}
+
+	GDQ_LOG(LOG_DEBUG, "applied %zu staged filter updates", count);
+	bfree(changes);
+
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(seconds);
+}
+
+
+void gdq_batch_init(void)
+{
+	proc_handler_add(obs_get_proc_handler(),
+		"void gdq_apply_presets(in string entries, out int staged)",
+		batch_apply_proc, NULL);
+	obs_add_tick_callback(batch_tick, NULL);
+	started = true;
+}
+
+
+void gdq_batch_free(void)
+{
+	if (started) {
+		obs_remove_tick_callback(batch_tick, NULL);
+		started = false;
+	}
+
+	for (size_t i = 0; i < pending.num; i++) {
+		obs_weak_source_release(pending.array[i].filter);
+		obs_data_release(pending.array[i].settings);
+	}
+	da_free(pending);
+}
@@ -0,0 +1,295 @@
+#include <obs-module.h>
+#include <util/threading.h>
+#include "gdq-crop.h"
+
+/*
+ * Module-wide output cache.  The same feed with the same crop tends to be in
+ * several scenes at once, and every one of them used to render its own copy
+ * each frame.  Filter instances now acquire an entry keyed by what their
+ * output depends on (target, crop rect, output size and scale technique);
+ * identical instances share the entry, the first one drawn in a frame
+ * renders into it and the rest draw the texture it left behind.
+ *
+ * The render target of an entry is borrowed from the pool (gdq-pool.c) and
+ * handed back once the entry has not been drawn for a while.
+ *
+ * Entries are found through a hash of the key, so a filter changing its
+ * crop costs the same with a thousand instances as with one.
+ */
+
+/* entries not drawn for this long give their target back to the pool */
+#define CACHE_MAX_IDLE_NS               1000000000ULL
+
+/* how often idle entries are looked for */
+#define CACHE_SWEEP_NS                  (CACHE_MAX_IDLE_NS / 4)
+
+#define CACHE_MIN_BUCKETS               16
+
+struct gdq_cache_entry {
+	struct gdq_cache_key           key;
+	struct gdq_target              *target;
+	volatile long                  refs;
+
+	/* only touched from video_render */
+	uint64_t                       frame_time;
+	uint32_t                       uses;
+	uint32_t                       prev_uses;
+	bool                           rendered;
+	bool                           valid;
+
+	struct gdq_cache_entry         *next;
+};
+
+/* chained; the bucket count is a power of two, at least the entry count */
+static struct gdq_cache_entry **buckets;
+static size_t bucket_count;
+static size_t entry_count;
+static uint64_t last_sweep;
+static pthread_mutex_t entries_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+void gdq_cache_key_init(struct gdq_cache_key *key, const char *kind,
+	obs_source_t *target)
+{
+	*key = (struct gdq_cache_key){0};
+	key->kind = kind;
+	key->target = target;
+}
+
+
+/* FNV-1a, field by field so padding never counts */
+static uint32_t hash_bytes(uint32_t hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = data;
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+#define HASH_FIELD(hash, key, field) \
+	hash_bytes(hash, &(key)->field, sizeof((key)->field))
+
+static uint32_t key_hash(const struct gdq_cache_key *key)
+{
+	uint32_t hash = 2166136261u;
+
+	hash = HASH_FIELD(hash, key, kind);
+	hash = HASH_FIELD(hash, key, target);
+	hash = HASH_FIELD(hash, key, left);
+	hash = HASH_FIELD(hash, key, right);
+	hash = HASH_FIELD(hash, key, top);
+	hash = HASH_FIELD(hash, key, bottom);
+	hash = HASH_FIELD(hash, key, cx);
+	hash = HASH_FIELD(hash, key, cy);
+	hash = HASH_FIELD(hash, key, variant);
+	hash = HASH_FIELD(hash, key, flags);
+	return hash;
+}
+
+#undef HASH_FIELD
+
+
+static bool key_equal(const struct gdq_cache_key *a,
+	const struct gdq_cache_key *b)
+{
+	return a->kind == b->kind && a->target == b->target &&
+		a->left == b->left && a->right == b->right &&
+		a->top == b->top && a->bottom == b->bottom &&
+		a->cx == b->cx && a->cy == b->cy &&
+		a->variant == b->variant && a->flags == b->flags;
+}
+
+
+static struct gdq_cache_entry **cache_bucket(const struct gdq_cache_key *key)
+{
+	return &buckets[key_hash(key) & (bucket_count - 1)];
+}
+
+
+static void cache_grow(void)
+{
+	struct gdq_cache_entry **old = buckets;
+	size_t old_count = bucket_count;
+
+	bucket_count = bucket_count ? bucket_count * 2 : CACHE_MIN_BUCKETS;
+	buckets = bzalloc(bucket_count * sizeof(*buckets));
+
+	for (size_t i = 0; i < old_count; i++) {
+		while (old[i]) {
+			struct gdq_cache_entry *entry = old[i];
+			struct gdq_cache_entry **bucket =
+				cache_bucket(&entry->key);
+
+			old[i] = entry->next;
+			entry->next = *bucket;
+			*bucket = entry;
+		}
+	}
+
+	bfree(old);
+}
+
+
+struct gdq_cache_entry *gdq_cache_acquire(const struct gdq_cache_key *key)
+{
+	struct gdq_cache_entry *entry = NULL;
+	struct gdq_cache_entry **bucket;
+
+	pthread_mutex_lock(&entries_mutex);
+
+	if (bucket_count) {
+		for (entry = *cache_bucket(key); entry; entry = entry->next) {
+			if (key_equal(&entry->key, key))
+				break;
+		}
+	}
+
+	if (!entry) {
+		if (entry_count >= bucket_count)
+			cache_grow();
+
+		bucket = cache_bucket(key);
+		entry = bzalloc(sizeof(*entry));
+		entry->key = *key;
+		entry->next = *bucket;
+		*bucket = entry;
+		entry_count++;
+	}
+
+	os_atomic_inc_long(&entry->refs);
+
+	pthread_mutex_unlock(&entries_mutex);
+	return entry;
+}
+
+
+void gdq_cache_release(struct gdq_cache_entry *entry)
+{
+	struct gdq_cache_entry **prev;
+	bool last;
+
+	if (!entry)
+		return;
+
+	pthread_mutex_lock(&entries_mutex);
+
+	last = os_atomic_dec_long(&entry->refs) == 0;
+	if (last) {
+		for (prev = cache_bucket(&entry->key); *prev != entry;
+			prev = &(*prev)->next)
+			;
+		*prev = entry->next;
+
+		if (--entry_count == 0) {
+			bfree(buckets);
+			buckets = NULL;
+			bucket_count = 0;
+		}
+	}
+
+	pthread_mutex_unlock(&entries_mutex);
+
+	if (!last)
+		return;
+
+	/* serializes with a render that may still be drawing from it */
+	obs_enter_graphics();
+	gdq_pool_release(entry->target);
+	obs_leave_graphics();
+
+	bfree(entry);
+}
+
+
+/* Hands the targets of entries that are no longer drawn back to the pool;
+ * runs on the graphics thread, a few times per idle period rather than every
+ * frame. */
+static void cache_sweep(uint64_t frame_time)
+{
+	struct gdq_cache_entry *entry;
+
+	pthread_mutex_lock(&entries_mutex);
+
+	if (frame_time - last_sweep >= CACHE_SWEEP_NS) {
+		last_sweep = frame_time;
+
+		for (size_t i = 0; i < bucket_count; i++) {
+			for (entry = buckets[i]; entry; entry = entry->next) {
+				if (!entry->target ||
+					frame_time - entry->frame_time <
+					CACHE_MAX_IDLE_NS)
+					continue;
+
+				gdq_pool_release(entry->target);
+				entry->target = NULL;
+				entry->valid = false;
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&entries_mutex);
+}
+
+
+gs_texture_t *gdq_cache_lookup(struct gdq_cache_entry *entry)
+{
+	uint64_t frame_time = obs_get_video_frame_time();
+
+	cache_sweep(frame_time);
+
+	if (entry->frame_time != frame_time) {
+		entry->frame_time = frame_time;
+		entry->prev_uses = entry->uses;
+		entry->uses = 0;
+		entry->rendered = false;
+	}
+
+	entry->uses++;
+
+	return entry->rendered ?
+		gs_texrender_get_texture(entry->target->texrender) : NULL;
+}
+
+
+bool gdq_cache_shared(const struct gdq_cache_entry *entry)
+{
+	return os_atomic_load_long(&entry->refs) > 1 || entry->prev_uses > 1;
+}
+
+
+/* Returns a target of the size in the key, ready for gs_texrender_begin. */
+gs_texrender_t *gdq_cache_begin(struct gdq_cache_entry *entry)
+{
+	if (!entry->target)
+		entry->target = gdq_pool_acquire(entry->key.cx, entry->key.cy,
+			GS_RGBA);
+	else
+		gs_texrender_reset(entry->target->texrender);
+
+	entry->valid = false;
+	return entry->target->texrender;
+}
+
+
+gs_texture_t *gdq_cache_end(struct gdq_cache_entry *entry)
+{
+	entry->rendered = true;
+	entry->valid = true;
+	return gs_texrender_get_texture(entry->target->texrender);
+}
+
+
+/* Keeps whatever was last rendered into the entry as this frame's output,
+ * for filters whose source has not changed since. */
+gs_texture_t *gdq_cache_reuse(struct gdq_cache_entry *entry)
+{
+	if (!entry->valid)
+		return NULL;
+
+	entry->rendered = true;
+	return gs_texrender_get_texture(entry->target->texrender);
+}
@@ -0,0 +1,692 @@
+#include <obs-module.h>
+#include <graphics/vec2.h>
+#include <graphics/math-defs.h>
+#include <util/dstr.h>
+#include <util/profiler.h>
+#include <util/threading.h>
+#include "gdq-crop.h"
+
+/*
+ * Crop and scale in a single pass.  The parent is rendered once into the
+ * filter texture and crop_lanczos_scale.effect maps the output quad onto the
+ * cropped sub-rect (mul_val/add_val) while resampling it, so a feed costs one
+ * render target and one draw instead of gdq_crop_console_filter followed by
+ * a scale filter.
+ */
+
+#define S_RESOLUTION                    "resolution"
+#define S_SAMPLING                      "sampling"
+#define S_LANCZOS_RADIUS                "lanczos_radius"
+
+#define T_RESOLUTION                    obs_module_text("Resolution")
+#define T_SAMPLING                      obs_module_text("ScaleFiltering")
+#define T_SAMPLING_POINT                obs_module_text("ScaleFiltering.Point")
+#define T_SAMPLING_BILINEAR             obs_module_text("ScaleFiltering.Bilinear")
+#define T_SAMPLING_BICUBIC              obs_module_text("ScaleFiltering.Bicubic")
+#define T_SAMPLING_LANCZOS              obs_module_text("ScaleFiltering.Lanczos")
+#define T_SAMPLING_LANCZOS_SEPARABLE    obs_module_text("ScaleFiltering.LanczosSeparable")
+#define T_SAMPLING_AREA                 obs_module_text("ScaleFiltering.Area")
+#define T_SAMPLING_SHARP_BILINEAR       obs_module_text("ScaleFiltering.SharpBilinear")
+#define T_NONE                          obs_module_text("None")
+#define T_LANCZOS_RADIUS                obs_module_text("LanczosRadius")
+#define T_LANCZOS_RADIUS_2              obs_module_text("LanczosRadius.2")
+#define T_LANCZOS_RADIUS_3              obs_module_text("LanczosRadius.3")
+#define T_LANCZOS_RADIUS_4              obs_module_text("LanczosRadius.4")
+
+#define S_SAMPLING_POINT                "point"
+#define S_SAMPLING_BILINEAR             "bilinear"
+#define S_SAMPLING_BICUBIC              "bicubic"
+#define S_SAMPLING_LANCZOS              "lanczos"
+#define S_SAMPLING_LANCZOS_SEPARABLE    "lanczos_separable"
+#define S_SAMPLING_AREA                 "area"
+#define S_SAMPLING_SHARP_BILINEAR       "sharp_bilinear"
+
+/* layout of the weights texture, see crop_lanczos_scale.effect */
+#define LUT_PHASES                      64
+#define LUT_TAPS                        8
+
+static const char *lanczos_techniques[3][3] = {
+	{"DrawLanczos2", "DrawLanczos2H", "DrawLanczos2V"},
+	{"DrawLanczos3", "DrawLanczos3H", "DrawLanczos3V"},
+	{"DrawLanczos4", "DrawLanczos4H", "DrawLanczos4V"},
+};
+
+/* the profiler tells scopes apart by the name's address */
+static const char *crop_scale_tick_name = "gdq_crop_scale_filter_tick";
+static const char *crop_scale_render_name = "gdq_crop_scale_filter_render";
+
+struct crop_scale_filter_data {
+	obs_source_t                    *context;
+
+	gs_effect_t                     *effect;
+	gs_eparam_t                     *param_mul;
+	gs_eparam_t                     *param_add;
+	gs_eparam_t                     *image_param;
+	gs_eparam_t                     *dimension_param;
+	gs_eparam_t                     *weights_param;
+	gs_eparam_t                     *footprint_param;
+	gs_eparam_t                     *prescale_param;
+	gs_samplerstate_t               *point_sampler;
+	gs_texture_t                    *weights;
+	struct gdq_cache_entry          *output;
+	struct gdq_frame_state          frames;
+	struct gdq_profile              *profile;
+	struct gdq_counters             *counters;
+
+	int                             left;
+	int                             right;
+	int                             top;
+	int                             bottom;
+
+	int                             cx_in;
+	int                             cy_in;
+	bool                            aspect_ratio_only;
+	bool                            valid;
+	enum obs_scale_type             sampling;
+	bool                            force_separable;
+	bool                            sharp;
+	int                             radius;
+
+	uint32_t                        cx_target;
+	uint32_t                        cy_target;
+	uint32_t                        cx_crop;
+	uint32_t                        cy_crop;
+	int                             cx_out;
+	int                             cy_out;
+	struct vec2                     mul_val;
+	struct vec2                     add_val;
+	struct vec2                     dimension_i;
+	struct vec2                     footprint;
+	struct vec2                     prescale;
+	const char                      *technique;
+	const char                      *technique_h;
+	const char                      *technique_v;
+	bool                            lanczos;
+	bool                            separable;
+
+	float                           lut[2 * LUT_PHASES * LUT_TAPS];
+	bool                            lut_dirty;
+	bool                            target_valid;
+	volatile bool                   dirty;
+};
+
+static const char *crop_scale_filter_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("GDQCropScaleFilter");
+}
+
+static void crop_scale_filter_update(void *data, obs_data_t *settings)
+{
+	struct crop_scale_filter_data *filter = data;
+
+	const char *res_str = obs_data_get_string(settings, S_RESOLUTION);
+	const char *sampling = obs_data_get_string(settings, S_SAMPLING);
+
+	os_atomic_set_bool(&filter->dirty, true);
+
+	filter->left = (int)obs_data_get_int(settings, "left");
+	filter->top = (int)obs_data_get_int(settings, "top");
+	filter->right = (int)obs_data_get_int(settings, "right");
+	filter->bottom = (int)obs_data_get_int(settings, "bottom");
+
+	if ((filter->left == 0) &&
+		(filter->top == 0) &&
+		(filter->right == 0) &&
+		(filter->bottom == 0)) {
+		obs_data_set_string(settings, "console", "None");
+	}
+	else {
+		obs_data_set_string(settings, "console", "Custom");
+	}
+
+	filter->valid = scale_parse_resolution(res_str,
+			&filter->cx_in, &filter->cy_in,
+			&filter->aspect_ratio_only);
+	filter->force_separable =
+		astrcmpi(sampling, S_SAMPLING_LANCZOS_SEPARABLE) == 0;
+	filter->sharp = astrcmpi(sampling, S_SAMPLING_SHARP_BILINEAR) == 0;
+	filter->sampling = filter->force_separable ?
+		OBS_SCALE_LANCZOS : scale_parse_sampling(sampling);
+	if (filter->sharp)
+		filter->sampling = OBS_SCALE_BILINEAR;
+
+	filter->radius = (int)obs_data_get_int(settings, S_LANCZOS_RADIUS);
+	if (filter->radius < 2 || filter->radius > 4)
+		filter->radius = 3;
+
+	gdq_frame_state_update(&filter->frames, settings);
+}
+
+static void crop_scale_filter_destroy(void *data)
+{
+	struct crop_scale_filter_data *filter = data;
+
+	obs_enter_graphics();
+	gs_samplerstate_destroy(filter->point_sampler);
+	gs_texture_destroy(filter->weights);
+	obs_leave_graphics();
+
+	gdq_cache_release(filter->output);
+	gdq_effect_unref(GDQ_EFFECT_CROP_SCALE);
+	gdq_profile_destroy(filter->profile);
+	gdq_counters_destroy(filter->counters);
+
+	bfree(filter);
+}
+
+static void *crop_scale_filter_create(obs_data_t *settings,
+		obs_source_t *context)
+{
+	struct crop_scale_filter_data *filter =
+		bzalloc(sizeof(struct crop_scale_filter_data));
+	struct gs_sampler_info sampler_info = {0};
+	const struct gdq_effect *effect =
+		gdq_effect_ref(GDQ_EFFECT_CROP_SCALE);
+
+	filter->context = context;
+
+	if (!effect) {
+		bfree(filter);
+		return NULL;
+	}
+
+	filter->effect = effect->effect;
+	filter->param_mul = effect->mul_val;
+	filter->param_add = effect->add_val;
+	filter->image_param = effect->image;
+	filter->dimension_param = effect->base_dimension_i;
+	filter->weights_param = effect->weights;
+	filter->footprint_param = effect->area_footprint;
+	filter->prescale_param = effect->sharp_prescale;
+
+	obs_enter_graphics();
+	filter->point_sampler = gs_samplerstate_create(&sampler_info);
+	obs_leave_graphics();
+
+	gdq_frame_state_init(&filter->frames, context);
+	filter->profile = gdq_profile_create(context);
+	filter->counters = gdq_counters_create(context,
+		"gdq_crop_scale_filter");
+	crop_scale_filter_update(filter, settings);
+	return filter;
+}
+
+/* Matches the kernel widening the original shader derived from the
+ * projection when the output is drawn unscaled. */
+static double lanczos_kernel_scale(uint32_t src, int dst)
+{
+	double clip = 2.0 * (double)src / (double)dst - 1.0;
+
+	if (fabs(clip) <= EPSILON)
+		return 1.0;
+
+	return fmin(0.25 + fabs(0.75 / clip), 1.0);
+}
+
+static double lanczos_weight(double x, int radius)
+{
+	double pix;
+
+	if (x == 0.0)
+		return 1.0;
+	if (fabs(x) >= (double)radius)
+		return 0.0;
+
+	pix = M_PI * x;
+	return (double)radius * sin(pix) * sin(pix / (double)radius) /
+		(pix * pix);
+}
+
+/* One row per phase: the normalized weight of each of the 2 * radius taps
+ * around a sample point that sits (phase + 0.5) / LUT_PHASES past a texel. */
+static void lanczos_build_lut(float *lut, int radius, double scale)
+{
+	for (int p = 0; p < LUT_PHASES; p++) {
+		double f = ((double)p + 0.5) / (double)LUT_PHASES;
+		double taps[LUT_TAPS] = {0};
+		double sum = 0.0;
+
+		for (int j = 0; j < 2 * radius; j++) {
+			double d = (double)(j - radius + 1) - f;
+			taps[j] = lanczos_weight(d * scale, radius);
+			sum += taps[j];
+		}
+
+		for (int j = 0; j < LUT_TAPS; j++)
+			lut[p * LUT_TAPS + j] = (float)(taps[j] / sum);
+	}
+}
+
+/* 4 * radius^2 taps in one pass against 2 * radius taps at crop height plus
+ * 2 * radius taps at output height; the intermediate write and read is
+ * counted as two taps. */
+static bool lanczos_separable_cheaper(int radius, uint32_t cy_crop,
+		int cx_out, int cy_out)
+{
+	uint64_t taps = 2ULL * radius;
+	uint64_t single = taps * taps * cx_out * cy_out;
+	uint64_t separable = (taps + 2) * cx_out * cy_crop +
+		taps * cx_out * cy_out;
+
+	return separable < single;
+}
+
+/* Recomputes the crop rect, output size and technique; only called when the
+ * settings or the target size changed. */
+static void crop_scale_filter_calc(struct crop_scale_filter_data *filter,
+		uint32_t cx, uint32_t cy)
+{
+	bool lower_than_2x;
+
+	filter->cx_out = 0;
+	filter->cy_out = 0;
+
+	gdq_calc_crop(cx, cy,
+		filter->left, filter->right, filter->top, filter->bottom,
+		&filter->cx_crop, &filter->cy_crop,
+		&filter->mul_val, &filter->add_val);
+
+	filter->target_valid = filter->cx_crop && filter->cy_crop;
+	if (!filter->target_valid)
+		return;
+
+	/* an invalid or already matching resolution only crops */
+	if (!filter->valid ||
+	    !scale_calc_output_size(filter->cx_crop, filter->cy_crop,
+				filter->cx_in, filter->cy_in,
+				filter->aspect_ratio_only,
+				&filter->cx_out, &filter->cy_out)) {
+		filter->cx_out = filter->cx_crop;
+		filter->cy_out = filter->cy_crop;
+	}
+
+	vec2_set(&filter->dimension_i,
+			1.0f / (float)cx,
+			1.0f / (float)cy);
+	vec2_set(&filter->footprint,
+			(float)filter->cx_crop / (float)filter->cx_out,
+			(float)filter->cy_crop / (float)filter->cy_out);
+	vec2_set(&filter->prescale,
+			fmaxf(floorf((float)filter->cx_out /
+					(float)filter->cx_crop), 1.0f),
+			fmaxf(floorf((float)filter->cy_out /
+					(float)filter->cy_crop), 1.0f));
+	/* ------------------------- */
+
+	filter->lanczos = false;
+	filter->separable = false;
+
+	lower_than_2x = filter->cx_out < (int)filter->cx_crop / 2 ||
+			filter->cy_out < (int)filter->cy_crop / 2;
+
+	if (lower_than_2x && filter->sampling != OBS_SCALE_POINT &&
+	    filter->sampling != OBS_SCALE_AREA) {
+		filter->technique = "DrawBilinearLowres";
+	} else {
+		switch (filter->sampling) {
+		default:
+		case OBS_SCALE_POINT:
+		case OBS_SCALE_BILINEAR:
+			filter->technique = filter->sharp ?
+				"DrawSharpBilinear" : "DrawBilinear";
+			break;
+		case OBS_SCALE_BICUBIC:  filter->technique = "DrawBicubic"; break;
+		case OBS_SCALE_AREA:     filter->technique = "DrawArea"; break;
+		case OBS_SCALE_LANCZOS:
+			filter->technique =
+				lanczos_techniques[filter->radius - 2][0];
+			break;
+		}
+	}
+
+	if (filter->technique != lanczos_techniques[filter->radius - 2][0])
+		return;
+
+	filter->lanczos = true;
+	filter->technique_h = lanczos_techniques[filter->radius - 2][1];
+	filter->technique_v = lanczos_techniques[filter->radius - 2][2];
+	filter->separable = filter->force_separable ||
+		lanczos_separable_cheaper(filter->radius, filter->cy_crop,
+				filter->cx_out, filter->cy_out);
+
+	lanczos_build_lut(filter->lut, filter->radius,
+			lanczos_kernel_scale(filter->cx_crop, filter->cx_out));
+	lanczos_build_lut(filter->lut + LUT_PHASES * LUT_TAPS, filter->radius,
+			lanczos_kernel_scale(filter->cy_crop, filter->cy_out));
+	filter->lut_dirty = true;
+}
+
+/* Uploads the weights built in video_tick; the texture only changes when the
+ * scale ratio or the radius does. */
+static void crop_scale_filter_upload_lut(struct crop_scale_filter_data *filter)
+{
+	const uint8_t *data = (const uint8_t *)filter->lut;
+	uint32_t linesize = LUT_TAPS * sizeof(float);
+
+	if (!filter->lut_dirty)
+		return;
+
+	if (!filter->weights)
+		filter->weights = gs_texture_create(LUT_TAPS / 4,
+				2 * LUT_PHASES, GS_RGBA32F, 1, &data,
+				GS_DYNAMIC);
+	else
+		gs_texture_set_image(filter->weights, data, linesize, false);
+
+	filter->lut_dirty = false;
+}
+
+/* Instances with the same target, crop, output size and technique share one
+ * cached output, see gdq-cache.c. */
+static void crop_scale_filter_update_output(
+		struct crop_scale_filter_data *filter, obs_source_t *target)
+{
+	struct gdq_cache_key key;
+	struct gdq_cache_entry *old = filter->output;
+
+	filter->output = NULL;
+
+	if (target && filter->target_valid) {
+		gdq_cache_key_init(&key, "gdq_crop_scale_filter", target);
+		key.left = filter->left;
+		key.top = filter->top;
+		key.right = filter->right;
+		key.bottom = filter->bottom;
+		key.cx = (uint32_t)filter->cx_out;
+		key.cy = (uint32_t)filter->cy_out;
+		key.variant = filter->technique;
+		key.flags = (uint32_t)filter->separable |
+			(uint32_t)(filter->sampling == OBS_SCALE_POINT) << 1;
+		filter->output = gdq_cache_acquire(&key);
+	}
+
+	gdq_counters_output_size(filter->counters,
+		filter->output ? (uint32_t)filter->cx_out : 0,
+		filter->output ? (uint32_t)filter->cy_out : 0);
+	gdq_cache_release(old);
+}
+
+static void crop_scale_filter_tick(void *data, float seconds)
+{
+	struct crop_scale_filter_data *filter = data;
+	obs_source_t *target = obs_filter_get_target(filter->context);
+	uint32_t cx = 0;
+	uint32_t cy = 0;
+
+	if (target) {
+		cx = obs_source_get_base_width(target);
+		cy = obs_source_get_base_height(target);
+	}
+
+	profile_start(crop_scale_tick_name);
+
+	if (!cx || !cy)
+		gdq_counters_invalid_tick(filter->counters);
+
+	if (os_atomic_set_bool(&filter->dirty, false) ||
+	    cx != filter->cx_target || cy != filter->cy_target) {
+		filter->cx_target = cx;
+		filter->cy_target = cy;
+		crop_scale_filter_calc(filter, cx, cy);
+		crop_scale_filter_update_output(filter, target);
+		gdq_frame_state_invalidate(&filter->frames);
+	}
+
+	profile_end(crop_scale_tick_name);
+
+	UNUSED_PARAMETER(seconds);
+}
+
+/* Horizontal pass from the filter texture into an intermediate that is output
+ * wide and crop high, then a vertical pass from that to the output. */
+static void crop_scale_filter_render_separable(
+		struct crop_scale_filter_data *filter)
+{
+	struct gdq_target *pass;
+	struct vec2 mul_val;
+	struct vec2 add_val;
+	struct vec2 dimension_i;
+	gs_texture_t *tex;
+
+	if (!obs_source_process_filter_begin(filter->context, GS_RGBA,
+				OBS_NO_DIRECT_RENDERING))
+		return;
+
+	/* the intermediate is only needed for this draw */
+	pass = gdq_pool_acquire(filter->cx_out, filter->cy_crop, GS_RGBA16F);
+
+	if (!gdq_texrender_begin(pass->texrender, filter->cx_out,
+				filter->cy_crop)) {
+		gdq_pool_release(pass);
+		return;
+	}
+
+	gs_effect_set_vec2(filter->param_mul, &filter->mul_val);
+	gs_effect_set_vec2(filter->param_add, &filter->add_val);
+	gs_effect_set_vec2(filter->dimension_param, &filter->dimension_i);
+	gs_effect_set_texture(filter->weights_param, filter->weights);
+
+	obs_source_process_filter_tech_end(filter->context, filter->effect,
+			filter->cx_out, filter->cy_crop, filter->technique_h);
+
+	gdq_texrender_end(pass->texrender);
+
+	/* the intermediate is already cropped */
+	tex = gs_texrender_get_texture(pass->texrender);
+	vec2_set(&mul_val, 1.0f, 1.0f);
+	vec2_zero(&add_val);
+	vec2_set(&dimension_i,
+			1.0f / (float)filter->cx_out,
+			1.0f / (float)filter->cy_crop);
+
+	gs_effect_set_vec2(filter->param_mul, &mul_val);
+	gs_effect_set_vec2(filter->param_add, &add_val);
+	gs_effect_set_vec2(filter->dimension_param, &dimension_i);
+	gs_effect_set_texture(filter->weights_param, filter->weights);
+	gs_effect_set_texture(filter->image_param, tex);
+
+	while (gs_effect_loop(filter->effect, filter->technique_v))
+		gs_draw_sprite(tex, 0, filter->cx_out, filter->cy_out);
+
+	gdq_pool_release(pass);
+}
+
+static void crop_scale_filter_draw(struct crop_scale_filter_data *filter)
+{
+	if (filter->separable) {
+		crop_scale_filter_render_separable(filter);
+		return;
+	}
+
+	if (!obs_source_process_filter_begin(filter->context, GS_RGBA,
+				OBS_NO_DIRECT_RENDERING))
+		return;
+
+	gs_effect_set_vec2(filter->param_mul, &filter->mul_val);
+	gs_effect_set_vec2(filter->param_add, &filter->add_val);
+	gs_effect_set_vec2(filter->dimension_param, &filter->dimension_i);
+	gs_effect_set_texture(filter->weights_param, filter->weights);
+	gs_effect_set_vec2(filter->footprint_param, &filter->footprint);
+	gs_effect_set_vec2(filter->prescale_param, &filter->prescale);
+
+	if (filter->sampling == OBS_SCALE_POINT)
+		gs_effect_set_next_sampler(filter->image_param,
+				filter->point_sampler);
+
+	obs_source_process_filter_tech_end(filter->context, filter->effect,
+			filter->cx_out, filter->cy_out, filter->technique);
+}
+
+/* Draws the output into the shared cache entry first, so that identical
+ * instances later in the frame, and later frames without a new picture, can
+ * draw it as is.  Costs one extra copy, so it is only done when the output
+ * is drawn more than once per frame or can be kept across frames. */
+static void crop_scale_filter_render_cached(
+		struct crop_scale_filter_data *filter)
+{
+	gs_texrender_t *texrender;
+	gs_texture_t *tex = gdq_cache_lookup(filter->output);
+	bool keep = gdq_frame_state_can_reuse(&filter->frames);
+
+	if (tex)
+		gdq_frame_state_rendered(&filter->frames);
+	else if (keep && !gdq_frame_state_changed(&filter->frames))
+		tex = gdq_cache_reuse(filter->output);
+
+	if (tex) {
+		gdq_draw_texture(tex, filter->cx_out, filter->cy_out);
+		return;
+	}
+
+	if (!keep && !gdq_cache_shared(filter->output)) {
+		crop_scale_filter_draw(filter);
+		return;
+	}
+
+	texrender = gdq_cache_begin(filter->output);
+	if (!gdq_texrender_begin(texrender, filter->cx_out, filter->cy_out))
+		return;
+
+	crop_scale_filter_draw(filter);
+	gdq_texrender_end(texrender);
+
+	gdq_frame_state_rendered(&filter->frames);
+	gdq_draw_texture(gdq_cache_end(filter->output),
+			filter->cx_out, filter->cy_out);
+}
+
+static void crop_scale_filter_render(void *data, gs_effect_t *effect)
+{
+	struct crop_scale_filter_data *filter = data;
+
+	if (!filter->target_valid) {
+		obs_source_skip_video_filter(filter->context);
+		gdq_counters_skipped(filter->counters);
+		return;
+	}
+
+	gdq_counters_rendered(filter->counters);
+	profile_start(crop_scale_render_name);
+	gdq_profile_begin(filter->profile);
+
+	if (filter->lanczos)
+		crop_scale_filter_upload_lut(filter);
+
+	if (filter->output)
+		crop_scale_filter_render_cached(filter);
+	else
+		crop_scale_filter_draw(filter);
+
+	gdq_profile_end(filter->profile);
+	profile_end(crop_scale_render_name);
+
+	UNUSED_PARAMETER(effect);
+}
+
+/* Only used to learn when an async parent has a new frame. */
+static struct obs_source_frame *crop_scale_filter_video(void *data,
+		struct obs_source_frame *frame)
+{
+	struct crop_scale_filter_data *filter = data;
+
+	gdq_frame_state_invalidate(&filter->frames);
+	return frame;
+}
+
+static bool sampling_modified(obs_properties_t *props, obs_property_t *p,
+	obs_data_t *settings)
+{
+	const char *sampling = obs_data_get_string(settings, S_SAMPLING);
+	bool lanczos = astrcmpi(sampling, S_SAMPLING_LANCZOS) == 0 ||
+		astrcmpi(sampling, S_SAMPLING_LANCZOS_SEPARABLE) == 0;
+
+	obs_property_set_visible(obs_properties_get(props, S_LANCZOS_RADIUS),
+			lanczos);
+
+	UNUSED_PARAMETER(p);
+	return true;
+}
+
+static obs_properties_t *crop_scale_filter_properties(void *data)
+{
+	struct crop_scale_filter_data *filter = data;
+	obs_source_t *target = obs_filter_get_target(filter->context);
+	obs_properties_t *props = obs_properties_create();
+	obs_property_t *p;
+	uint32_t width = 0;
+	uint32_t height = 0;
+
+	if (target) {
+		width = obs_source_get_base_width(target);
+		height = obs_source_get_base_height(target);
+	}
+
+	gdq_add_crop_properties(props, width, height);
+
+	/* ----------------- */
+
+	p = obs_properties_add_list(props, S_SAMPLING, T_SAMPLING,
+			OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(p, T_SAMPLING_POINT,    S_SAMPLING_POINT);
+	obs_property_list_add_string(p, T_SAMPLING_BILINEAR, S_SAMPLING_BILINEAR);
+	obs_property_list_add_string(p, T_SAMPLING_BICUBIC,  S_SAMPLING_BICUBIC);
+	obs_property_list_add_string(p, T_SAMPLING_LANCZOS,  S_SAMPLING_LANCZOS);
+	obs_property_list_add_string(p, T_SAMPLING_LANCZOS_SEPARABLE,
+			S_SAMPLING_LANCZOS_SEPARABLE);
+	obs_property_list_add_string(p, T_SAMPLING_AREA,     S_SAMPLING_AREA);
+	obs_property_list_add_string(p, T_SAMPLING_SHARP_BILINEAR,
+			S_SAMPLING_SHARP_BILINEAR);
+	obs_property_set_modified_callback(p, sampling_modified);
+
+	p = obs_properties_add_list(props, S_LANCZOS_RADIUS, T_LANCZOS_RADIUS,
+			OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(p, T_LANCZOS_RADIUS_2, 2);
+	obs_property_list_add_int(p, T_LANCZOS_RADIUS_3, 3);
+	obs_property_list_add_int(p, T_LANCZOS_RADIUS_4, 4);
+
+	scale_add_resolution_property(props);
+
+	gdq_add_rerender_property(props);
+	gdq_profile_add_property(props, filter->profile);
+
+	return props;
+}
+
+static void crop_scale_filter_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_string(settings, "console", "None");
+	obs_data_set_default_string(settings, S_SAMPLING, S_SAMPLING_LANCZOS);
+	obs_data_set_default_int(settings, S_LANCZOS_RADIUS, 3);
+	obs_data_set_default_string(settings, S_RESOLUTION, T_NONE);
+	gdq_rerender_defaults(settings);
+}
+
+static uint32_t crop_scale_filter_width(void *data)
+{
+	struct crop_scale_filter_data *filter = data;
+	return (uint32_t)filter->cx_out;
+}
+
+static uint32_t crop_scale_filter_height(void *data)
+{
+	struct crop_scale_filter_data *filter = data;
+	return (uint32_t)filter->cy_out;
+}
+
+struct obs_source_info gdq_crop_scale_filter = {
+	.id                            = "gdq_crop_scale_filter",
+	.type                          = OBS_SOURCE_TYPE_FILTER,
+	.output_flags                  = OBS_SOURCE_VIDEO,
+	.get_name                      = crop_scale_filter_name,
+	.create                        = crop_scale_filter_create,
+	.destroy                       = crop_scale_filter_destroy,
+	.video_tick                    = crop_scale_filter_tick,
+	.video_render                  = crop_scale_filter_render,
+	.filter_video                  = crop_scale_filter_video,
+	.update                        = crop_scale_filter_update,
+	.get_properties                = crop_scale_filter_properties,
+	.get_defaults                  = crop_scale_filter_defaults,
+	.get_width                     = crop_scale_filter_width,
+	.get_height                    = crop_scale_filter_height
+};
@@ -1,439 +1,1234 @@
-#include <obs-module.h>
-#include <graphics/vec2.h>
-#include <stdio.h>
-
-OBS_DECLARE_MODULE()
-
-OBS_MODULE_USE_DEFAULT_LOCALE("gdq-crop", "en-US")
-
-#define S_RESOLUTION                    "resolution"
-#define T_RESOLUTION                    "Input Source Resolution"
-
-#define GDQ_LOG(level, format, ...) \
-	blog(level, "[gdqcrop]: " format, ##__VA_ARGS__)
-
-static const char *aspects[] = {
-	"Default [16:9]",
-	"4:3 Override [4:3]",
-	"GameCube Game played on Wii Console [3:2]",
-	"total override [Do not use!]"
-};
-
-#define NUM_ASPECTS (sizeof(aspects) / sizeof(const char *))
-
-
-struct Preset {
-	char name[255];
-	int left;
-	int right;
-	int top;
-	int bottom;
-} presets[255];
-int preset_count = 0;
-
-
-struct crop_filter_data {
-	obs_source_t                   *context;
-
-	gs_effect_t                    *effect;
-	gs_eparam_t                    *param_mul;
-	gs_eparam_t                    *param_add;
-
-	int                            left;
-	int                            right;
-	int                            top;
-	int                            bottom;
-	uint32_t                       width;
-	uint32_t                       height;
-
-	struct vec2                    mul_val;
-	struct vec2                    add_val;
-};
-
-
-static const char *crop_filter_get_name(void *unused)
-{
-	UNUSED_PARAMETER(unused);
-	return obs_module_text("GDQ Crop");
-}
-
-
-static void *crop_filter_create(obs_data_t *settings, obs_source_t *context)
-{
-	struct crop_filter_data *filter = bzalloc(sizeof(*filter));
-	char *effect_path = obs_module_file("crop_filter.effect");
-
-	filter->context = context;
-
-	obs_enter_graphics();
-	filter->effect = gs_effect_create_from_file(effect_path, NULL);
-	obs_leave_graphics();
-
-	bfree(effect_path);
-
-	if (!filter->effect) {
-		bfree(filter);
-
-		GDQ_LOG(LOG_ERROR, "crop_filter.effect was missing. Ensure the plugin data folder exists");
-
-		return NULL;
-	}
-
-	filter->param_mul = gs_effect_get_param_by_name(filter->effect,
-		"mul_val");
-	filter->param_add = gs_effect_get_param_by_name(filter->effect,
-		"add_val");
-
-	obs_source_update(context, settings);
-	return filter;
-}
-
-
-static void crop_filter_destroy(void *data)
-{
-	struct crop_filter_data *filter = data;
-
-	obs_enter_graphics();
-	gs_effect_destroy(filter->effect);
-	obs_leave_graphics();
-
-	bfree(filter);
-}
-
-
-static void crop_filter_update(void *data, obs_data_t *settings)
-{
-	struct crop_filter_data *filter = data;
-
-	filter->left = (int)obs_data_get_int(settings, "left");
-	filter->top = (int)obs_data_get_int(settings, "top");
-	filter->right = (int)obs_data_get_int(settings, "right");
-	filter->bottom = (int)obs_data_get_int(settings, "bottom");
-
-	if ((filter->left == 0) &&
-		(filter->top == 0) &&
-		(filter->right == 0) &&
-		(filter->bottom == 0)) {
-		obs_data_set_string(settings, "console", "None");
-	}
-	else {
-		obs_data_set_string(settings, "console", "Custom");
-	}
-}
-
-
-
-void modifyScaleFilter(obs_source_t *parent, obs_source_t *child, void *param) {
-	const char* resolutionName = param;
-	const char* res;
-
-	if (strcmp(resolutionName, "Default [16:9]") == 0)
-		res = "16:9";
-	else if (strcmp(resolutionName, "4:3 Override [4:3]") == 0)
-		res = "4:3";
-	else if (strcmp(resolutionName, "GameCube Game played on Wii Console [3:2]") == 0)
-		res = "3:2";
-	else if (strcmp(resolutionName, "total override [Do not use!]") == 0)
-		return;
-
-	const char* name = obs_source_get_id(child);
-	if (strcmp(name, "scale_filter") == 0) {
-		obs_data_t* filtersettings = obs_source_get_settings(child);
-		obs_data_set_string(filtersettings, S_RESOLUTION, res);
-		obs_source_update(child, filtersettings);
-		obs_data_release(filtersettings);
-	}
-}
-
-
-static bool resolution_modified(obs_properties_t *props, obs_property_t *p,
-obs_data_t *settings)
-{
-	struct crop_filter_data* filter = obs_properties_get_param(props);
-	obs_source_t* parentSource = obs_filter_get_parent(filter->context);
-	obs_source_enum_filters(parentSource, modifyScaleFilter, obs_data_get_string(settings, obs_property_name(p)));
-
-	UNUSED_PARAMETER(p);
-	return true;
-}
-
-
-static bool console_modified(obs_properties_t *props, obs_property_t *p,
-	obs_data_t *settings)
-{
-	const char *console = obs_data_get_string(settings, "console");
-	if (strcmp(console, "None") == 0) {
-		obs_data_set_int(settings, "right", 0);
-		obs_data_set_int(settings, "left", 0);
-		obs_data_set_int(settings, "top", 0);
-		obs_data_set_int(settings, "bottom", 0);
-	}
-	else {
-		for (int i = 0; i < preset_count; i++) {
-			if (strcmp(console, presets[i].name) == 0) {
-				obs_data_set_int(settings, "right", presets[i].right);
-				obs_data_set_int(settings, "left", presets[i].left);
-				obs_data_set_int(settings, "top", presets[i].top);
-				obs_data_set_int(settings, "bottom", presets[i].bottom);
-				break;
-			}
-		}
-	}
-
-	UNUSED_PARAMETER(p);
-	return true;
-}
-
-
-static bool new_console_clicked(obs_properties_t *props, obs_property_t *p,
-	void *data)
-{
-	struct crop_filter_data* filter = data;
-	obs_data_t* settings = obs_source_get_settings(filter->context);
-
-	// Do not save if no name set
-	const char* newconsole = obs_data_get_string(settings, "newconsole");
-	if (newconsole == NULL || strlen(newconsole) == 0) {
-		return false;
-	}
-
-	// Reserved preset names
-	if ((strcmp(newconsole, "Custom") == 0) ||
-		(strcmp(newconsole, "None") == 0)) {
-		return false;
-	}
-
-	//Check if preset already exists
-	int newPresetIndex = preset_count;
-	bool presetFound = false;
-	for (int i = 0; i < preset_count; i++) {
-		if (strcmp(newconsole, presets[i].name) == 0) {
-			newPresetIndex = i;
-			presetFound = true;
-			break;
-		}
-	}
-	
-	// Update preset struct
-	strcpy(presets[newPresetIndex].name, newconsole);
-	presets[newPresetIndex].left = obs_data_get_int(settings, "left");
-	presets[newPresetIndex].right = obs_data_get_int(settings, "right");
-	presets[newPresetIndex].top = obs_data_get_int(settings, "top");
-	presets[newPresetIndex].bottom = obs_data_get_int(settings, "bottom");
-
-	// Add new preset to list
-	if (!presetFound) {
-		obs_property_t* listp = obs_properties_get(props, "console");
-		obs_property_list_add_string(listp, presets[newPresetIndex].name, presets[newPresetIndex].name);
-	
-		preset_count++;
-	}
-	
-	// Update UI
-	obs_data_set_string(settings, "console", presets[newPresetIndex].name);
-	obs_data_set_string(settings, "newconsole", "");
-
-	// Save new config file
-	FILE* file = fopen("gdq-crop.cfg", "w");
-	for (int i = 0; i < preset_count; i++) {
-		fprintf(file, "%s\n\tleft:%d, right:%d, top:%d, bottom:%d\n",
-			presets[i].name,
-			presets[i].left,
-			presets[i].right,
-			presets[i].top,
-			presets[i].bottom);
-	}
-	fclose(file);
-
-
-	UNUSED_PARAMETER(p);
-	return true;
-}
-
-
-static obs_properties_t *crop_filter_properties(void *data)
-{
-	struct crop_filter_data *filter = data;
-	obs_source_t *target = obs_filter_get_target(filter->context);
-	uint32_t width;
-	uint32_t height;
-
-	if (!target) {
-		width = 0;
-		height = 0;
-	}
-	else {
-		width = obs_source_get_base_width(target);
-		height = obs_source_get_base_height(target);
-	}
-
-	obs_properties_t *props = obs_properties_create();
-	obs_property_t *p;
-
-	obs_properties_set_param(props, filter, NULL);
-
-	p = obs_properties_add_list(props, S_RESOLUTION, T_RESOLUTION,
-		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
-
-	for (size_t i = 0; i < NUM_ASPECTS; i++)
-		obs_property_list_add_string(p, aspects[i], aspects[i]);
-	obs_property_set_modified_callback(p, resolution_modified);
-
-	p = obs_properties_add_list(props, "console", "Cropping Preset",
-		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
-	obs_property_list_add_string(p, "Custom", "Custom");
-	obs_property_list_add_string(p, "None", "None");
-	for (int i = 0; i < preset_count; i++) {
-		obs_property_list_add_string(p, presets[i].name, presets[i].name);
-	}
-	obs_property_set_modified_callback(p, console_modified);
-
-	obs_properties_add_float_slider(props, "left", obs_module_text("Crop.Left"), 0, width, 1);
-	obs_properties_add_float_slider(props, "top", obs_module_text("Crop.Top"), 0, height, 1);
-	obs_properties_add_float_slider(props, "right", obs_module_text("Crop.Right"), 0, width, 1);
-	obs_properties_add_float_slider(props, "bottom", obs_module_text("Crop.Bottom"), 0, height, 1);
-
-	obs_properties_add_text(props, "newconsole", "New Preset Name", OBS_TEXT_DEFAULT);
-	obs_properties_add_button(props, "newbutton", "Save New Preset", new_console_clicked);
-
-	UNUSED_PARAMETER(data);
-	return props;
-}
-
-
-static void crop_filter_defaults(obs_data_t *settings)
-{
-	obs_data_set_default_string(settings, "console", "None");
-	obs_data_set_default_string(settings, S_RESOLUTION, "4:3");
-}
-
-
-static void calc_crop_dimensions(struct crop_filter_data *filter,
-	struct vec2 *mul_val, struct vec2 *add_val)
-{
-	obs_source_t *target = obs_filter_get_target(filter->context);
-	uint32_t width;
-	uint32_t height;
-	uint32_t total;
-
-	if (!target) {
-		width = 0;
-		height = 0;
-	}
-	else {
-		width = obs_source_get_base_width(target);
-		height = obs_source_get_base_height(target);
-	}
-
-
-	total = filter->left + filter->right;
-	filter->width = total > width ? 0 : (width - total);
-
-	total = filter->top + filter->bottom;
-	filter->height = total > height ? 0 : (height - total);
-
-	if (width && filter->width) {
-		mul_val->x = (float)filter->width / (float)width;
-		add_val->x = (float)filter->left / (float)width;
-	}
-
-	if (height && filter->height) {
-		mul_val->y = (float)filter->height / (float)height;
-		add_val->y = (float)filter->top / (float)height;
-	}
-}
-
-
-static void crop_filter_tick(void *data, float seconds)
-{
-	struct crop_filter_data *filter = data;
-
-	vec2_zero(&filter->mul_val);
-	vec2_zero(&filter->add_val);
-	calc_crop_dimensions(filter, &filter->mul_val, &filter->add_val);
-
-	UNUSED_PARAMETER(seconds);
-}
-
-
-static void crop_filter_render(void *data, gs_effect_t *effect)
-{
-	struct crop_filter_data *filter = data;
-
-	if (!obs_source_process_filter_begin(filter->context, GS_RGBA,
-		OBS_NO_DIRECT_RENDERING))
-		return;
-
-	gs_effect_set_vec2(filter->param_mul, &filter->mul_val);
-	gs_effect_set_vec2(filter->param_add, &filter->add_val);
-
-	obs_source_process_filter_end(filter->context, filter->effect,
-		filter->width, filter->height);
-
-
-
-	UNUSED_PARAMETER(effect);
-}
-
-
-static uint32_t crop_filter_width(void *data)
-{
-	struct crop_filter_data *crop = data;
-
-	return crop->width;
-}
-
-
-static uint32_t crop_filter_height(void *data)
-{
-	struct crop_filter_data *crop = data;
-	return crop->height;
-}
-
-
-struct obs_source_info gdq_crop_filter = {
-	.id = "gdq_crop_console_filter",
-	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO,
-	.get_name = crop_filter_get_name,
-	.create = crop_filter_create,
-	.destroy = crop_filter_destroy,
-	.update = crop_filter_update,
-	.get_properties = crop_filter_properties,
-	.get_defaults = crop_filter_defaults,
-	.video_tick = crop_filter_tick,
-	.video_render = crop_filter_render,
-	.get_width = crop_filter_width,
-	.get_height = crop_filter_height
-};
-
-bool obs_module_load(void)
-{
-	FILE* file = fopen("gdq-crop.cfg", "r");
-
-	if (file) {
-		while (!feof(file) && preset_count < 255) {
-			fgets(presets[preset_count].name, 255, file);
-			int len = strlen(presets[preset_count].name);
-			if (len == 0) {
-				break;
-			}
-			if (presets[preset_count].name[len - 1] == '\n') {
-				presets[preset_count].name[len - 1] = 0;
-			}
-
-			fscanf(file, "\tleft:%d, right:%d, top:%d, bottom:%d\n",
-				&presets[preset_count].left,
-				&presets[preset_count].right,
-				&presets[preset_count].top,
-				&presets[preset_count].bottom);
-			preset_count++;
-		};
-
-		fclose(file);
-	}
-
-	obs_register_source(&gdq_crop_filter);
-
-	return true;
-}
+#include <obs-module.h>
+#include <graphics/vec2.h>
+#include <graphics/math-defs.h>
+#include <stdio.h>
+#include <util/profiler.h>
+#include <util/threading.h>
+#include "gdq-crop.h"
+
+OBS_DECLARE_MODULE()
+
+OBS_MODULE_USE_DEFAULT_LOCALE("gdq-crop", "en-US")
+
+#define S_RESOLUTION                    "resolution"
+#define T_RESOLUTION                    "Input Source Resolution"
+#define S_LINES                         "lines"
+#define T_LINES                         "Line Handling"
+#define S_TRANSITION                    "transition_ms"
+#define T_TRANSITION                    "Preset Transition Duration"
+#define S_CPU_CROP                      "cpu_crop"
+#define T_CPU_CROP                      "Crop Async Frames Before Upload"
+#define S_CONSOLE_AUTO                  "Auto"
+#define S_CONSOLE_GROUP                 "console_group"
+#define T_CONSOLE_GROUP                 "Preset Group"
+#define S_CONSOLE_PAGE                  "console_page"
+#define T_CONSOLE_PAGE                  "Presets"
+#define S_MATCH_SIZE                    "match_size"
+#define T_MATCH_SIZE                    "Switch Preset When Input Resolution Changes"
+#define S_PRESET_SIZE                   "preset_size"
+#define T_PRESET_SIZE                   "Save Input Resolution With Preset"
+
+/* which source rows survive the crop; for a line-doubled 240p signal both
+ * fields are the same picture, for 480i they are the two fields */
+enum crop_lines {
+	CROP_LINES_ALL,
+	CROP_LINES_EVEN,
+	CROP_LINES_ODD
+};
+
+/* what each aspect sets the scale filters after the crop to; the last one
+ * leaves them alone */
+static const struct crop_aspect {
+	const char                     *name;
+	const char                     *resolution;
+} aspects[] = {
+	{"Default [16:9]",                              "16:9"},
+	{"4:3 Override [4:3]",                          "4:3"},
+	{"GameCube Game played on Wii Console [3:2]",   "3:2"},
+	{"total override [Do not use!]",                NULL}
+};
+
+#define NUM_ASPECTS (sizeof(aspects) / sizeof(aspects[0]))
+
+/* the profiler tells scopes apart by the name's address */
+static const char *crop_tick_name = "gdq_crop_filter_tick";
+static const char *crop_render_name = "gdq_crop_filter_render";
+
+
+struct crop_filter_data {
+	obs_source_t                   *context;
+
+	gs_effect_t                    *effect;
+	gs_eparam_t                    *param_mul;
+	gs_eparam_t                    *param_add;
+	struct gdq_cache_entry         *output;
+	struct gdq_frame_state         frames;
+	struct gdq_profile             *profile;
+	struct gdq_counters            *counters;
+
+	/* the rect being drawn; while animating it moves from anim_from to
+	 * next, otherwise it is next */
+	int                            left;
+	int                            right;
+	int                            top;
+	int                            bottom;
+	struct crop_rect               next;
+	struct crop_rect               anim_from;
+	struct crop_rect               anim_to;
+	float                          anim_elapsed;
+	float                          transition;
+	bool                           animating;
+	struct gdq_target              *anim_target;
+	uint32_t                       width;
+	uint32_t                       height;
+	uint32_t                       target_width;
+	uint32_t                       target_height;
+	bool                           direct;
+	enum crop_lines                lines;
+	volatile bool                  dirty;
+
+	/* the "Auto" preset takes the rect from gdq-autocrop.c */
+	bool                           auto_crop;
+	struct gdq_autocrop            *autocrop;
+
+	/* a preset saved with a size is switched to when the input takes
+	 * that size; input is the size before any crop, and matched asks
+	 * the tick to store the new rect in the settings */
+	bool                           match_size;
+	uint32_t                       input_width;
+	uint32_t                       input_height;
+	volatile bool                  matched;
+
+	/* for async parents the frame is cropped before it is uploaded, by
+	 * pointing a view at the kept part of its planes; cpu is what the view
+	 * cut off, gpu what is still left for the draw */
+	bool                           cpu_crop;
+	bool                           cpu_active;
+	struct crop_rect               cpu;
+	struct crop_rect               gpu;
+	struct obs_source_frame        *cpu_view;
+	struct obs_source_frame        *held_frame;
+	obs_source_t                   *held_parent;
+
+	struct vec2                    mul_val;
+	struct vec2                    add_val;
+};
+
+
+static const char *crop_filter_get_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("GDQ Crop");
+}
+
+
+static void *crop_filter_create(obs_data_t *settings, obs_source_t *context)
+{
+	struct crop_filter_data *filter = bzalloc(sizeof(*filter));
+	const struct gdq_effect *effect = gdq_effect_ref(GDQ_EFFECT_CROP);
+
+	filter->context = context;
+
+	if (!effect) {
+		bfree(filter);
+		return NULL;
+	}
+
+	filter->effect = effect->effect;
+	filter->param_mul = effect->mul_val;
+	filter->param_add = effect->add_val;
+	gdq_frame_state_init(&filter->frames, context);
+	filter->profile = gdq_profile_create(context);
+	filter->counters = gdq_counters_create(context,
+		"gdq_crop_console_filter");
+
+	obs_source_update(context, settings);
+	return filter;
+}
+
+
+/* The frame a view points into is kept until the next one arrives; libobs
+ * only releases the view it was handed. */
+static void crop_filter_release_held(struct crop_filter_data *filter)
+{
+	if (!filter->held_frame)
+		return;
+
+	obs_source_release_frame(filter->held_parent, filter->held_frame);
+	filter->held_frame = NULL;
+	filter->held_parent = NULL;
+}
+
+
+static void crop_filter_destroy(void *data)
+{
+	struct crop_filter_data *filter = data;
+
+	crop_filter_release_held(filter);
+	bfree(filter->cpu_view);
+	gdq_autocrop_destroy(filter->autocrop);
+	gdq_profile_destroy(filter->profile);
+	gdq_counters_destroy(filter->counters);
+	gdq_cache_release(filter->output);
+	gdq_effect_unref(GDQ_EFFECT_CROP);
+
+	obs_enter_graphics();
+	gdq_pool_release(filter->anim_target);
+	obs_leave_graphics();
+
+	bfree(filter);
+}
+
+
+static void crop_filter_update(void *data, obs_data_t *settings)
+{
+	struct crop_filter_data *filter = data;
+
+	/* applied, and possibly animated towards, in crop_filter_tick */
+	filter->next.left = (int)obs_data_get_int(settings, "left");
+	filter->next.top = (int)obs_data_get_int(settings, "top");
+	filter->next.right = (int)obs_data_get_int(settings, "right");
+	filter->next.bottom = (int)obs_data_get_int(settings, "bottom");
+	filter->transition =
+		(float)obs_data_get_int(settings, S_TRANSITION) / 1000.0f;
+	filter->direct = obs_data_get_bool(settings, "direct");
+	filter->lines = (enum crop_lines)obs_data_get_int(settings, S_LINES);
+	filter->cpu_crop = obs_data_get_bool(settings, S_CPU_CROP);
+	filter->match_size = obs_data_get_bool(settings, S_MATCH_SIZE);
+	filter->auto_crop = strcmp(obs_data_get_string(settings, "console"),
+		S_CONSOLE_AUTO) == 0;
+
+	/* the sliders only seed the rect until borders were detected */
+	if (filter->auto_crop && !filter->autocrop)
+		filter->autocrop = gdq_autocrop_create();
+	if (filter->auto_crop && filter->autocrop)
+		gdq_autocrop_last(filter->autocrop, &filter->next);
+
+	gdq_frame_state_update(&filter->frames, settings);
+	os_atomic_set_bool(&filter->dirty, true);
+
+	if (filter->auto_crop)
+		return;
+
+	if ((filter->next.left == 0) &&
+		(filter->next.top == 0) &&
+		(filter->next.right == 0) &&
+		(filter->next.bottom == 0)) {
+		obs_data_set_string(settings, "console", "None");
+	}
+	else {
+		obs_data_set_string(settings, "console", "Custom");
+	}
+}
+
+
+
+/* Finds an aspect by its name or by the resolution it sets; NULL if there
+ * is none. */
+static const struct crop_aspect *crop_aspect_find(const char *name)
+{
+	for (size_t i = 0; i < NUM_ASPECTS; i++) {
+		if (strcmp(aspects[i].name, name) == 0 ||
+			(aspects[i].resolution &&
+			strcmp(aspects[i].resolution, name) == 0))
+			return &aspects[i];
+	}
+
+	return NULL;
+}
+
+
+/* Resolution the scale filters get for an aspect, or NULL to leave them. */
+const char *gdq_aspect_resolution(const char *aspect)
+{
+	const struct crop_aspect *found = crop_aspect_find(aspect);
+
+	return found ? found->resolution : NULL;
+}
+
+
+/* Name the crop filter lists an aspect under, or NULL if it is unknown. */
+const char *gdq_aspect_name(const char *aspect)
+{
+	const struct crop_aspect *found = crop_aspect_find(aspect);
+
+	return found ? found->name : NULL;
+}
+
+
+bool gdq_is_scale_filter(obs_source_t *source)
+{
+	const char *id = obs_source_get_id(source);
+
+	return strcmp(id, "scale_filter") == 0 ||
+		strcmp(id, "gdq_scale_filter") == 0;
+}
+
+
+void modifyScaleFilter(obs_source_t *parent, obs_source_t *child, void *param) {
+	const char* res = param;
+
+	if (gdq_is_scale_filter(child)) {
+		obs_data_t* filtersettings = obs_source_get_settings(child);
+		obs_data_set_string(filtersettings, S_RESOLUTION, res);
+		obs_source_update(child, filtersettings);
+		obs_data_release(filtersettings);
+	}
+
+	UNUSED_PARAMETER(parent);
+}
+
+
+static bool resolution_modified(obs_properties_t *props, obs_property_t *p,
+obs_data_t *settings)
+{
+	struct crop_filter_data* filter = obs_properties_get_param(props);
+	obs_source_t* parentSource = obs_filter_get_parent(filter->context);
+	const char *res = gdq_aspect_resolution(
+		obs_data_get_string(settings, obs_property_name(p)));
+
+	if (res && parentSource)
+		obs_source_enum_filters(parentSource, modifyScaleFilter,
+			(void *)res);
+
+	return true;
+}
+
+
+static bool console_modified(obs_properties_t *props, obs_property_t *p,
+	obs_data_t *settings)
+{
+	const char *console = obs_data_get_string(settings, "console");
+	struct crop_rect rect = {0};
+
+	if (strcmp(console, "None") == 0 ||
+		gdq_presets_find(console, &rect)) {
+		obs_data_set_int(settings, "right", rect.right);
+		obs_data_set_int(settings, "left", rect.left);
+		obs_data_set_int(settings, "top", rect.top);
+		obs_data_set_int(settings, "bottom", rect.bottom);
+	}
+
+	UNUSED_PARAMETER(props);
+	UNUSED_PARAMETER(p);
+	return true;
+}
+
+
+static bool new_console_clicked(obs_properties_t *props, obs_property_t *p,
+	void *data)
+{
+	struct crop_filter_data* filter = data;
+	obs_data_t* settings = obs_source_get_settings(filter->context);
+	const char *group = obs_data_get_string(settings, S_CONSOLE_GROUP);
+	bool with_size = obs_data_get_bool(settings, S_PRESET_SIZE);
+	struct crop_rect rect;
+
+	// Do not save if no name set
+	const char* newconsole = obs_data_get_string(settings, "newconsole");
+	if (newconsole == NULL || strlen(newconsole) == 0) {
+		obs_data_release(settings);
+		return false;
+	}
+
+	// Reserved preset names
+	if ((strcmp(newconsole, "Custom") == 0) ||
+		(strcmp(newconsole, "None") == 0) ||
+		(strcmp(newconsole, S_CONSOLE_AUTO) == 0)) {
+		obs_data_release(settings);
+		return false;
+	}
+
+	rect.left = (int)obs_data_get_int(settings, "left");
+	rect.right = (int)obs_data_get_int(settings, "right");
+	rect.top = (int)obs_data_get_int(settings, "top");
+	rect.bottom = (int)obs_data_get_int(settings, "bottom");
+
+	// Add new preset to list, it is saved into the current group in the
+	// background
+	if (gdq_presets_set(newconsole, group, &rect,
+		with_size ? filter->input_width : 0,
+		with_size ? filter->input_height : 0)) {
+		obs_property_t* listp = obs_properties_get(props, "console");
+		obs_property_list_add_string(listp, newconsole, newconsole);
+	}
+
+	// Update UI
+	obs_data_set_string(settings, "console", newconsole);
+	obs_data_set_string(settings, "newconsole", "");
+	obs_data_release(settings);
+
+	UNUSED_PARAMETER(p);
+	return true;
+}
+
+
+static bool console_listed(obs_property_t *list, size_t first,
+	const char *console)
+{
+	size_t count = obs_property_list_item_count(list);
+
+	for (size_t i = first; i < count; i++) {
+		if (strcmp(obs_property_list_item_string(list, i), console) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+
+/* Lists a page of the chosen group's presets after the entries that are not
+ * presets (Custom, None, ...), which stay.  The chosen preset is listed
+ * first if it is not on that page, so the list still shows it.  Returns how
+ * many presets the group has. */
+static size_t console_list_fill(obs_properties_t *props, obs_data_t *settings)
+{
+	obs_property_t *list = obs_properties_get(props, "console");
+	const char *group = obs_data_get_string(settings, S_CONSOLE_GROUP);
+	const char *console = obs_data_get_string(settings, "console");
+	size_t page = (size_t)obs_data_get_int(settings, S_CONSOLE_PAGE);
+	struct crop_rect rect;
+	size_t fixed = 0;
+	size_t count = obs_property_list_item_count(list);
+	size_t total;
+
+	while (fixed < count && !gdq_presets_find(
+		obs_property_list_item_string(list, fixed), &rect))
+		fixed++;
+
+	while (count-- > fixed)
+		obs_property_list_item_remove(list, count);
+
+	total = gdq_presets_list(list, group, page);
+
+	/* another group has fewer pages */
+	if (page && page * GDQ_PRESETS_PAGE >= total) {
+		obs_data_set_int(settings, S_CONSOLE_PAGE, 0);
+		gdq_presets_list(list, group, 0);
+	}
+
+	if (!console_listed(list, fixed, console) &&
+		gdq_presets_find(console, &rect))
+		obs_property_list_insert_string(list, fixed, console, console);
+
+	return total;
+}
+
+
+static bool console_page_modified(obs_properties_t *props, obs_property_t *p,
+	obs_data_t *settings)
+{
+	console_list_fill(props, settings);
+
+	UNUSED_PARAMETER(p);
+	return true;
+}
+
+
+/* A group with more presets than fit a page gets a list of its pages. */
+static bool console_group_modified(obs_properties_t *props, obs_property_t *p,
+	obs_data_t *settings)
+{
+	obs_property_t *pages = obs_properties_get(props, S_CONSOLE_PAGE);
+	size_t total = console_list_fill(props, settings);
+	char name[64];
+
+	obs_property_list_clear(pages);
+	for (size_t i = 0; i * GDQ_PRESETS_PAGE < total; i++) {
+		size_t last = (i + 1) * GDQ_PRESETS_PAGE;
+
+		snprintf(name, sizeof(name), "%zu - %zu",
+			i * GDQ_PRESETS_PAGE + 1, last < total ? last : total);
+		obs_property_list_add_int(pages, name, (long long)i);
+	}
+	obs_property_set_visible(pages, total > GDQ_PRESETS_PAGE);
+
+	UNUSED_PARAMETER(p);
+	return true;
+}
+
+
+void gdq_add_crop_properties(obs_properties_t *props,
+	uint32_t width, uint32_t height)
+{
+	obs_property_t *p;
+
+	/* only one group of presets is listed at a time, filled in by
+	 * console_group_modified */
+	p = obs_properties_add_list(props, S_CONSOLE_GROUP, T_CONSOLE_GROUP,
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(p, "(Ungrouped)", "");
+	obs_property_set_visible(p, gdq_presets_list_groups(p) > 0);
+	obs_property_set_modified_callback(p, console_group_modified);
+
+	/* large groups are listed a page at a time, so opening the
+	 * properties does not add thousands of entries */
+	p = obs_properties_add_list(props, S_CONSOLE_PAGE, T_CONSOLE_PAGE,
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_set_visible(p, false);
+	obs_property_set_modified_callback(p, console_page_modified);
+
+	p = obs_properties_add_list(props, "console", "Cropping Preset",
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(p, "Custom", "Custom");
+	obs_property_list_add_string(p, "None", "None");
+	obs_property_set_modified_callback(p, console_modified);
+
+	obs_properties_add_float_slider(props, "left", obs_module_text("Crop.Left"), 0, width, 1);
+	obs_properties_add_float_slider(props, "top", obs_module_text("Crop.Top"), 0, height, 1);
+	obs_properties_add_float_slider(props, "right", obs_module_text("Crop.Right"), 0, width, 1);
+	obs_properties_add_float_slider(props, "bottom", obs_module_text("Crop.Bottom"), 0, height, 1);
+}
+
+
+static obs_properties_t *crop_filter_properties(void *data)
+{
+	struct crop_filter_data *filter = data;
+	obs_source_t *target = obs_filter_get_target(filter->context);
+	uint32_t width;
+	uint32_t height;
+
+	if (!target) {
+		width = 0;
+		height = 0;
+	}
+	else {
+		width = obs_source_get_base_width(target);
+		height = obs_source_get_base_height(target);
+	}
+
+	obs_properties_t *props = obs_properties_create();
+	obs_property_t *p;
+
+	obs_properties_set_param(props, filter, NULL);
+
+	p = obs_properties_add_list(props, S_RESOLUTION, T_RESOLUTION,
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+
+	for (size_t i = 0; i < NUM_ASPECTS; i++)
+		obs_property_list_add_string(p, aspects[i].name,
+			aspects[i].name);
+	obs_property_set_modified_callback(p, resolution_modified);
+
+	gdq_add_crop_properties(props, width, height);
+
+	/* only this filter draws its target itself to look for borders */
+	p = obs_properties_get(props, "console");
+	obs_property_list_insert_string(p, 2, "Auto (Detect Black Borders)",
+		S_CONSOLE_AUTO);
+
+	obs_properties_add_bool(props, "direct", "Render Cropped Region Only");
+
+	p = obs_properties_add_list(props, S_LINES, T_LINES,
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(p, "All Lines", CROP_LINES_ALL);
+	obs_property_list_add_int(p, "Even Lines (Line-Doubled / Top Field)",
+		CROP_LINES_EVEN);
+	obs_property_list_add_int(p, "Odd Lines (Bottom Field)",
+		CROP_LINES_ODD);
+
+	obs_properties_add_bool(props, S_CPU_CROP, T_CPU_CROP);
+	obs_properties_add_bool(props, S_MATCH_SIZE, T_MATCH_SIZE);
+
+	p = obs_properties_add_int_slider(props, S_TRANSITION, T_TRANSITION,
+		0, 2000, 10);
+	obs_property_int_set_suffix(p, " ms");
+
+	gdq_add_rerender_property(props);
+	gdq_profile_add_property(props, filter->profile);
+
+	obs_properties_add_text(props, "newconsole", "New Preset Name", OBS_TEXT_DEFAULT);
+	obs_properties_add_bool(props, S_PRESET_SIZE, T_PRESET_SIZE);
+	obs_properties_add_button(props, "newbutton", "Save New Preset", new_console_clicked);
+
+	UNUSED_PARAMETER(data);
+	return props;
+}
+
+
+static void crop_filter_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_string(settings, "console", "None");
+	obs_data_set_default_string(settings, S_RESOLUTION, "4:3");
+	obs_data_set_default_bool(settings, "direct", true);
+	obs_data_set_default_int(settings, S_LINES, CROP_LINES_ALL);
+	obs_data_set_default_int(settings, S_TRANSITION, 0);
+	obs_data_set_default_bool(settings, S_CPU_CROP, true);
+	obs_data_set_default_bool(settings, S_MATCH_SIZE, true);
+	gdq_rerender_defaults(settings);
+}
+
+
+void gdq_calc_crop(uint32_t width, uint32_t height,
+	int left, int right, int top, int bottom,
+	uint32_t *cx, uint32_t *cy, struct vec2 *mul_val, struct vec2 *add_val)
+{
+	uint32_t total;
+
+	vec2_zero(mul_val);
+	vec2_zero(add_val);
+
+	total = left + right;
+	*cx = total > width ? 0 : (width - total);
+
+	total = top + bottom;
+	*cy = total > height ? 0 : (height - total);
+
+	if (width && *cx) {
+		mul_val->x = (float)*cx / (float)width;
+		add_val->x = (float)left / (float)width;
+	}
+
+	if (height && *cy) {
+		mul_val->y = (float)*cy / (float)height;
+		add_val->y = (float)top / (float)height;
+	}
+}
+
+
+/* Top edge of the region to draw, in target rows.  When only one field is
+ * kept every output row covers two source rows, so the region is shifted to
+ * put each output row's center on the center of the row it keeps. */
+static float crop_region_top(struct crop_filter_data *filter)
+{
+	float top = (float)filter->gpu.top;
+
+	if (filter->lines != CROP_LINES_ALL)
+		top += (float)(filter->lines == CROP_LINES_ODD) - 0.5f;
+
+	return top;
+}
+
+
+static int crop_remainder(int edge, int cpu_edge)
+{
+	return edge > cpu_edge ? edge - cpu_edge : 0;
+}
+
+
+static void calc_crop_dimensions(struct crop_filter_data *filter,
+	struct vec2 *mul_val, struct vec2 *add_val)
+{
+	struct crop_rect *gpu = &filter->gpu;
+
+	/* the target is the view while frames are cropped before upload */
+	gpu->left = crop_remainder(filter->left, filter->cpu.left);
+	gpu->right = crop_remainder(filter->right, filter->cpu.right);
+	gpu->top = crop_remainder(filter->top, filter->cpu.top);
+	gpu->bottom = crop_remainder(filter->bottom, filter->cpu.bottom);
+
+	gdq_calc_crop(filter->target_width, filter->target_height,
+		gpu->left, gpu->right, gpu->top, gpu->bottom,
+		&filter->width, &filter->height, mul_val, add_val);
+
+	if (filter->lines == CROP_LINES_ALL || !filter->height)
+		return;
+
+	/* half the rows, sampled exactly on the centers of the kept field */
+	filter->height /= 2;
+	mul_val->y = 2.0f * (float)filter->height /
+		(float)filter->target_height;
+	add_val->y = crop_region_top(filter) / (float)filter->target_height;
+}
+
+
+/* Instances cropping the same target the same way share one cached output,
+ * see gdq-cache.c. */
+static void crop_filter_update_output(struct crop_filter_data *filter,
+	obs_source_t *target)
+{
+	struct gdq_cache_key key;
+	struct gdq_cache_entry *old = filter->output;
+
+	filter->output = NULL;
+
+	if (target && filter->width && filter->height) {
+		gdq_cache_key_init(&key, "gdq_crop_console_filter", target);
+		key.left = filter->gpu.left;
+		key.top = filter->gpu.top;
+		key.right = filter->gpu.right;
+		key.bottom = filter->gpu.bottom;
+		key.cx = filter->width;
+		key.cy = filter->height;
+		key.flags = (uint32_t)filter->lines;
+		filter->output = gdq_cache_acquire(&key);
+	}
+
+	gdq_counters_output_size(filter->counters,
+		filter->output ? filter->width : 0,
+		filter->output ? filter->height : 0);
+	gdq_cache_release(old);
+}
+
+
+static bool crop_rect_equal(const struct crop_rect *a,
+	const struct crop_rect *b)
+{
+	return a->left == b->left && a->right == b->right &&
+		a->top == b->top && a->bottom == b->bottom;
+}
+
+
+static int crop_lerp(int from, int to, float t)
+{
+	return from + (int)floorf((float)(to - from) * t + 0.5f);
+}
+
+
+/* Starts, retargets or cancels the preset transition after a settings or
+ * target size change. */
+static void crop_filter_apply_rect(struct crop_filter_data *filter,
+	bool size_changed)
+{
+	struct crop_rect shown = {
+		filter->left, filter->right, filter->top, filter->bottom
+	};
+
+	if (filter->animating && crop_rect_equal(&filter->anim_to,
+		&filter->next) && !size_changed)
+		return;
+
+	/* a new source size snaps, so does anything before the first draw */
+	if (filter->transition > 0.0f && !size_changed && filter->width &&
+		!crop_rect_equal(&shown, &filter->next)) {
+		filter->anim_from = shown;
+		filter->anim_to = filter->next;
+		filter->anim_elapsed = 0.0f;
+		filter->animating = true;
+		return;
+	}
+
+	filter->animating = false;
+	filter->left = filter->next.left;
+	filter->right = filter->next.right;
+	filter->top = filter->next.top;
+	filter->bottom = filter->next.bottom;
+}
+
+
+/* Notes the size of the input before any crop, and switches to the preset
+ * saved for it if it changed.  Sizes of 0, while there is no signal, and
+ * the first size seen, which the settings were made for, do not switch. */
+static bool crop_filter_match_input(struct crop_filter_data *filter,
+	uint32_t width, uint32_t height)
+{
+	bool first = !filter->input_width;
+	struct crop_rect rect;
+
+	if (!width || !height || (width == filter->input_width &&
+		height == filter->input_height))
+		return false;
+
+	filter->input_width = width;
+	filter->input_height = height;
+
+	if (first || !filter->match_size || filter->auto_crop ||
+		!gdq_presets_find_size(width, height, &rect))
+		return false;
+
+	GDQ_LOG(LOG_INFO, "'%s': input is now %ux%u, switching preset",
+		obs_source_get_name(filter->context), width, height);
+
+	filter->next = rect;
+	os_atomic_set_bool(&filter->matched, true);
+	return true;
+}
+
+
+/* Stores a rect switched to by crop_filter_match_input in the settings, so
+ * it survives the next update; the update itself changes nothing. */
+static void crop_filter_store_match(struct crop_filter_data *filter)
+{
+	obs_data_t *settings = obs_data_create();
+
+	obs_data_set_int(settings, "left", filter->next.left);
+	obs_data_set_int(settings, "right", filter->next.right);
+	obs_data_set_int(settings, "top", filter->next.top);
+	obs_data_set_int(settings, "bottom", filter->next.bottom);
+	obs_source_update(filter->context, settings);
+	obs_data_release(settings);
+}
+
+
+static void crop_filter_animate(struct crop_filter_data *filter, float seconds)
+{
+	float t;
+
+	filter->anim_elapsed += seconds;
+	t = fminf(filter->anim_elapsed / filter->transition, 1.0f);
+	t = t * t * (3.0f - 2.0f * t);
+
+	filter->left = crop_lerp(filter->anim_from.left,
+		filter->anim_to.left, t);
+	filter->right = crop_lerp(filter->anim_from.right,
+		filter->anim_to.right, t);
+	filter->top = crop_lerp(filter->anim_from.top,
+		filter->anim_to.top, t);
+	filter->bottom = crop_lerp(filter->anim_from.bottom,
+		filter->anim_to.bottom, t);
+
+	if (filter->anim_elapsed >= filter->transition)
+		filter->animating = false;
+}
+
+
+static void crop_filter_tick_rect(struct crop_filter_data *filter,
+	float seconds)
+{
+	obs_source_t *target = obs_filter_get_target(filter->context);
+	uint32_t width = 0;
+	uint32_t height = 0;
+	bool size_changed;
+
+	if (target) {
+		width = obs_source_get_base_width(target);
+		height = obs_source_get_base_height(target);
+	}
+
+	size_changed = width != filter->target_width ||
+		height != filter->target_height;
+
+	if (!width || !height)
+		gdq_counters_invalid_tick(filter->counters);
+
+	/* cropped async frames change the target's size with the crop, their
+	 * input size is seen in crop_filter_video */
+	if (!filter->cpu_active)
+		crop_filter_match_input(filter, width, height);
+	if (os_atomic_set_bool(&filter->matched, false))
+		crop_filter_store_match(filter);
+
+	if (filter->auto_crop && filter->autocrop &&
+		gdq_autocrop_result(filter->autocrop, &filter->next))
+		os_atomic_set_bool(&filter->dirty, true);
+
+	/* the geometry only depends on the settings, the target size and a
+	 * running transition */
+	if (os_atomic_set_bool(&filter->dirty, false) || size_changed)
+		crop_filter_apply_rect(filter, size_changed);
+	else if (!filter->animating)
+		return;
+
+	if (filter->animating)
+		crop_filter_animate(filter, seconds);
+
+	filter->target_width = width;
+	filter->target_height = height;
+	calc_crop_dimensions(filter, &filter->mul_val, &filter->add_val);
+
+	/* the cache is keyed by size, which changes on every step of a
+	 * transition; it is picked up again once the transition ends */
+	if (!filter->animating)
+		crop_filter_update_output(filter, target);
+
+	gdq_frame_state_invalidate(&filter->frames);
+}
+
+
+static void crop_filter_tick(void *data, float seconds)
+{
+	profile_start(crop_tick_name);
+	crop_filter_tick_rect(data, seconds);
+	profile_end(crop_tick_name);
+}
+
+
+/* Renders only the cropped region of the target, straight into the
+ * crop-sized cached output, by offsetting the projection. */
+static bool crop_filter_render_direct(struct crop_filter_data *filter)
+{
+	obs_source_t *target = obs_filter_get_target(filter->context);
+	float left = (float)filter->gpu.left;
+	float top = crop_region_top(filter);
+	float rows = (float)filter->height;
+
+	if (filter->lines != CROP_LINES_ALL)
+		rows *= 2.0f;
+
+	return gdq_render_region(gdq_cache_begin(filter->output), target,
+		left, top,
+		left + (float)filter->width, top + rows,
+		filter->width, filter->height);
+}
+
+
+/* Crops through the effect into the cached output, for targets that can
+ * only be drawn through obs_source_process_filter_begin. */
+static bool crop_filter_render_effect(struct crop_filter_data *filter)
+{
+	gs_texrender_t *texrender;
+
+	if (!obs_source_process_filter_begin(filter->context, GS_RGBA,
+		OBS_NO_DIRECT_RENDERING))
+		return false;
+
+	texrender = gdq_cache_begin(filter->output);
+	if (!gdq_texrender_begin(texrender, filter->width, filter->height))
+		return false;
+
+	gs_effect_set_vec2(filter->param_mul, &filter->mul_val);
+	gs_effect_set_vec2(filter->param_add, &filter->add_val);
+
+	obs_source_process_filter_end(filter->context, filter->effect,
+		filter->width, filter->height);
+
+	gdq_texrender_end(texrender);
+	return true;
+}
+
+
+/* During a transition the output size changes every frame.  The region is
+ * rendered into the corner of a target as large as the whole source,
+ * borrowed once, so only the viewport and the UVs change from step to
+ * step. */
+static void crop_filter_render_animated(struct crop_filter_data *filter)
+{
+	obs_source_t *target = obs_filter_get_target(filter->context);
+	struct gdq_target *anim = filter->anim_target;
+	float left = (float)filter->gpu.left;
+	float top = crop_region_top(filter);
+	float rows = (float)filter->height;
+
+	if (filter->lines != CROP_LINES_ALL)
+		rows *= 2.0f;
+
+	if (anim && (anim->cx != filter->target_width ||
+		anim->cy != filter->target_height)) {
+		gdq_pool_release(anim);
+		anim = NULL;
+	}
+
+	if (!anim)
+		anim = gdq_pool_acquire(filter->target_width,
+			filter->target_height, GS_RGBA);
+
+	filter->anim_target = anim;
+
+	if (!gdq_render_subregion(anim->texrender, target,
+		left, top,
+		left + (float)filter->width, top + rows,
+		filter->width, filter->height,
+		anim->cx, anim->cy))
+		return;
+
+	gdq_draw_texture_subregion(gs_texrender_get_texture(anim->texrender),
+		filter->width, filter->height);
+}
+
+
+/* Draws the cached output.  It is only rendered again when no identical
+ * instance did so this frame and the target has changed since. */
+static void crop_filter_render_cached(struct crop_filter_data *filter,
+	bool direct)
+{
+	gs_texture_t *tex = gdq_cache_lookup(filter->output);
+	bool rendered;
+
+	if (tex)
+		gdq_frame_state_rendered(&filter->frames);
+	else if (!gdq_frame_state_changed(&filter->frames))
+		tex = gdq_cache_reuse(filter->output);
+
+	if (!tex) {
+		rendered = direct ?
+			crop_filter_render_direct(filter) :
+			crop_filter_render_effect(filter);
+		if (!rendered)
+			return;
+
+		tex = gdq_cache_end(filter->output);
+		gdq_frame_state_rendered(&filter->frames);
+	}
+
+	gdq_draw_texture(tex, filter->width, filter->height);
+}
+
+
+static void crop_filter_render_pass(struct crop_filter_data *filter)
+{
+	bool direct;
+
+	direct = filter->direct && gdq_can_render_target(filter->context);
+
+	if (filter->auto_crop && filter->autocrop &&
+		gdq_can_render_target(filter->context))
+		gdq_autocrop_capture(filter->autocrop,
+			obs_filter_get_target(filter->context),
+			filter->target_width, filter->target_height);
+
+	if (filter->animating && direct) {
+		crop_filter_render_animated(filter);
+		return;
+	}
+
+	if (filter->anim_target) {
+		gdq_pool_release(filter->anim_target);
+		filter->anim_target = NULL;
+	}
+
+	if (filter->output && !filter->animating &&
+		(direct || gdq_frame_state_can_reuse(&filter->frames))) {
+		crop_filter_render_cached(filter, direct);
+		return;
+	}
+
+	if (!obs_source_process_filter_begin(filter->context, GS_RGBA,
+		OBS_NO_DIRECT_RENDERING))
+		return;
+
+	gs_effect_set_vec2(filter->param_mul, &filter->mul_val);
+	gs_effect_set_vec2(filter->param_add, &filter->add_val);
+
+	obs_source_process_filter_end(filter->context, filter->effect,
+		filter->width, filter->height);
+}
+
+
+static void crop_filter_render(void *data, gs_effect_t *effect)
+{
+	struct crop_filter_data *filter = data;
+
+	if (!filter->width || !filter->height)
+		return;
+
+	/* the view already is the crop, the frame needs no second pass */
+	if (filter->cpu_active && filter->lines == CROP_LINES_ALL &&
+		!filter->gpu.left && !filter->gpu.right &&
+		!filter->gpu.top && !filter->gpu.bottom) {
+		obs_source_skip_video_filter(filter->context);
+		gdq_counters_skipped(filter->counters);
+		return;
+	}
+
+	gdq_counters_rendered(filter->counters);
+	profile_start(crop_render_name);
+	gdq_profile_begin(filter->profile);
+
+	crop_filter_render_pass(filter);
+
+	gdq_profile_end(filter->profile);
+	profile_end(crop_render_name);
+
+	UNUSED_PARAMETER(effect);
+}
+
+
+/* Part of the frame that can be cut off by moving plane pointers; false if
+ * the frame has to go through whole.  Subsampled chroma keeps the left and
+ * top edges even, the odd row or column is cropped on the GPU. */
+static bool crop_filter_cpu_rect(struct crop_filter_data *filter,
+	obs_source_t *parent, const struct obs_source_frame *frame,
+	struct crop_rect *cpu)
+{
+	int width = (int)frame->width;
+	int height = (int)frame->height;
+
+	/* a transition would resize the async texture on every step, border
+	 * detection needs the whole frame, and so does an earlier filter in
+	 * the chain */
+	if (!filter->cpu_crop || filter->animating || filter->auto_crop ||
+		frame->flip ||
+		obs_filter_get_target(filter->context) != parent ||
+		obs_source_get_deinterlace_mode(parent) !=
+		OBS_DEINTERLACE_MODE_DISABLE)
+		return false;
+
+	cpu->left = filter->left;
+	cpu->right = filter->right;
+	cpu->top = filter->top;
+	cpu->bottom = filter->bottom;
+
+	switch (frame->format) {
+	case VIDEO_FORMAT_I420:
+	case VIDEO_FORMAT_NV12:
+		cpu->left &= ~1;
+		cpu->top &= ~1;
+		break;
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+		break;
+	default:
+		return false;
+	}
+
+	if (cpu->left < 0 || cpu->right < 0 || cpu->top < 0 ||
+		cpu->bottom < 0 ||
+		cpu->left + cpu->right >= width ||
+		cpu->top + cpu->bottom >= height)
+		return false;
+
+	return cpu->left || cpu->right || cpu->top || cpu->bottom;
+}
+
+
+/* Points view at the part of frame that survives cpu; nothing is copied. */
+static void crop_frame_view(struct obs_source_frame *view,
+	const struct obs_source_frame *frame, const struct crop_rect *cpu)
+{
+	size_t x = (size_t)cpu->left;
+	size_t y = (size_t)cpu->top;
+
+	*view = *frame;
+	view->width = frame->width - (uint32_t)(cpu->left + cpu->right);
+	view->height = frame->height - (uint32_t)(cpu->top + cpu->bottom);
+
+	switch (frame->format) {
+	case VIDEO_FORMAT_I420:
+		view->data[0] += y * frame->linesize[0] + x;
+		view->data[1] += y / 2 * frame->linesize[1] + x / 2;
+		view->data[2] += y / 2 * frame->linesize[2] + x / 2;
+		break;
+	case VIDEO_FORMAT_NV12:
+		view->data[0] += y * frame->linesize[0] + x;
+		view->data[1] += y / 2 * frame->linesize[1] + x;
+		break;
+	default:
+		view->data[0] += y * frame->linesize[0] + x * 4;
+		break;
+	}
+
+	/* libobs releases the view like one of its own frames; the extra
+	 * reference keeps it from freeing planes the view does not own */
+	view->refs = 2;
+}
+
+
+/* Called for every new frame of an async parent, right before the frame is
+ * uploaded and the filter chain renders it. */
+static struct obs_source_frame *crop_filter_video(void *data,
+	struct obs_source_frame *frame)
+{
+	struct crop_filter_data *filter = data;
+	obs_source_t *parent = obs_filter_get_parent(filter->context);
+	struct crop_rect cpu = {0};
+	bool resized = false;
+	bool active;
+
+	gdq_frame_state_invalidate(&filter->frames);
+	crop_filter_release_held(filter);
+
+	/* a preset for a new input size is drawn with the first frame of
+	 * that size */
+	if (obs_filter_get_target(filter->context) == parent &&
+		crop_filter_match_input(filter, frame->width, frame->height)) {
+		crop_filter_apply_rect(filter, true);
+		resized = true;
+	}
+
+	active = crop_filter_cpu_rect(filter, parent, frame, &cpu);
+
+	/* the target takes the size of the view before the chain renders, so
+	 * the geometry follows right away instead of on the next tick */
+	if (resized || active != filter->cpu_active ||
+		!crop_rect_equal(&cpu, &filter->cpu)) {
+		filter->cpu_active = active;
+		filter->cpu = cpu;
+		filter->target_width = frame->width -
+			(uint32_t)(cpu.left + cpu.right);
+		filter->target_height = frame->height -
+			(uint32_t)(cpu.top + cpu.bottom);
+
+		calc_crop_dimensions(filter, &filter->mul_val,
+			&filter->add_val);
+		if (!filter->animating)
+			crop_filter_update_output(filter,
+				obs_filter_get_target(filter->context));
+	}
+
+	if (!active)
+		return frame;
+
+	if (!filter->cpu_view)
+		filter->cpu_view = bzalloc(sizeof(*filter->cpu_view));
+
+	crop_frame_view(filter->cpu_view, frame, &cpu);
+	filter->held_frame = frame;
+	filter->held_parent = parent;
+	return filter->cpu_view;
+}
+
+
+/* True if source is a crop filter that cuts its part out of every async
+ * frame before handing it on, leaving nothing to crop on the GPU; a later
+ * filter may then resize the frames as if they came from the parent. */
+bool gdq_crop_passes_frames(obs_source_t *source)
+{
+	struct crop_filter_data *filter;
+
+	if (!source || strcmp(obs_source_get_id(source),
+		gdq_crop_filter.id) != 0)
+		return false;
+
+	filter = obs_obj_get_data(source);
+	return filter && filter->cpu_active &&
+		filter->lines == CROP_LINES_ALL &&
+		!filter->gpu.left && !filter->gpu.right &&
+		!filter->gpu.top && !filter->gpu.bottom;
+}
+
+
+static void crop_filter_remove(void *data, obs_source_t *parent)
+{
+	struct crop_filter_data *filter = data;
+
+	crop_filter_release_held(filter);
+	UNUSED_PARAMETER(parent);
+}
+
+
+static uint32_t crop_filter_width(void *data)
+{
+	struct crop_filter_data *crop = data;
+
+	return crop->width;
+}
+
+
+static uint32_t crop_filter_height(void *data)
+{
+	struct crop_filter_data *crop = data;
+	return crop->height;
+}
+
+
+struct obs_source_info gdq_crop_filter = {
+	.id = "gdq_crop_console_filter",
+	.type = OBS_SOURCE_TYPE_FILTER,
+	.output_flags = OBS_SOURCE_VIDEO,
+	.get_name = crop_filter_get_name,
+	.create = crop_filter_create,
+	.destroy = crop_filter_destroy,
+	.update = crop_filter_update,
+	.get_properties = crop_filter_properties,
+	.get_defaults = crop_filter_defaults,
+	.video_tick = crop_filter_tick,
+	.video_render = crop_filter_render,
+	.filter_video = crop_filter_video,
+	.filter_remove = crop_filter_remove,
+	.get_width = crop_filter_width,
+	.get_height = crop_filter_height
+};
+
+bool obs_module_load(void)
+{
+	gdq_presets_init();
+	gdq_batch_init();
+	gdq_stats_init();
+
+	obs_register_source(&gdq_crop_filter);
+	obs_register_source(&scale_filter);
+	obs_register_source(&gdq_crop_scale_filter);
+	obs_register_source(&gdq_crop_region_source);
+
+	return true;
+}
+
+void obs_module_unload(void)
+{
+	gdq_batch_free();
+	gdq_prescale_free();
+	gdq_presets_free();
+	gdq_effects_free();
+	gdq_pool_free();
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <obs-module.h>
+#include <graphics/vec2.h>
+
+#define GDQ_LOG(level, format, ...) \
+	blog(level, "[gdqcrop]: " format, ##__VA_ARGS__)
+
+
+/* Pixels cut off each edge */
+struct crop_rect {
+	int                            left;
+	int                            right;
+	int                            top;
+	int                            bottom;
+};
+
+struct gdq_autocrop;
+
+enum gdq_effect_id {
+	GDQ_EFFECT_CROP,
+	GDQ_EFFECT_CROP_SCALE,
+	GDQ_EFFECT_COUNT
+};
+
+struct gdq_effect {
+	gs_effect_t                    *effect;
+	gs_eparam_t                    *image;
+	gs_eparam_t                    *mul_val;
+	gs_eparam_t                    *add_val;
+	gs_eparam_t                    *base_dimension_i;
+	gs_eparam_t                    *weights;
+	gs_eparam_t                    *area_footprint;
+	gs_eparam_t                    *sharp_prescale;
+};
+
+/* Everything a cached output depends on; see gdq-cache.c */
+struct gdq_cache_key {
+	const char                     *kind;
+	obs_source_t                   *target;
+	int                            left;
+	int                            right;
+	int                            top;
+	int                            bottom;
+	uint32_t                       cx;
+	uint32_t                       cy;
+	const void                     *variant;
+	uint32_t                       flags;
+};
+
+struct gdq_cache_entry;
+
+/* A render target borrowed from the pool; see gdq-pool.c */
+struct gdq_target {
+	gs_texrender_t                 *texrender;
+	uint32_t                       cx;
+	uint32_t                       cy;
+	enum gs_color_format           format;
+	uint64_t                       last_used;
+	struct gdq_target              *next;
+};
+
+struct gdq_pool_stats {
+	uint64_t                       current_bytes;
+	uint64_t                       peak_bytes;
+	uint64_t                       in_use_bytes;
+};
+
+/* Rolling GPU render times of a filter; see gdq-profile.c */
+struct gdq_profile_stats {
+	size_t                         count;
+	uint64_t                       min_ns;
+	uint64_t                       avg_ns;
+	uint64_t                       p99_ns;
+};
+
+struct gdq_profile;
+struct gdq_counters;
+
+enum gdq_rerender {
+	GDQ_RERENDER_ALWAYS,
+	GDQ_RERENDER_NEW_FRAME,
+	GDQ_RERENDER_INVALIDATED
+};
+
+/* Tracks whether a filter's kept output is stale; see gdq-render.c */
+struct gdq_frame_state {
+	obs_source_t                   *filter;
+	enum gdq_rerender              mode;
+	volatile long                  frames;
+	long                           rendered_frames;
+	uint64_t                       rendered_time;
+};
+
+
+/* gdq-autocrop.c */
+extern struct gdq_autocrop *gdq_autocrop_create(void);
+extern void gdq_autocrop_destroy(struct gdq_autocrop *ac);
+extern void gdq_autocrop_capture(struct gdq_autocrop *ac,
+	obs_source_t *target, uint32_t width, uint32_t height);
+extern bool gdq_autocrop_result(struct gdq_autocrop *ac,
+	struct crop_rect *rect);
+extern bool gdq_autocrop_last(struct gdq_autocrop *ac, struct crop_rect *rect);
+extern bool gdq_autocrop_detect(const uint8_t *rgba, uint32_t linesize,
+	uint32_t width, uint32_t height, uint8_t threshold,
+	struct crop_rect *rect);
+
+/* gdq-batch.c */
+extern void gdq_batch_init(void);
+extern void gdq_batch_free(void);
+
+/* gdq-cache.c */
+extern void gdq_cache_key_init(struct gdq_cache_key *key, const char *kind,
+	obs_source_t *target);
+extern struct gdq_cache_entry *gdq_cache_acquire(
+	const struct gdq_cache_key *key);
+extern void gdq_cache_release(struct gdq_cache_entry *entry);
+extern gs_texture_t *gdq_cache_lookup(struct gdq_cache_entry *entry);
+extern gs_texture_t *gdq_cache_reuse(struct gdq_cache_entry *entry);
+extern bool gdq_cache_shared(const struct gdq_cache_entry *entry);
+extern gs_texrender_t *gdq_cache_begin(struct gdq_cache_entry *entry);
+extern gs_texture_t *gdq_cache_end(struct gdq_cache_entry *entry);
+
+/* gdq-crop.c */
+extern void gdq_calc_crop(uint32_t width, uint32_t height,
+	int left, int right, int top, int bottom,
+	uint32_t *cx, uint32_t *cy, struct vec2 *mul_val, struct vec2 *add_val);
+extern void gdq_add_crop_properties(obs_properties_t *props,
+	uint32_t width, uint32_t height);
+extern const char *gdq_aspect_resolution(const char *aspect);
+extern const char *gdq_aspect_name(const char *aspect);
+extern bool gdq_is_scale_filter(obs_source_t *source);
+extern bool gdq_crop_passes_frames(obs_source_t *source);
+
+/* gdq-effects.c */
+extern const struct gdq_effect *gdq_effect_ref(enum gdq_effect_id id);
+extern void gdq_effect_unref(enum gdq_effect_id id);
+extern void gdq_effects_free(void);
+
+/* gdq-pool.c */
+extern struct gdq_target *gdq_pool_acquire(uint32_t cx, uint32_t cy,
+	enum gs_color_format format);
+extern void gdq_pool_release(struct gdq_target *target);
+extern void gdq_pool_get_stats(struct gdq_pool_stats *stats);
+extern void gdq_pool_free(void);
+
+/* gdq-prescale.c */
+extern bool gdq_prescale_supported(enum video_format format);
+extern uint32_t gdq_prescale_factor(uint32_t width, uint32_t cx);
+extern void gdq_prescale_size(enum video_format format, uint32_t width,
+	uint32_t height, uint32_t kx, uint32_t ky, uint32_t *cx, uint32_t *cy);
+extern bool gdq_prescale_frame(struct obs_source_frame *dst,
+	const struct obs_source_frame *src, uint32_t kx, uint32_t ky);
+extern bool gdq_prescale_frame_local(struct obs_source_frame *dst,
+	const struct obs_source_frame *src, uint32_t kx, uint32_t ky);
+extern size_t gdq_prescale_threads(void);
+extern void gdq_prescale_free(void);
+
+/* gdq-presets.c; the properties list presets this many at a time */
+#define GDQ_PRESETS_PAGE                100
+
+extern void gdq_presets_init(void);
+extern bool gdq_presets_set(const char *name, const char *group,
+	const struct crop_rect *rect, uint32_t width, uint32_t height);
+extern bool gdq_presets_find(const char *name, struct crop_rect *rect);
+extern bool gdq_presets_find_size(uint32_t width, uint32_t height,
+	struct crop_rect *rect);
+extern size_t gdq_presets_list(obs_property_t *p, const char *group,
+	size_t page);
+extern size_t gdq_presets_list_groups(obs_property_t *p);
+extern void gdq_presets_free(void);
+
+/* gdq-profile.c */
+extern struct gdq_profile *gdq_profile_create(obs_source_t *source);
+extern void gdq_profile_destroy(struct gdq_profile *profile);
+extern void gdq_profile_begin(struct gdq_profile *profile);
+extern void gdq_profile_end(struct gdq_profile *profile);
+extern bool gdq_profile_get_stats(struct gdq_profile *profile,
+	struct gdq_profile_stats *stats);
+extern void gdq_profile_add_property(obs_properties_t *props,
+	struct gdq_profile *profile);
+
+/* gdq-render.c */
+extern bool gdq_can_render_target(obs_source_t *filter);
+extern bool gdq_texrender_begin(gs_texrender_t *texrender,
+	uint32_t cx, uint32_t cy);
+extern void gdq_texrender_end(gs_texrender_t *texrender);
+extern bool gdq_render_region(gs_texrender_t *texrender, obs_source_t *target,
+	float left, float top, float right, float bottom,
+	uint32_t cx, uint32_t cy);
+extern bool gdq_render_subregion(gs_texrender_t *texrender,
+	obs_source_t *target, float left, float top, float right, float bottom,
+	uint32_t cx, uint32_t cy, uint32_t tex_cx, uint32_t tex_cy);
+extern void gdq_draw_texture(gs_texture_t *tex, uint32_t cx, uint32_t cy);
+extern void gdq_draw_texture_subregion(gs_texture_t *tex,
+	uint32_t cx, uint32_t cy);
+extern void gdq_frame_state_init(struct gdq_frame_state *state,
+	obs_source_t *filter);
+extern void gdq_frame_state_update(struct gdq_frame_state *state,
+	obs_data_t *settings);
+extern void gdq_frame_state_invalidate(struct gdq_frame_state *state);
+extern bool gdq_frame_state_can_reuse(const struct gdq_frame_state *state);
+extern bool gdq_frame_state_changed(const struct gdq_frame_state *state);
+extern void gdq_frame_state_rendered(struct gdq_frame_state *state);
+extern void gdq_add_rerender_property(obs_properties_t *props);
+extern void gdq_rerender_defaults(obs_data_t *settings);
+
+/* gdq-stats.c */
+extern struct gdq_counters *gdq_counters_create(obs_source_t *source,
+	const char *kind);
+extern void gdq_counters_destroy(struct gdq_counters *counters);
+extern void gdq_counters_rendered(struct gdq_counters *counters);
+extern void gdq_counters_skipped(struct gdq_counters *counters);
+extern void gdq_counters_invalid_tick(struct gdq_counters *counters);
+extern void gdq_counters_output_size(struct gdq_counters *counters,
+	uint32_t cx, uint32_t cy);
+extern void gdq_stats_init(void);
+
+/* gdq-scale.c */
+extern bool scale_parse_resolution(const char *res_str, int *cx, int *cy,
+	bool *aspect_ratio_only);
+extern enum obs_scale_type scale_parse_sampling(const char *sampling);
+extern bool scale_calc_output_size(int cx, int cy, int cx_in, int cy_in,
+	bool aspect_ratio_only, int *cx_out, int *cy_out);
+extern void scale_add_resolution_property(obs_properties_t *props);
+
+extern struct obs_source_info gdq_crop_filter;
+extern struct obs_source_info scale_filter;
+extern struct obs_source_info gdq_crop_scale_filter;
+extern struct obs_source_info gdq_crop_region_source;
@@ -0,0 +1,136 @@
+#include <obs-module.h>
+#include <util/threading.h>
+#include "gdq-crop.h"
+
+/*
+ * Module-wide effect cache.  Every filter instance used to compile its own
+ * copy of the same .effect file; now the first reference compiles it and
+ * looks up the parameter handles, later references share them, and the last
+ * unreference (or obs_module_unload) destroys it.
+ */
+
+struct effect_slot {
+	const char                     *file;
+	struct gdq_effect              effect;
+	long                           refs;
+};
+
+static struct effect_slot slots[GDQ_EFFECT_COUNT] = {
+	[GDQ_EFFECT_CROP]       = {.file = "crop_filter.effect"},
+	[GDQ_EFFECT_CROP_SCALE] = {.file = "crop_lanczos_scale.effect"},
+};
+
+/* lock order is graphics, then slots_mutex; the graphics lock is only
+ * taken when an effect actually has to be compiled or destroyed */
+static pthread_mutex_t slots_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+static bool effect_slot_load(struct effect_slot *slot)
+{
+	struct gdq_effect *e = &slot->effect;
+	char *effect_path = obs_module_file(slot->file);
+
+	e->effect = gs_effect_create_from_file(effect_path, NULL);
+
+	bfree(effect_path);
+
+	if (!e->effect) {
+		GDQ_LOG(LOG_ERROR, "%s was missing. Ensure the plugin data folder exists",
+			slot->file);
+		return false;
+	}
+
+	e->image = gs_effect_get_param_by_name(e->effect, "image");
+	e->mul_val = gs_effect_get_param_by_name(e->effect, "mul_val");
+	e->add_val = gs_effect_get_param_by_name(e->effect, "add_val");
+	e->base_dimension_i = gs_effect_get_param_by_name(e->effect,
+		"base_dimension_i");
+	e->weights = gs_effect_get_param_by_name(e->effect, "weights");
+	e->area_footprint = gs_effect_get_param_by_name(e->effect,
+		"area_footprint");
+	e->sharp_prescale = gs_effect_get_param_by_name(e->effect,
+		"sharp_prescale");
+	return true;
+}
+
+
+static void effect_slot_free(struct effect_slot *slot)
+{
+	gs_effect_destroy(slot->effect.effect);
+
+	memset(&slot->effect, 0, sizeof(slot->effect));
+	slot->refs = 0;
+}
+
+
+const struct gdq_effect *gdq_effect_ref(enum gdq_effect_id id)
+{
+	struct effect_slot *slot = &slots[id];
+	const struct gdq_effect *e = NULL;
+
+	pthread_mutex_lock(&slots_mutex);
+	if (slot->refs) {
+		slot->refs++;
+		e = &slot->effect;
+	}
+	pthread_mutex_unlock(&slots_mutex);
+
+	if (e)
+		return e;
+
+	obs_enter_graphics();
+	pthread_mutex_lock(&slots_mutex);
+
+	if (slot->refs || effect_slot_load(slot)) {
+		slot->refs++;
+		e = &slot->effect;
+	}
+
+	pthread_mutex_unlock(&slots_mutex);
+	obs_leave_graphics();
+	return e;
+}
+
+
+void gdq_effect_unref(enum gdq_effect_id id)
+{
+	struct effect_slot *slot = &slots[id];
+	bool last;
+
+	pthread_mutex_lock(&slots_mutex);
+	last = slot->refs == 1;
+	if (slot->refs > 1)
+		slot->refs--;
+	pthread_mutex_unlock(&slots_mutex);
+
+	if (!last)
+		return;
+
+	obs_enter_graphics();
+	pthread_mutex_lock(&slots_mutex);
+
+	if (slot->refs && --slot->refs == 0)
+		effect_slot_free(slot);
+
+	pthread_mutex_unlock(&slots_mutex);
+	obs_leave_graphics();
+}
+
+
+void gdq_effects_free(void)
+{
+	obs_enter_graphics();
+	pthread_mutex_lock(&slots_mutex);
+
+	for (size_t i = 0; i < GDQ_EFFECT_COUNT; i++) {
+		if (!slots[i].refs)
+			continue;
+
+		GDQ_LOG(LOG_WARNING, "%s still had %ld references at unload",
+			slots[i].file, slots[i].refs);
+		effect_slot_free(&slots[i]);
+	}
+
+	pthread_mutex_unlock(&slots_mutex);
+	obs_leave_graphics();
+}
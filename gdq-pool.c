@@ -0,0 +1,157 @@
+#include <obs-module.h>
+#include <util/threading.h>
+#include "gdq-crop.h"
+
+/*
+ * Module-wide pool of render targets.  Filters borrow a target of an exact
+ * size and format while they draw and hand it back afterwards, so the number
+ * of live targets follows how many filters render at the same time rather
+ * than how many exist.  Targets nobody asked for in a while are destroyed.
+ */
+
+/* free targets unused for this long are destroyed */
+#define POOL_MAX_IDLE_NS                2000000000ULL
+
+static struct gdq_target *free_targets;
+static uint64_t current_bytes;
+static uint64_t peak_bytes;
+static uint64_t in_use_bytes;
+static uint64_t last_trim;
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+static uint64_t target_bytes(const struct gdq_target *target)
+{
+	uint64_t bpp;
+
+	switch (target->format) {
+	case GS_RGBA16F: bpp = 8; break;
+	case GS_RGBA32F: bpp = 16; break;
+	default:         bpp = 4; break;
+	}
+
+	return (uint64_t)target->cx * target->cy * bpp;
+}
+
+
+static void pool_destroy(struct gdq_target *target)
+{
+	current_bytes -= target_bytes(target);
+	gs_texrender_destroy(target->texrender);
+	bfree(target);
+}
+
+
+/* Called with pool_mutex held, from the graphics thread, once per frame. */
+static void pool_trim(uint64_t frame_time)
+{
+	struct gdq_target **prev = &free_targets;
+	struct gdq_target *target;
+
+	while ((target = *prev) != NULL) {
+		if (frame_time - target->last_used < POOL_MAX_IDLE_NS) {
+			prev = &target->next;
+			continue;
+		}
+
+		*prev = target->next;
+		pool_destroy(target);
+	}
+}
+
+
+/* Must be called from the graphics thread. */
+struct gdq_target *gdq_pool_acquire(uint32_t cx, uint32_t cy,
+	enum gs_color_format format)
+{
+	uint64_t frame_time = obs_get_video_frame_time();
+	struct gdq_target **prev;
+	struct gdq_target *target;
+
+	pthread_mutex_lock(&pool_mutex);
+
+	if (last_trim != frame_time) {
+		last_trim = frame_time;
+		pool_trim(frame_time);
+	}
+
+	for (prev = &free_targets; (target = *prev) != NULL;
+		prev = &target->next) {
+		if (target->cx == cx && target->cy == cy &&
+			target->format == format) {
+			*prev = target->next;
+			break;
+		}
+	}
+
+	if (!target) {
+		target = bzalloc(sizeof(*target));
+		target->texrender = gs_texrender_create(format, GS_ZS_NONE);
+		target->cx = cx;
+		target->cy = cy;
+		target->format = format;
+
+		current_bytes += target_bytes(target);
+		if (current_bytes > peak_bytes)
+			peak_bytes = current_bytes;
+	}
+
+	target->next = NULL;
+	in_use_bytes += target_bytes(target);
+
+	pthread_mutex_unlock(&pool_mutex);
+
+	gs_texrender_reset(target->texrender);
+	return target;
+}
+
+
+void gdq_pool_release(struct gdq_target *target)
+{
+	if (!target)
+		return;
+
+	pthread_mutex_lock(&pool_mutex);
+
+	in_use_bytes -= target_bytes(target);
+	target->last_used = obs_get_video_frame_time();
+	target->next = free_targets;
+	free_targets = target;
+
+	pthread_mutex_unlock(&pool_mutex);
+}
+
+
+void gdq_pool_get_stats(struct gdq_pool_stats *stats)
+{
+	pthread_mutex_lock(&pool_mutex);
+	stats->current_bytes = current_bytes;
+	stats->peak_bytes = peak_bytes;
+	stats->in_use_bytes = in_use_bytes;
+	pthread_mutex_unlock(&pool_mutex);
+}
+
+
+void gdq_pool_free(void)
+{
+	struct gdq_target *target;
+
+	obs_enter_graphics();
+	pthread_mutex_lock(&pool_mutex);
+
+	while ((target = free_targets) != NULL) {
+		free_targets = target->next;
+		pool_destroy(target);
+	}
+
+	if (in_use_bytes)
+		GDQ_LOG(LOG_WARNING, "%llu bytes of render targets were "
+			"still borrowed at unload",
+			(unsigned long long)in_use_bytes);
+
+	GDQ_LOG(LOG_INFO, "render target pool peaked at %llu bytes",
+		(unsigned long long)peak_bytes);
+
+	pthread_mutex_unlock(&pool_mutex);
+	obs_leave_graphics();
+}
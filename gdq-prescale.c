@@ -0,0 +1,458 @@
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include "gdq-crop.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PRESCALE_SSE2
+#endif
+
+/*
+ * CPU pre-scaler for async frames.  A frame that ends up far smaller than it
+ * arrives is box-filtered down by a whole factor per axis before libobs
+ * uploads it, so the upload and the texture shrink with it; the GPU scale
+ * then only covers what is left.  Rows are summed with SSE2, and the output
+ * rows are split into bands worked on by a few threads, the caller included.
+ */
+
+/* the row sums of a box stay within 16 bits up to 8x8 */
+#define PRESCALE_MAX_FACTOR             8
+#define PRESCALE_MAX_THREADS            3
+#define PRESCALE_MAX_PLANES             3
+
+struct prescale_plane {
+	const uint8_t                  *src;
+	uint32_t                       src_linesize;
+	uint8_t                        *dst;
+	uint32_t                       dst_linesize;
+	uint32_t                       width;
+	uint32_t                       height;
+	uint32_t                       channels;
+};
+
+struct prescale_job {
+	struct prescale_plane          planes[PRESCALE_MAX_PLANES];
+	size_t                         num_planes;
+	uint32_t                       kx;
+	uint32_t                       ky;
+	uint32_t                       half;
+	uint64_t                       recip;
+	long                           bands;
+
+	/* row sums of the widest plane */
+	size_t                         acc_size;
+};
+
+/* Row sums; every thread keeps its own, grown to the largest job seen. */
+struct prescale_acc {
+	uint16_t                       *array;
+	size_t                         size;
+};
+
+static pthread_t threads[PRESCALE_MAX_THREADS];
+static size_t thread_count;
+static bool started;
+static bool stopping;
+
+/* one job at a time; workers pick bands off next_band until none are left */
+static const struct prescale_job *current_job;
+static uint64_t job_id;
+static long busy;
+static volatile long next_band;
+
+/* the dispatching thread's, used under dispatch_mutex */
+static struct prescale_acc caller_acc;
+
+static pthread_mutex_t dispatch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t workers_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+
+
+/* Sums ky rows of bytes into acc. */
+static void prescale_sum_rows(uint16_t *acc, const uint8_t *src,
+	size_t linesize, size_t bytes, uint32_t ky)
+{
+	size_t x = 0;
+
+#ifdef PRESCALE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; x + 16 <= bytes; x += 16) {
+		__m128i lo = zero;
+		__m128i hi = zero;
+
+		for (uint32_t y = 0; y < ky; y++) {
+			__m128i v = _mm_loadu_si128(
+				(const __m128i *)(src + y * linesize + x));
+
+			lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(v, zero));
+			hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(v, zero));
+		}
+
+		_mm_storeu_si128((__m128i *)(acc + x), lo);
+		_mm_storeu_si128((__m128i *)(acc + x + 8), hi);
+	}
+#endif
+
+	for (; x < bytes; x++) {
+		uint16_t sum = 0;
+
+		for (uint32_t y = 0; y < ky; y++)
+			sum += src[y * linesize + x];
+
+		acc[x] = sum;
+	}
+}
+
+
+/* Sums kx neighbouring pixels of the row sums and divides by the box area,
+ * rounding; recip is 2^32 / area rounded up, which is exact for these sums. */
+static void prescale_sum_columns(uint8_t *dst, const uint16_t *acc,
+	uint32_t width, uint32_t channels, uint32_t kx, uint32_t half,
+	uint64_t recip)
+{
+	size_t stride = (size_t)kx * channels;
+
+#ifdef PRESCALE_SSE2
+	if (channels == 4) {
+		for (uint32_t x = 0; x < width; x++) {
+			const uint16_t *in = acc + x * stride;
+			__m128i sum = _mm_loadl_epi64((const __m128i *)in);
+			uint16_t px[8];
+
+			for (uint32_t i = 1; i < kx; i++)
+				sum = _mm_add_epi16(sum, _mm_loadl_epi64(
+					(const __m128i *)(in + i * 4)));
+
+			_mm_storeu_si128((__m128i *)px, sum);
+			for (uint32_t c = 0; c < 4; c++)
+				dst[x * 4 + c] = (uint8_t)(
+					((px[c] + half) * recip) >> 32);
+		}
+		return;
+	}
+#endif
+
+	for (uint32_t x = 0; x < width; x++) {
+		const uint16_t *in = acc + x * stride;
+
+		for (uint32_t c = 0; c < channels; c++) {
+			uint32_t sum = half;
+
+			for (uint32_t i = 0; i < kx; i++)
+				sum += in[i * channels + c];
+
+			dst[x * channels + c] = (uint8_t)((sum * recip) >> 32);
+		}
+	}
+}
+
+
+static void prescale_band(const struct prescale_job *job, long band,
+	uint16_t *acc)
+{
+	for (size_t i = 0; i < job->num_planes; i++) {
+		const struct prescale_plane *plane = &job->planes[i];
+		size_t bytes = (size_t)plane->width * job->kx * plane->channels;
+		uint32_t y0 = (uint32_t)(plane->height * band / job->bands);
+		uint32_t y1 = (uint32_t)(plane->height * (band + 1) / job->bands);
+
+		for (uint32_t y = y0; y < y1; y++) {
+			prescale_sum_rows(acc,
+				plane->src + (size_t)y * job->ky *
+				plane->src_linesize,
+				plane->src_linesize, bytes, job->ky);
+			prescale_sum_columns(
+				plane->dst + (size_t)y * plane->dst_linesize,
+				acc, plane->width, plane->channels, job->kx,
+				job->half, job->recip);
+		}
+	}
+}
+
+
+static void prescale_acc_reserve(struct prescale_acc *acc, size_t size)
+{
+	if (size <= acc->size)
+		return;
+
+	bfree(acc->array);
+	acc->array = bmalloc(size * sizeof(*acc->array));
+	acc->size = size;
+}
+
+
+static void prescale_run_bands(const struct prescale_job *job,
+	struct prescale_acc *acc)
+{
+	long band;
+
+	prescale_acc_reserve(acc, job->acc_size);
+
+	while ((band = os_atomic_inc_long(&next_band) - 1) < job->bands)
+		prescale_band(job, band, acc->array);
+}
+
+
+static void *prescale_worker(void *unused)
+{
+	struct prescale_acc acc = {0};
+	uint64_t seen = 0;
+
+	os_set_thread_name("gdq-prescale");
+
+	pthread_mutex_lock(&workers_mutex);
+
+	for (;;) {
+		while (!stopping && job_id == seen)
+			pthread_cond_wait(&work_cond, &workers_mutex);
+		if (stopping)
+			break;
+
+		seen = job_id;
+		pthread_mutex_unlock(&workers_mutex);
+
+		prescale_run_bands(current_job, &acc);
+
+		pthread_mutex_lock(&workers_mutex);
+		if (--busy == 0)
+			pthread_cond_signal(&done_cond);
+	}
+
+	pthread_mutex_unlock(&workers_mutex);
+	bfree(acc.array);
+
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+
+/* Called with dispatch_mutex held. */
+static void prescale_start(void)
+{
+	int cores = os_get_logical_cores();
+	size_t count;
+
+	started = true;
+	stopping = false;
+
+	/* the graphics thread works on bands as well */
+	count = cores > 1 ? (size_t)(cores - 1) : 0;
+	if (count > PRESCALE_MAX_THREADS)
+		count = PRESCALE_MAX_THREADS;
+
+	for (thread_count = 0; thread_count < count; thread_count++) {
+		if (pthread_create(&threads[thread_count], NULL,
+			prescale_worker, NULL) != 0)
+			break;
+	}
+
+	GDQ_LOG(LOG_INFO, "pre-scaling on %zu worker threads",
+		thread_count);
+}
+
+
+static void prescale_dispatch(struct prescale_job *job)
+{
+	pthread_mutex_lock(&dispatch_mutex);
+
+	if (!started)
+		prescale_start();
+
+	/* a few bands per thread even out bands that take longer */
+	job->bands = (long)(thread_count + 1) * 2;
+
+	pthread_mutex_lock(&workers_mutex);
+	current_job = job;
+	os_atomic_set_long(&next_band, 0);
+	busy = (long)thread_count;
+	job_id++;
+	pthread_cond_broadcast(&work_cond);
+	pthread_mutex_unlock(&workers_mutex);
+
+	prescale_run_bands(job, &caller_acc);
+
+	pthread_mutex_lock(&workers_mutex);
+	while (busy)
+		pthread_cond_wait(&done_cond, &workers_mutex);
+	current_job = NULL;
+	pthread_mutex_unlock(&workers_mutex);
+
+	pthread_mutex_unlock(&dispatch_mutex);
+}
+
+
+bool gdq_prescale_supported(enum video_format format)
+{
+	switch (format) {
+	case VIDEO_FORMAT_I420:
+	case VIDEO_FORMAT_NV12:
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+		return true;
+	default:
+		return false;
+	}
+}
+
+
+/* Largest whole factor that keeps width by height at or above cx by cy. */
+uint32_t gdq_prescale_factor(uint32_t width, uint32_t cx)
+{
+	uint32_t k = cx ? width / cx : 1;
+
+	if (k < 1)
+		return 1;
+	return k > PRESCALE_MAX_FACTOR ? PRESCALE_MAX_FACTOR : k;
+}
+
+
+/* Size of the pre-scaled frame.  Subsampled chroma keeps it even, so every
+ * chroma sample of the output covers whole chroma samples of the input. */
+void gdq_prescale_size(enum video_format format, uint32_t width,
+	uint32_t height, uint32_t kx, uint32_t ky, uint32_t *cx, uint32_t *cy)
+{
+	*cx = width / kx;
+	*cy = height / ky;
+
+	if (format == VIDEO_FORMAT_I420 || format == VIDEO_FORMAT_NV12) {
+		*cx &= ~1u;
+		*cy &= ~1u;
+	}
+}
+
+
+static void prescale_add_plane(struct prescale_job *job,
+	const struct obs_source_frame *src, struct obs_source_frame *dst,
+	size_t plane, uint32_t width, uint32_t height, uint32_t channels)
+{
+	struct prescale_plane *p = &job->planes[job->num_planes++];
+	size_t acc_size = (size_t)width * job->kx * channels;
+
+	p->src = src->data[plane];
+	p->src_linesize = src->linesize[plane];
+	p->dst = dst->data[plane];
+	p->dst_linesize = dst->linesize[plane];
+	p->width = width;
+	p->height = height;
+	p->channels = channels;
+
+	if (acc_size > job->acc_size)
+		job->acc_size = acc_size;
+}
+
+
+static bool prescale_job_init(struct prescale_job *job,
+	struct obs_source_frame *dst, const struct obs_source_frame *src,
+	uint32_t kx, uint32_t ky)
+{
+	uint32_t cx = dst->width;
+	uint32_t cy = dst->height;
+
+	if (src->format != dst->format || !kx || !ky ||
+		kx > PRESCALE_MAX_FACTOR || ky > PRESCALE_MAX_FACTOR ||
+		cx * kx > src->width || cy * ky > src->height)
+		return false;
+
+	job->kx = kx;
+	job->ky = ky;
+
+	switch (src->format) {
+	case VIDEO_FORMAT_I420:
+		prescale_add_plane(job, src, dst, 0, cx, cy, 1);
+		prescale_add_plane(job, src, dst, 1, cx / 2, cy / 2, 1);
+		prescale_add_plane(job, src, dst, 2, cx / 2, cy / 2, 1);
+		break;
+	case VIDEO_FORMAT_NV12:
+		prescale_add_plane(job, src, dst, 0, cx, cy, 1);
+		prescale_add_plane(job, src, dst, 1, cx / 2, cy / 2, 2);
+		break;
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+		prescale_add_plane(job, src, dst, 0, cx, cy, 4);
+		break;
+	default:
+		return false;
+	}
+
+	job->half = kx * ky / 2;
+	job->recip = ((1ULL << 32) + kx * ky - 1) / (kx * ky);
+	return true;
+}
+
+
+/* Box-filters src into dst, which has to be of the same format and of the
+ * size gdq_prescale_size gives for kx and ky.  Only the planes are written. */
+bool gdq_prescale_frame(struct obs_source_frame *dst,
+	const struct obs_source_frame *src, uint32_t kx, uint32_t ky)
+{
+	struct prescale_job job = {0};
+
+	if (!prescale_job_init(&job, dst, src, kx, ky))
+		return false;
+
+	prescale_dispatch(&job);
+	return true;
+}
+
+
+/* Same as gdq_prescale_frame, but all on the calling thread with a row buffer
+ * of its own, so it never waits on or holds up the shared workers. */
+bool gdq_prescale_frame_local(struct obs_source_frame *dst,
+	const struct obs_source_frame *src, uint32_t kx, uint32_t ky)
+{
+	struct prescale_job job = {0};
+	struct prescale_acc acc = {0};
+
+	if (!prescale_job_init(&job, dst, src, kx, ky))
+		return false;
+
+	job.bands = 1;
+	prescale_acc_reserve(&acc, job.acc_size);
+	prescale_band(&job, 0, acc.array);
+	bfree(acc.array);
+	return true;
+}
+
+
+/* Threads a pre-scale is split across, the caller included. */
+size_t gdq_prescale_threads(void)
+{
+	size_t count;
+
+	pthread_mutex_lock(&dispatch_mutex);
+	count = thread_count + 1;
+	pthread_mutex_unlock(&dispatch_mutex);
+
+	return count;
+}
+
+
+void gdq_prescale_free(void)
+{
+	pthread_mutex_lock(&dispatch_mutex);
+
+	if (started) {
+		pthread_mutex_lock(&workers_mutex);
+		stopping = true;
+		pthread_cond_broadcast(&work_cond);
+		pthread_mutex_unlock(&workers_mutex);
+
+		for (size_t i = 0; i < thread_count; i++)
+			pthread_join(threads[i], NULL);
+
+		thread_count = 0;
+		started = false;
+	}
+
+	bfree(caller_acc.array);
+	caller_acc.array = NULL;
+	caller_acc.size = 0;
+
+	pthread_mutex_unlock(&dispatch_mutex);
+}
@@ -0,0 +1,1316 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <obs-module.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include "gdq-crop.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+/*
+ * Crop preset store.  Presets keep the order they were loaded or added in,
+ * are found by name through a hash index, and can be grouped (usually by
+ * console) so the properties only ever list one group at a time.
+ *
+ * The preset file is a list of
+ *
+ *     <name>
+ *         left:<n>, right:<n>, top:<n>, bottom:<n>[, size:<w>x<h>][, group:<g>]
+ *
+ * where the size and the group are optional.  A preset with a size is meant
+ * for sources of that base size, and can be found by it as well.
+ *
+ * The file lives in the module's config directory and is only written by a
+ * background thread.  A saved preset is appended to a journal next to it,
+ * which is read after the file on load; once the journal grows long, and at
+ * unload, the whole file is rewritten through a temporary file and renamed
+ * over the old one, and the journal is removed.
+ *
+ * The presets are published as tables that are never changed once they are
+ * visible, and readers do not lock.  A change makes a new table that shares
+ * all it does not touch with the current one: the preset records never
+ * change, and the tables keep them and their indexes in persistent vectors,
+ * so only the nodes on the way to a changed slot are copied.  What the new
+ * table no longer uses is freed once the readers that may still see it are
+ * gone.  A watcher thread reloads the file when something else replaces it.
+ */
+
+#define PRESETS_FILE                    "gdq-crop.cfg"
+#define PRESETS_JOURNAL                 "gdq-crop.journal"
+/* saves arriving within this long of each other are written together */
+#define WRITER_COALESCE_MS              250
+/* journal records before the file is rewritten */
+#define JOURNAL_MAX_RECORDS             256
+/* how often the file is looked at without change notifications, and how
+ * long a notified change is left to settle before it is reloaded */
+#define WATCH_INTERVAL_MS               1000
+#define WATCH_SETTLE_MS                 200
+
+/* Persistent vectors: tries of PVEC_WIDTH wide nodes, where a change copies
+ * the nodes on the path to the item it changes and shares the rest with the
+ * vector it was made from.  A node made by the change in progress is
+ * changed in place. */
+#define PVEC_BITS                       5
+#define PVEC_WIDTH                      (1 << PVEC_BITS)
+#define PVEC_MASK                       (PVEC_WIDTH - 1)
+
+/* inner nodes hold nodes, leaves hold values */
+union pvec_item {
+	struct pvec_node               *node;
+	uintptr_t                      value;
+};
+
+struct pvec_node {
+	/* the change that made it */
+	long                           gen;
+	union pvec_item                items[PVEC_WIDTH];
+};
+
+/* a missing node reads as zeroes, so a vector of a fixed size starts out
+ * empty */
+struct pvec {
+	struct pvec_node               *root;
+	size_t                         num;
+	unsigned                       shift;
+};
+
+/* Never changed once it is in a table; a change to a preset makes a new
+ * record.  The name is kept right after it. */
+struct preset {
+	char                           *name;
+	struct crop_rect               rect;
+	uint32_t                       width;
+	uint32_t                       height;
+	size_t                         group;
+};
+
+struct preset_group {
+	/* shared by every table since the group was added */
+	char                           *name;
+	/* positions of its presets */
+	struct pvec                    members;
+};
+
+struct preset_table {
+	/* struct preset pointers */
+	struct pvec                    presets;
+
+	/* copied by every change, as there are few; group 0 holds the
+	 * ungrouped presets */
+	struct preset_group            *groups;
+	size_t                         num_groups;
+
+	/* open addressing; a slot holds the preset's position plus one, 0 is
+	 * empty, and the index is kept at most half full */
+	struct pvec                    slots;
+
+	/* the same for the presets with a size, keyed by it and counting
+	 * the sizes; where several share a size the last one wins */
+	struct pvec                    size_slots;
+	size_t                         size_count;
+};
+
+/* A change being made to a copy of the current table, and what it no
+ * longer uses of the tables before. */
+struct preset_edit {
+	struct preset_table            *t;
+	long                           gen;
+	DARRAY(void *)                 garbage;
+};
+/* the sub-second part of the time is 0 where stat has none */
+struct file_stamp {
+	int64_t                        mtime;
+	int64_t                        mtime_ns;
+	int64_t                        size;
+	uint64_t                       ino;
+};
+
+/* Readers count themselves in on the epoch they start in.  What a change
+ * replaces is kept in the limbo of the epoch it was made in and freed once
+ * that epoch is over and its readers are gone, as the readers of later
+ * epochs never saw it.  Epochs only move on under update_mutex. */
+static struct preset_table *volatile current_table;
+static volatile long epoch;
+static volatile long readers[3];
+static DARRAY(void *) limbo[3];
+static volatile long next_gen;
+
+/* serializes changes; readers never take it */
+static pthread_mutex_t update_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* names of presets saved since the last write, whether the whole file has
+ * to be written, and the records in the journal; all under queue_mutex */
+static DARRAY(char *) save_queue;
+static bool rewrite_pending;
+static size_t journal_records;
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* held by the writer from taking the queue until the files are written,
+ * and by a reload while it reads them, so a reload sees a save either in
+ * the queue or in the files; taken before update_mutex */
+static pthread_mutex_t write_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static char *presets_path;
+static char *journal_path;
+static bool writer_started;
+static pthread_t writer_thread;
+static os_event_t *writer_event;
+static volatile bool writer_stop;
+
+/* the file as it was last loaded or written here, so the watcher can tell
+ * the writer's own changes from anyone else's */
+static struct file_stamp known_stamp;
+static pthread_mutex_t stamp_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool watcher_started;
+static pthread_t watcher_thread;
+static volatile bool watcher_stop;
+
+
+static void edit_retire(struct preset_edit *edit, void *ptr)
+{
+	if (ptr)
+		da_push_back(edit->garbage, &ptr);
+}
+
+
+static uintptr_t pvec_get(const struct pvec *v, size_t i)
+{
+	const struct pvec_node *node = v->root;
+
+	for (unsigned shift = v->shift; node && shift; shift -= PVEC_BITS)
+		node = node->items[(i >> shift) & PVEC_MASK].node;
+
+	return node ? node->items[i & PVEC_MASK].value : 0;
+}
+
+
+/* Returns the node at *slot made by this change, copying or creating it
+ * first if there is none. */
+static struct pvec_node *pvec_node_edit(struct preset_edit *edit,
+	struct pvec_node **slot)
+{
+	struct pvec_node *node = *slot;
+
+	if (node && node->gen == edit->gen)
+		return node;
+
+	if (node) {
+		*slot = bmemdup(node, sizeof(*node));
+		edit_retire(edit, node);
+	} else {
+		*slot = bzalloc(sizeof(*node));
+	}
+
+	(*slot)->gen = edit->gen;
+	return *slot;
+}
+
+
+static void pvec_set(struct preset_edit *edit, struct pvec *v, size_t i,
+	uintptr_t value)
+{
+	struct pvec_node **slot = &v->root;
+
+	for (unsigned shift = v->shift;; shift -= PVEC_BITS) {
+		struct pvec_node *node = pvec_node_edit(edit, slot);
+
+		if (!shift) {
+			node->items[i & PVEC_MASK].value = value;
+			return;
+		}
+		slot = &node->items[(i >> shift) & PVEC_MASK].node;
+	}
+}
+
+
+static void pvec_push(struct preset_edit *edit, struct pvec *v,
+	uintptr_t value)
+{
+	/* a full trie gets a new root above it */
+	if (v->num == (size_t)PVEC_WIDTH << v->shift) {
+		struct pvec_node *root = bzalloc(sizeof(*root));
+
+		root->gen = edit->gen;
+		root->items[0].node = v->root;
+		v->root = root;
+		v->shift += PVEC_BITS;
+	}
+
+	pvec_set(edit, v, v->num++, value);
+}
+
+
+/* Makes v an empty vector of num zeroes. */
+static void pvec_init_size(struct pvec *v, size_t num)
+{
+	v->root = NULL;
+	v->num = num;
+	v->shift = 0;
+
+	while (((size_t)PVEC_WIDTH << v->shift) < num)
+		v->shift += PVEC_BITS;
+}
+
+
+static void pvec_node_retire(struct preset_edit *edit,
+	struct pvec_node *node, unsigned shift, bool owned)
+{
+	if (!node)
+		return;
+
+	for (size_t i = 0; i < PVEC_WIDTH && (shift || owned); i++) {
+		if (shift)
+			pvec_node_retire(edit, node->items[i].node,
+				shift - PVEC_BITS, owned);
+		else
+			edit_retire(edit, (void *)node->items[i].value);
+	}
+
+	edit_retire(edit, node);
+}
+
+
+/* Retires every node of v, and its values as well if they are pointers the
+ * vector owns. */
+static void pvec_retire(struct preset_edit *edit, struct pvec *v, bool owned)
+{
+	pvec_node_retire(edit, v->root, v->shift, owned);
+	v->root = NULL;
+}
+
+
+static uint32_t preset_hash(const char *name)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*name) {
+		hash ^= (uint8_t)*name++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+
+static struct preset *preset_create(const char *name, size_t group,
+	const struct crop_rect *rect, uint32_t width, uint32_t height)
+{
+	size_t len = strlen(name);
+	struct preset *preset = bmalloc(sizeof(*preset) + len + 1);
+
+	preset->name = (char *)(preset + 1);
+	memcpy(preset->name, name, len + 1);
+	preset->rect = *rect;
+	preset->width = width;
+	preset->height = height;
+	preset->group = group;
+	return preset;
+}
+
+
+static const struct preset *table_preset(const struct preset_table *t,
+	size_t pos)
+{
+	return (const struct preset *)pvec_get(&t->presets, pos);
+}
+
+
+/* Index of the slot holding name, or of the empty slot it would go into. */
+static size_t table_slot(const struct preset_table *t, const char *name)
+{
+	size_t mask = t->slots.num - 1;
+	size_t i = preset_hash(name) & mask;
+	uintptr_t slot;
+
+	while ((slot = pvec_get(&t->slots, i)) &&
+		strcmp(table_preset(t, slot - 1)->name, name) != 0)
+		i = (i + 1) & mask;
+
+	return i;
+}
+
+
+static void table_grow(struct preset_edit *edit)
+{
+	struct preset_table *t = edit->t;
+	size_t size = t->slots.num ? t->slots.num * 2 : 64;
+
+	pvec_retire(edit, &t->slots, false);
+	pvec_init_size(&t->slots, size);
+
+	for (size_t pos = 0; pos < t->presets.num; pos++)
+		pvec_set(edit, &t->slots,
+			table_slot(t, table_preset(t, pos)->name), pos + 1);
+}
+
+
+static uint32_t size_hash(uint32_t width, uint32_t height)
+{
+	uint32_t hash = width * 2654435761u ^ height;
+
+	return hash ^ (hash >> 16);
+}
+
+
+static size_t table_size_slot(const struct preset_table *t,
+	uint32_t width, uint32_t height)
+{
+	size_t mask = t->size_slots.num - 1;
+	size_t i = size_hash(width, height) & mask;
+	uintptr_t slot;
+
+	while ((slot = pvec_get(&t->size_slots, i))) {
+		const struct preset *preset = table_preset(t, slot - 1);
+
+		if (preset->width == width && preset->height == height)
+			break;
+		i = (i + 1) & mask;
+	}
+
+	return i;
+}
+
+
+static void table_reindex_sizes(struct preset_edit *edit, size_t size);
+
+static void table_index_size(struct preset_edit *edit, size_t pos)
+{
+	struct preset_table *t = edit->t;
+	const struct preset *preset = table_preset(t, pos);
+	uintptr_t slot;
+	size_t i;
+
+	if (!preset->width)
+		return;
+
+	if ((t->size_count + 1) * 2 > t->size_slots.num)
+		table_reindex_sizes(edit, t->size_slots.num ?
+			t->size_slots.num * 2 : 16);
+
+	i = table_size_slot(t, preset->width, preset->height);
+	slot = pvec_get(&t->size_slots, i);
+	if (!slot)
+		t->size_count++;
+	if (slot < pos + 1)
+		pvec_set(edit, &t->size_slots, i, pos + 1);
+}
+
+
+static void table_reindex_sizes(struct preset_edit *edit, size_t size)
+{
+	struct preset_table *t = edit->t;
+
+	pvec_retire(edit, &t->size_slots, false);
+	pvec_init_size(&t->size_slots, size);
+	t->size_count = 0;
+
+	for (size_t pos = 0; pos < t->presets.num; pos++)
+		table_index_size(edit, pos);
+}
+
+
+static const struct preset *table_lookup(const struct preset_table *t,
+	const char *name)
+{
+	uintptr_t slot;
+
+	if (!t || !t->slots.num)
+		return NULL;
+
+	slot = pvec_get(&t->slots, table_slot(t, name));
+	return slot ? table_preset(t, slot - 1) : NULL;
+}
+
+
+/* Starts a change to a copy of src, or to a new table without src.  Only
+ * the table itself and its groups are copied; the copies of src replace
+ * them. */
+static void edit_begin(struct preset_edit *edit, struct preset_table *src)
+{
+	struct preset_table *t;
+
+	edit->gen = os_atomic_inc_long(&next_gen);
+	da_init(edit->garbage);
+
+	if (src) {
+		t = bmemdup(src, sizeof(*src));
+		t->groups = bmemdup(src->groups,
+			src->num_groups * sizeof(*src->groups));
+		edit_retire(edit, src->groups);
+		edit_retire(edit, src);
+	} else {
+		t = bzalloc(sizeof(*t));
+		t->groups = bzalloc(sizeof(*t->groups));
+		t->num_groups = 1;
+	}
+
+	edit->t = t;
+}
+
+
+/* Retires all of t, which nothing after it shares. */
+static void table_retire_all(struct preset_edit *edit, struct preset_table *t)
+{
+	if (!t)
+		return;
+
+	for (size_t i = 0; i < t->num_groups; i++) {
+		edit_retire(edit, t->groups[i].name);
+		pvec_retire(edit, &t->groups[i].members, false);
+	}
+	edit_retire(edit, t->groups);
+
+	pvec_retire(edit, &t->presets, true);
+	pvec_retire(edit, &t->slots, false);
+	pvec_retire(edit, &t->size_slots, false);
+	edit_retire(edit, t);
+}
+
+
+/* Only once nothing reads t. */
+static void table_destroy(struct preset_table *t)
+{
+	struct preset_edit edit = {0};
+
+	table_retire_all(&edit, t);
+
+	for (size_t i = 0; i < edit.garbage.num; i++)
+		bfree(edit.garbage.array[i]);
+	da_free(edit.garbage);
+}
+
+
+/* Groups are few, so they are looked up by walking them. */
+static size_t table_group(struct preset_edit *edit, const char *name)
+{
+	struct preset_table *t = edit->t;
+	struct preset_group *group;
+
+	if (!name || !*name)
+		return 0;
+
+	for (size_t i = 1; i < t->num_groups; i++) {
+		if (strcmp(t->groups[i].name, name) == 0)
+			return i;
+	}
+
+	t->groups = brealloc(t->groups,
+		(t->num_groups + 1) * sizeof(*t->groups));
+	group = &t->groups[t->num_groups];
+	group->name = bstrdup(name);
+	memset(&group->members, 0, sizeof(group->members));
+	return t->num_groups++;
+}
+
+
+/* Presets rarely change groups, so the group's members are rebuilt. */
+static void table_remove_member(struct preset_edit *edit, size_t group,
+	size_t pos)
+{
+	struct preset_group *g = &edit->t->groups[group];
+	struct pvec members = {0};
+
+	for (size_t i = 0; i < g->members.num; i++) {
+		uintptr_t member = pvec_get(&g->members, i);
+
+		if (member != pos)
+			pvec_push(edit, &members, member);
+	}
+
+	pvec_retire(edit, &g->members, false);
+	g->members = members;
+}
+
+
+/* Returns true if the preset is new. */
+static bool table_set(struct preset_edit *edit, const char *name,
+	const char *group, const struct crop_rect *rect,
+	uint32_t width, uint32_t height)
+{
+	struct preset_table *t = edit->t;
+	size_t new_group = table_group(edit, group);
+	struct preset *preset =
+		preset_create(name, new_group, rect, width, height);
+	const struct preset *old;
+	uintptr_t pos;
+
+	pos = t->slots.num ? pvec_get(&t->slots, table_slot(t, name)) : 0;
+	if (pos) {
+		bool reindex;
+
+		old = table_preset(t, --pos);
+
+		/* the preset found for the old size may have to be another
+		 * one now, which only a new index tells */
+		reindex = old->width &&
+			(old->width != width || old->height != height) &&
+			pvec_get(&t->size_slots, table_size_slot(t,
+				old->width, old->height)) == pos + 1;
+
+		if (old->group != new_group) {
+			table_remove_member(edit, old->group, pos);
+			pvec_push(edit, &t->groups[new_group].members, pos);
+		}
+
+		pvec_set(edit, &t->presets, pos, (uintptr_t)preset);
+		edit_retire(edit, (void *)old);
+
+		if (reindex)
+			table_reindex_sizes(edit, t->size_slots.num);
+		else
+			table_index_size(edit, pos);
+		return false;
+	}
+
+	if ((t->presets.num + 1) * 2 > t->slots.num)
+		table_grow(edit);
+
+	pos = t->presets.num;
+	pvec_push(edit, &t->presets, (uintptr_t)preset);
+	pvec_push(edit, &t->groups[new_group].members, pos);
+	pvec_set(edit, &t->slots, table_slot(t, name), pos + 1);
+	table_index_size(edit, pos);
+	return true;
+}
+
+
+/* Returns the current table, which stays valid until table_read_end. */
+static const struct preset_table *table_read_begin(long *e)
+{
+	for (;;) {
+		*e = os_atomic_load_long(&epoch);
+		os_atomic_inc_long(&readers[*e % 3]);
+
+		/* the epoch may have moved on before this reader was counted
+		 * in, and what it replaced freed; the new one is read
+		 * instead */
+		if (os_atomic_load_long(&epoch) == *e)
+			return current_table;
+
+		os_atomic_dec_long(&readers[*e % 3]);
+	}
+}
+
+
+static void table_read_end(long e)
+{
+	os_atomic_dec_long(&readers[e % 3]);
+}
+
+
+/* Called with update_mutex held, which keeps the current table from being
+ * replaced. */
+static struct preset_table *table_current(void)
+{
+	return current_table;
+}
+
+
+/* Called with update_mutex held.  Moves on to the next epoch if the one
+ * before the current one has no readers left, and frees what was replaced
+ * in it; returns false if it still has readers. */
+static bool presets_reclaim(void)
+{
+	long e = os_atomic_load_long(&epoch);
+	size_t prev = (size_t)(e + 2) % 3;
+
+	if (os_atomic_load_long(&readers[prev]))
+		return false;
+
+	for (size_t i = 0; i < limbo[prev].num; i++)
+		bfree(limbo[prev].array[i]);
+	da_clear(limbo[prev]);
+
+	os_atomic_set_long(&epoch, e + 1);
+	return true;
+}
+
+
+/* Called with update_mutex held.  Makes the edited table the current one;
+ * what it replaced is freed once no reader can see it, which without
+ * readers is right away. */
+static void table_publish(struct preset_edit *edit)
+{
+	size_t cur = (size_t)os_atomic_load_long(&epoch) % 3;
+
+	current_table = edit->t;
+
+	for (size_t i = 0; i < edit->garbage.num; i++)
+		da_push_back(limbo[cur], &edit->garbage.array[i]);
+	da_free(edit->garbage);
+
+	if (presets_reclaim())
+		presets_reclaim();
+}
+
+
+/* Stores a preset and queues it to be saved.  A preset with a width and a
+ * height is for sources of that base size.  Returns true if the preset is
+ * new. */
+bool gdq_presets_set(const char *name, const char *group,
+	const struct crop_rect *rect, uint32_t width, uint32_t height)
+{
+	struct preset_edit edit;
+	bool queued = false;
+	bool added;
+
+	pthread_mutex_lock(&update_mutex);
+	edit_begin(&edit, table_current());
+	added = table_set(&edit, name, group, rect, width, height);
+	table_publish(&edit);
+	pthread_mutex_unlock(&update_mutex);
+
+	pthread_mutex_lock(&queue_mutex);
+	for (size_t i = 0; i < save_queue.num && !queued; i++)
+		queued = strcmp(save_queue.array[i], name) == 0;
+	if (!queued) {
+		char *copy = bstrdup(name);
+		da_push_back(save_queue, &copy);
+	}
+	pthread_mutex_unlock(&queue_mutex);
+
+	if (writer_started)
+		os_event_signal(writer_event);
+	return added;
+}
+
+
+bool gdq_presets_find(const char *name, struct crop_rect *rect)
+{
+	const struct preset *preset;
+	long e;
+
+	preset = table_lookup(table_read_begin(&e), name);
+	if (preset)
+		*rect = preset->rect;
+	table_read_end(e);
+
+	return preset != NULL;
+}
+
+
+/* Finds the preset recorded for sources of the given base size. */
+bool gdq_presets_find_size(uint32_t width, uint32_t height,
+	struct crop_rect *rect)
+{
+	const struct preset_table *t;
+	uintptr_t slot = 0;
+	long e;
+
+	t = table_read_begin(&e);
+	if (t && t->size_slots.num && width && height) {
+		slot = pvec_get(&t->size_slots,
+			table_size_slot(t, width, height));
+		if (slot)
+			*rect = table_preset(t, slot - 1)->rect;
+	}
+	table_read_end(e);
+
+	return slot != 0;
+}
+
+
+/* Adds the names of the presets in group ("" for the ungrouped ones) to a
+ * string list, only those on the given page of GDQ_PRESETS_PAGE; returns how
+ * many presets the group has. */
+size_t gdq_presets_list(obs_property_t *p, const char *group, size_t page)
+{
+	const struct preset_table *t;
+	size_t count = 0;
+	long e;
+
+	t = table_read_begin(&e);
+
+	for (size_t i = 0; t && i < t->num_groups; i++) {
+		const struct preset_group *g = &t->groups[i];
+		size_t end = (page + 1) * GDQ_PRESETS_PAGE;
+
+		if (i ? strcmp(g->name, group) != 0 : *group != 0)
+			continue;
+
+		count = g->members.num;
+		for (size_t j = page * GDQ_PRESETS_PAGE; j < count && j < end;
+			j++) {
+			const char *name = table_preset(t,
+				pvec_get(&g->members, j))->name;
+
+			obs_property_list_add_string(p, name, name);
+		}
+		break;
+	}
+
+	table_read_end(e);
+	return count;
+}
+
+
+/* Adds the group names to a string list; returns how many there are. */
+size_t gdq_presets_list_groups(obs_property_t *p)
+{
+	const struct preset_table *t;
+	size_t count = 0;
+	long e;
+
+	t = table_read_begin(&e);
+
+	for (size_t i = 1; t && i < t->num_groups; i++) {
+		obs_property_list_add_string(p, t->groups[i].name,
+			t->groups[i].name);
+		count++;
+	}
+
+	table_read_end(e);
+	return count;
+}
+
+
+/* Reads "key:<int>" at *pos, skipping separators before it. */
+static bool parse_field(const char **pos, const char *key, int *val)
+{
+	const char *p = *pos;
+	size_t len = strlen(key);
+	char *end;
+
+	while (*p == ' ' || *p == '\t' || *p == ',')
+		p++;
+
+	if (strncmp(p, key, len) != 0)
+		return false;
+
+	*val = (int)strtol(p + len, &end, 10);
+	if (end == p + len)
+		return false;
+
+	*pos = end;
+	return true;
+}
+
+
+/* Cuts the line at *pos off and moves past it. */
+static char *next_line(char **pos)
+{
+	char *line = *pos;
+	char *end = strchr(line, '\n');
+
+	if (!end) {
+		*pos = line + strlen(line);
+		return line;
+	}
+
+	*pos = end + 1;
+	*end = 0;
+	if (end > line && end[-1] == '\r')
+		end[-1] = 0;
+	return line;
+}
+
+
+static void parse_preset(struct preset_edit *edit, const char *name,
+	const char *line, struct dstr *group)
+{
+	const char *p = line;
+	struct crop_rect rect;
+	uint32_t width = 0;
+	uint32_t height = 0;
+
+	if (!parse_field(&p, "left:", &rect.left) ||
+		!parse_field(&p, "right:", &rect.right) ||
+		!parse_field(&p, "top:", &rect.top) ||
+		!parse_field(&p, "bottom:", &rect.bottom))
+		return;
+
+	dstr_free(group);
+	while (*p == ' ' || *p == ',')
+		p++;
+	if (strncmp(p, "size:", 5) == 0) {
+		char *end;
+
+		width = (uint32_t)strtoul(p + 5, &end, 10);
+		height = *end == 'x' ?
+			(uint32_t)strtoul(end + 1, &end, 10) : 0;
+		if (!width || !height)
+			width = height = 0;
+
+		p = end;
+		while (*p == ' ' || *p == ',')
+			p++;
+	}
+	if (strncmp(p, "group:", 6) == 0) {
+		dstr_copy(group, p + 6);
+		dstr_depad(group);
+	}
+
+	table_set(edit, name, group->array ? group->array : "", &rect,
+		width, height);
+}
+
+
+/* Loads a preset file into an unpublished table in one read and returns
+ * how many records it had; a missing file has none.  A journal may end in
+ * a record cut short by a crash, which is dropped. */
+static size_t presets_load(struct preset_edit *edit, const char *path,
+	bool journal)
+{
+	char *file = os_quick_read_utf8_file(path);
+	struct dstr group = {0};
+	char *pos = file;
+	size_t records = 0;
+	uint64_t start = os_gettime_ns();
+
+	if (!file)
+		return 0;
+
+	if (journal) {
+		char *end = strrchr(file, '\n');
+
+		if (end)
+			end[1] = 0;
+		else
+			*file = 0;
+	}
+
+	while (*pos) {
+		char *name = next_line(&pos);
+
+		/* a name without its rect line is skipped */
+		if (!*name || (*pos != '\t' && *pos != ' '))
+			continue;
+
+		parse_preset(edit, name, next_line(&pos), &group);
+		records++;
+	}
+
+	GDQ_LOG(LOG_INFO, "loaded %zu records from %s in %.1f ms, "
+		"%zu presets in total", records, path,
+		(double)(os_gettime_ns() - start) / 1000000.0,
+		edit->t->presets.num);
+
+	dstr_free(&group);
+	bfree(file);
+	return records;
+}
+
+
+static void file_stamp_get(const char *path, struct file_stamp *stamp)
+{
+	struct stat st;
+
+	memset(stamp, 0, sizeof(*stamp));
+	if (stat(path, &st) != 0)
+		return;
+
+	stamp->mtime = (int64_t)st.st_mtime;
+#if defined(__APPLE__)
+	stamp->mtime_ns = (int64_t)st.st_mtimespec.tv_nsec;
+#elif !defined(_WIN32)
+	stamp->mtime_ns = (int64_t)st.st_mtim.tv_nsec;
+#endif
+	stamp->size = (int64_t)st.st_size;
+	stamp->ino = (uint64_t)st.st_ino;
+}
+
+
+static void known_stamp_update(void)
+{
+	struct file_stamp stamp;
+
+	file_stamp_get(presets_path, &stamp);
+
+	pthread_mutex_lock(&stamp_mutex);
+	known_stamp = stamp;
+	pthread_mutex_unlock(&stamp_mutex);
+}
+
+
+/* Replaces the presets with what the file and the journal hold now.  The
+ * journal is read after the file, so saves it has not been folded into yet
+ * still win over a file copied in from elsewhere. */
+static void presets_reload(void)
+{
+	struct preset_table *cur;
+	struct preset_edit edit;
+	size_t records;
+
+	pthread_mutex_lock(&write_mutex);
+
+	edit_begin(&edit, NULL);
+	known_stamp_update();
+	presets_load(&edit, presets_path, false);
+	records = presets_load(&edit, journal_path, true);
+
+	pthread_mutex_lock(&update_mutex);
+	pthread_mutex_lock(&queue_mutex);
+
+	/* saves the writer has not got to yet are carried over */
+	cur = table_current();
+	for (size_t i = 0; i < save_queue.num; i++) {
+		const struct preset *preset =
+			table_lookup(cur, save_queue.array[i]);
+
+		if (preset)
+			table_set(&edit, preset->name,
+				cur->groups[preset->group].name,
+				&preset->rect, preset->width, preset->height);
+	}
+
+	journal_records = records;
+	table_retire_all(&edit, cur);
+	table_publish(&edit);
+
+	pthread_mutex_unlock(&queue_mutex);
+	pthread_mutex_unlock(&update_mutex);
+	pthread_mutex_unlock(&write_mutex);
+}
+
+
+static void preset_serialize(struct dstr *out, const struct preset_table *t,
+	const struct preset *preset)
+{
+	dstr_catf(out, "%s\n\tleft:%d, right:%d, top:%d, bottom:%d",
+		preset->name,
+		preset->rect.left, preset->rect.right,
+		preset->rect.top, preset->rect.bottom);
+	if (preset->width)
+		dstr_catf(out, ", size:%ux%u", preset->width, preset->height);
+	if (preset->group)
+		dstr_catf(out, ", group:%s", t->groups[preset->group].name);
+	dstr_cat(out, "\n");
+}
+
+
+static bool journal_append(const struct dstr *records)
+{
+	FILE *file = os_fopen(journal_path, "ab");
+	bool success;
+
+	if (!file)
+		return false;
+
+	success = fwrite(records->array, 1, records->len, file) ==
+		records->len;
+	success = fflush(file) == 0 && success;
+	success = fclose(file) == 0 && success;
+	return success;
+}
+
+
+/* Writes what was saved since the last call: appended to the journal, or
+ * as a new file when the journal got long or compact is set.  Only called
+ * from the writer thread. */
+static void presets_flush(bool compact)
+{
+	const struct preset_table *t;
+	struct dstr out = {0};
+	size_t queued = 0;
+	bool rewrite;
+	long e;
+
+	pthread_mutex_lock(&write_mutex);
+	pthread_mutex_lock(&queue_mutex);
+
+	rewrite = rewrite_pending ||
+		journal_records + save_queue.num > JOURNAL_MAX_RECORDS ||
+		(compact && journal_records);
+
+	t = table_read_begin(&e);
+
+	if (rewrite) {
+		for (size_t i = 0; t && i < t->presets.num; i++)
+			preset_serialize(&out, t, table_preset(t, i));
+	} else {
+		for (size_t i = 0; i < save_queue.num; i++) {
+			const struct preset *preset =
+				table_lookup(t, save_queue.array[i]);
+
+			/* a reload may have dropped it in the meantime */
+			if (preset) {
+				preset_serialize(&out, t, preset);
+				queued++;
+			}
+		}
+	}
+
+	table_read_end(e);
+
+	for (size_t i = 0; i < save_queue.num; i++)
+		bfree(save_queue.array[i]);
+	da_clear(save_queue);
+	rewrite_pending = false;
+
+	pthread_mutex_unlock(&queue_mutex);
+
+	if (rewrite) {
+		/* the temporary file is renamed over the old one, so a crash
+		 * leaves either of them whole */
+		if (os_quick_write_utf8_file_safe(presets_path,
+			out.array ? out.array : "", out.len, false,
+			"tmp", "bak")) {
+			known_stamp_update();
+			os_unlink(journal_path);
+			pthread_mutex_lock(&queue_mutex);
+			journal_records = 0;
+			pthread_mutex_unlock(&queue_mutex);
+		} else {
+			GDQ_LOG(LOG_WARNING, "failed to write %s",
+				presets_path);
+			pthread_mutex_lock(&queue_mutex);
+			rewrite_pending = true;
+			pthread_mutex_unlock(&queue_mutex);
+		}
+	} else if (queued) {
+		bool appended = journal_append(&out);
+
+		if (!appended)
+			GDQ_LOG(LOG_WARNING, "failed to append to %s",
+				journal_path);
+
+		pthread_mutex_lock(&queue_mutex);
+		if (appended)
+			journal_records += queued;
+		else
+			rewrite_pending = true;
+		pthread_mutex_unlock(&queue_mutex);
+	}
+
+	pthread_mutex_unlock(&write_mutex);
+	dstr_free(&out);
+
+	/* nothing else may publish for a while, and this reader may have
+	 * held up what the last change replaced */
+	pthread_mutex_lock(&update_mutex);
+	presets_reclaim();
+	pthread_mutex_unlock(&update_mutex);
+}
+
+
+static void *presets_writer(void *unused)
+{
+	os_set_thread_name("gdq-presets");
+
+	while (os_event_wait(writer_event) == 0) {
+		bool stop = os_atomic_load_bool(&writer_stop);
+
+		/* let a burst of saves pile up into one write */
+		if (!stop)
+			os_sleep_ms(WRITER_COALESCE_MS);
+
+		presets_flush(stop);
+		if (stop)
+			break;
+	}
+
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+
+/* Reloads the presets if the file is not the one last loaded or written
+ * here. */
+static void presets_check_file(void)
+{
+	struct file_stamp stamp;
+	bool changed;
+
+	file_stamp_get(presets_path, &stamp);
+
+	pthread_mutex_lock(&stamp_mutex);
+	changed = memcmp(&stamp, &known_stamp, sizeof(stamp)) != 0;
+	pthread_mutex_unlock(&stamp_mutex);
+
+	/* a file that went away is most likely about to be replaced */
+	if (!changed || !stamp.ino)
+		return;
+
+	GDQ_LOG(LOG_INFO, "%s changed, reloading presets", presets_path);
+	presets_reload();
+}
+
+
+#ifdef __linux__
+/* Waits until the config directory reports a change to the preset file;
+ * false once the watcher is to stop. */
+static bool watch_wait(int fd)
+{
+	struct pollfd pfd = {.fd = fd, .events = POLLIN};
+	char buf[4096];
+
+	while (!os_atomic_load_bool(&watcher_stop)) {
+		bool relevant = false;
+		ssize_t len;
+
+		if (poll(&pfd, 1, WATCH_INTERVAL_MS) <= 0)
+			continue;
+
+		len = read(fd, buf, sizeof(buf));
+		for (char *p = buf; len > 0 && p < buf + len;) {
+			const struct inotify_event *ev = (const void *)p;
+
+			if (ev->len && strcmp(ev->name, PRESETS_FILE) == 0)
+				relevant = true;
+			p += sizeof(*ev) + ev->len;
+		}
+
+		if (relevant)
+			return true;
+	}
+
+	return false;
+}
+
+
+static int watch_open(void)
+{
+	char *dir = obs_module_config_path("");
+	int fd = inotify_init1(IN_CLOEXEC);
+
+	if (fd >= 0 && (!dir || inotify_add_watch(fd, dir,
+		IN_CLOSE_WRITE | IN_MOVED_TO) < 0)) {
+		close(fd);
+		fd = -1;
+	}
+
+	bfree(dir);
+	return fd;
+}
+#endif
+
+
+static void *presets_watcher(void *unused)
+{
+#ifdef __linux__
+	int fd = watch_open();
+#endif
+
+	os_set_thread_name("gdq-presets-watch");
+
+	while (!os_atomic_load_bool(&watcher_stop)) {
+#ifdef __linux__
+		if (fd >= 0) {
+			if (!watch_wait(fd))
+				break;
+
+			/* editors tend to write a file in more than one go */
+			os_sleep_ms(WATCH_SETTLE_MS);
+			presets_check_file();
+			continue;
+		}
+#endif
+		/* without change notifications the file is polled */
+		os_sleep_ms(WATCH_INTERVAL_MS);
+		presets_check_file();
+	}
+
+#ifdef __linux__
+	if (fd >= 0)
+		close(fd);
+#endif
+
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+
+/* Loads the presets from the config directory, or from the working
+ * directory where older versions kept them if the config directory has
+ * neither the file nor a journal, and starts the writer and the watcher. */
+void gdq_presets_init(void)
+{
+	char *dir = obs_module_config_path("");
+
+	/* left set by an earlier gdq_presets_free */
+	os_atomic_set_bool(&writer_stop, false);
+	os_atomic_set_bool(&watcher_stop, false);
+
+	presets_path = obs_module_config_path(PRESETS_FILE);
+	journal_path = obs_module_config_path(PRESETS_JOURNAL);
+
+	if (dir)
+		os_mkdirs(dir);
+	bfree(dir);
+
+	/* saves made before the file was first written are only in the
+	 * journal */
+	if ((presets_path && os_file_exists(presets_path)) ||
+		(journal_path && os_file_exists(journal_path))) {
+		presets_reload();
+	} else if (os_file_exists(PRESETS_FILE)) {
+		struct preset_edit edit;
+
+		edit_begin(&edit, NULL);
+		presets_load(&edit, PRESETS_FILE, false);
+
+		pthread_mutex_lock(&update_mutex);
+		table_retire_all(&edit, table_current());
+		table_publish(&edit);
+		pthread_mutex_unlock(&update_mutex);
+
+		rewrite_pending = true;
+	}
+
+	if (!presets_path || !journal_path ||
+		os_event_init(&writer_event, OS_EVENT_TYPE_AUTO) != 0) {
+		GDQ_LOG(LOG_WARNING, "presets will not be saved");
+		return;
+	}
+
+	writer_started = pthread_create(&writer_thread, NULL,
+		presets_writer, NULL) == 0;
+	if (!writer_started) {
+		os_event_destroy(writer_event);
+		GDQ_LOG(LOG_WARNING, "presets will not be saved");
+		return;
+	}
+
+	if (rewrite_pending)
+		os_event_signal(writer_event);
+
+	watcher_started = pthread_create(&watcher_thread, NULL,
+		presets_watcher, NULL) == 0;
+	if (!watcher_started)
+		GDQ_LOG(LOG_WARNING, "presets will not be reloaded on change");
+}
+
+
+void gdq_presets_free(void)
+{
+	if (watcher_started) {
+		os_atomic_set_bool(&watcher_stop, true);
+		pthread_join(watcher_thread, NULL);
+		watcher_started = false;
+	}
+
+	/* the writer folds the journal into the file on its way out */
+	if (writer_started) {
+		os_atomic_set_bool(&writer_stop, true);
+		os_event_signal(writer_event);
+		pthread_join(writer_thread, NULL);
+		os_event_destroy(writer_event);
+		writer_started = false;
+	}
+
+	bfree(presets_path);
+	bfree(journal_path);
+	presets_path = NULL;
+	journal_path = NULL;
+
+	for (size_t i = 0; i < save_queue.num; i++)
+		bfree(save_queue.array[i]);
+	da_free(save_queue);
+
+	/* nothing reads the tables any more */
+	table_destroy(current_table);
+	current_table = NULL;
+
+	for (size_t i = 0; i < 3; i++) {
+		for (size_t j = 0; j < limbo[i].num; j++)
+			bfree(limbo[i].array[j]);
+		da_free(limbo[i]);
+	}
+}
@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <obs-module.h>
+#include <util/threading.h>
+#include <util/util_uint64.h>
+#include "gdq-crop.h"
+
+#define T_RENDER_TIME                   obs_module_text("RenderTime")
+#define T_RENDER_TIME_NONE              obs_module_text("RenderTime.None")
+
+/* a frame's queries are read back this many frames later, by when the GPU
+ * is long done with them */
+#define PROFILE_QUERIES                 4
+/* render times kept for the statistics */
+#define PROFILE_SAMPLES                 256
+
+/*
+ * GPU render timing per filter instance.  gdq_profile_begin and
+ * gdq_profile_end put timestamp queries around a filter's render pass,
+ * which takes in drawing the filter's input.  Queries are reused round
+ * robin and only read when their slot comes up again, so reading never
+ * waits for the GPU; a result that still is not there is dropped.  The
+ * times of the last PROFILE_SAMPLES passes give min, average and p99.
+ */
+
+struct profile_query {
+	gs_timer_range_t               *range;
+	gs_timer_t                     *timer;
+	bool                           pending;
+};
+
+struct gdq_profile {
+	obs_source_t                   *source;
+	struct profile_query           queries[PROFILE_QUERIES];
+	size_t                         next;
+	bool                           unsupported;
+
+	/* render times in ns; written on the graphics thread, read by the
+	 * properties */
+	pthread_mutex_t                mutex;
+	uint32_t                       samples[PROFILE_SAMPLES];
+	size_t                         count;
+	size_t                         pos;
+};
+
+
+struct gdq_profile *gdq_profile_create(obs_source_t *source)
+{
+	struct gdq_profile *profile = bzalloc(sizeof(*profile));
+
+	if (pthread_mutex_init(&profile->mutex, NULL) != 0) {
+		bfree(profile);
+		return NULL;
+	}
+
+	profile->source = source;
+	return profile;
+}
+
+
+static void profile_add_sample(struct gdq_profile *profile, uint64_t ns)
+{
+	pthread_mutex_lock(&profile->mutex);
+
+	profile->samples[profile->pos] = ns > UINT32_MAX ?
+		UINT32_MAX : (uint32_t)ns;
+	profile->pos = (profile->pos + 1) % PROFILE_SAMPLES;
+	if (profile->count < PROFILE_SAMPLES)
+		profile->count++;
+
+	pthread_mutex_unlock(&profile->mutex);
+}
+
+
+static void profile_collect(struct gdq_profile *profile,
+	struct profile_query *query)
+{
+	uint64_t frequency;
+	uint64_t ticks;
+	bool disjoint;
+
+	query->pending = false;
+
+	/* a disjoint range had its clock change under it */
+	if (!gs_timer_range_get_data(query->range, &disjoint, &frequency) ||
+		disjoint || !frequency ||
+		!gs_timer_get_data(query->timer, &ticks))
+		return;
+
+	profile_add_sample(profile, util_mul_div64(ticks, 1000000000ULL,
+		frequency));
+}
+
+
+/* Called from video_render. */
+void gdq_profile_begin(struct gdq_profile *profile)
+{
+	struct profile_query *query;
+
+	if (!profile || profile->unsupported)
+		return;
+
+	query = &profile->queries[profile->next];
+
+	if (query->pending)
+		profile_collect(profile, query);
+
+	if (!query->range) {
+		query->range = gs_timer_range_create();
+		query->timer = gs_timer_create();
+
+		/* not every renderer has timestamp queries */
+		if (!query->range || !query->timer) {
+			profile->unsupported = true;
+			return;
+		}
+	}
+
+	gs_timer_range_begin(query->range);
+	gs_timer_begin(query->timer);
+}
+
+
+void gdq_profile_end(struct gdq_profile *profile)
+{
+	struct profile_query *query;
+
+	if (!profile || profile->unsupported)
+		return;
+
+	query = &profile->queries[profile->next];
+	gs_timer_end(query->timer);
+	gs_timer_range_end(query->range);
+
+	query->pending = true;
+	profile->next = (profile->next + 1) % PROFILE_QUERIES;
+}
+
+
+static int compare_samples(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+
+/* Statistics of the last render times; false if there are none yet. */
+bool gdq_profile_get_stats(struct gdq_profile *profile,
+	struct gdq_profile_stats *stats)
+{
+	uint32_t samples[PROFILE_SAMPLES];
+	uint64_t total = 0;
+	size_t count;
+
+	memset(stats, 0, sizeof(*stats));
+	if (!profile)
+		return false;
+
+	pthread_mutex_lock(&profile->mutex);
+	count = profile->count;
+	memcpy(samples, profile->samples, count * sizeof(*samples));
+	pthread_mutex_unlock(&profile->mutex);
+
+	if (!count)
+		return false;
+
+	qsort(samples, count, sizeof(*samples), compare_samples);
+
+	for (size_t i = 0; i < count; i++)
+		total += samples[i];
+
+	stats->count = count;
+	stats->min_ns = samples[0];
+	stats->avg_ns = total / count;
+	stats->p99_ns = samples[(count * 99 + 99) / 100 - 1];
+	return true;
+}
+
+
+static void profile_format(struct gdq_profile *profile, char *str,
+	size_t size)
+{
+	struct gdq_profile_stats stats;
+
+	if (!gdq_profile_get_stats(profile, &stats)) {
+		snprintf(str, size, "%s: %s", T_RENDER_TIME,
+			T_RENDER_TIME_NONE);
+		return;
+	}
+
+	snprintf(str, size, "%s: min %.3f ms, avg %.3f ms, p99 %.3f ms "
+		"(%zu frames)", T_RENDER_TIME,
+		(double)stats.min_ns / 1000000.0,
+		(double)stats.avg_ns / 1000000.0,
+		(double)stats.p99_ns / 1000000.0, stats.count);
+}
+
+
+/* Shows the render times as of when the properties are opened. */
+void gdq_profile_add_property(obs_properties_t *props,
+	struct gdq_profile *profile)
+{
+	char str[160];
+
+	if (!profile || profile->unsupported)
+		return;
+
+	profile_format(profile, str, sizeof(str));
+	obs_properties_add_text(props, "render_time", str, OBS_TEXT_INFO);
+}
+
+
+/* Logs the render times; called when the filter goes away. */
+void gdq_profile_destroy(struct gdq_profile *profile)
+{
+	char str[160];
+
+	if (!profile)
+		return;
+
+	if (profile->count) {
+		profile_format(profile, str, sizeof(str));
+		GDQ_LOG(LOG_INFO, "'%s': %s",
+			obs_source_get_name(profile->source), str);
+	}
+
+	obs_enter_graphics();
+	for (size_t i = 0; i < PROFILE_QUERIES; i++) {
+		if (profile->queries[i].timer)
+			gs_timer_destroy(profile->queries[i].timer);
+		if (profile->queries[i].range)
+			gs_timer_range_destroy(profile->queries[i].range);
+	}
+	obs_leave_graphics();
+
+	pthread_mutex_destroy(&profile->mutex);
+	bfree(profile);
+}
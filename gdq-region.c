@@ -0,0 +1,549 @@
+#include <obs-module.h>
+#include <graphics/vec2.h>
+#include <util/threading.h>
+#include "gdq-crop.h"
+
+/*
+ * Crop region source.  A race layout used to add the same quad-split capture
+ * N times, each copy with its own crop filter rendering the whole capture
+ * into its own full-size texture.  A region source instead names the
+ * capture, a cell of the split and a crop inside that cell; all region
+ * sources of one capture share a single render of it per frame and only
+ * draw their own sub-rect out of it.
+ */
+
+#define S_SOURCE                        "source"
+#define S_SPLIT                         "split"
+
+#define T_SOURCE                        obs_module_text("CropRegion.Source")
+#define T_SPLIT                         obs_module_text("CropRegion.Split")
+#define T_SPLIT_FULL                    obs_module_text("CropRegion.Split.Full")
+#define T_SPLIT_LEFT                    obs_module_text("CropRegion.Split.Left")
+#define T_SPLIT_RIGHT                   obs_module_text("CropRegion.Split.Right")
+#define T_SPLIT_TOP_LEFT                obs_module_text("CropRegion.Split.TopLeft")
+#define T_SPLIT_TOP_RIGHT               obs_module_text("CropRegion.Split.TopRight")
+#define T_SPLIT_BOTTOM_LEFT             obs_module_text("CropRegion.Split.BottomLeft")
+#define T_SPLIT_BOTTOM_RIGHT            obs_module_text("CropRegion.Split.BottomRight")
+
+enum region_split {
+	REGION_SPLIT_FULL,
+	REGION_SPLIT_LEFT,
+	REGION_SPLIT_RIGHT,
+	REGION_SPLIT_TOP_LEFT,
+	REGION_SPLIT_TOP_RIGHT,
+	REGION_SPLIT_BOTTOM_LEFT,
+	REGION_SPLIT_BOTTOM_RIGHT,
+	REGION_SPLIT_COUNT
+};
+
+static const struct {
+	uint32_t col;
+	uint32_t row;
+	uint32_t cols;
+	uint32_t rows;
+} region_cells[REGION_SPLIT_COUNT] = {
+	[REGION_SPLIT_FULL]         = {0, 0, 1, 1},
+	[REGION_SPLIT_LEFT]         = {0, 0, 2, 1},
+	[REGION_SPLIT_RIGHT]        = {1, 0, 2, 1},
+	[REGION_SPLIT_TOP_LEFT]     = {0, 0, 2, 2},
+	[REGION_SPLIT_TOP_RIGHT]    = {1, 0, 2, 2},
+	[REGION_SPLIT_BOTTOM_LEFT]  = {0, 1, 2, 2},
+	[REGION_SPLIT_BOTTOM_RIGHT] = {1, 1, 2, 2},
+};
+
+/* One per captured source, shared by every region source that uses it.  The
+ * texture is only touched from video_render, so the graphics thread is the
+ * only one reading or writing it. */
+struct region_capture {
+	obs_weak_source_t               *source;
+	gs_texrender_t                  *texrender;
+	uint64_t                        frame_time;
+	bool                            rendered;
+	long                            refs;
+	struct region_capture           *next;
+};
+
+static struct region_capture *captures;
+static pthread_mutex_t captures_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+struct region_source_data {
+	obs_source_t                    *context;
+	const struct gdq_effect         *effect;
+	struct region_capture           *capture;
+	struct gdq_counters             *counters;
+	char                            *source_name;
+	float                           retry_time;
+
+	enum region_split               split;
+	int                             left;
+	int                             right;
+	int                             top;
+	int                             bottom;
+
+	uint32_t                        target_width;
+	uint32_t                        target_height;
+	uint32_t                        cell_width;
+	uint32_t                        cell_height;
+	uint32_t                        width;
+	uint32_t                        height;
+	struct vec2                     mul_val;
+	struct vec2                     add_val;
+
+	bool                            showing;
+	volatile bool                   dirty;
+};
+
+
+static struct region_capture *region_capture_get(obs_source_t *source)
+{
+	struct region_capture *capture;
+
+	pthread_mutex_lock(&captures_mutex);
+
+	for (capture = captures; capture; capture = capture->next) {
+		if (obs_weak_source_references_source(capture->source, source))
+			break;
+	}
+
+	if (!capture) {
+		capture = bzalloc(sizeof(*capture));
+		capture->source = obs_source_get_weak_source(source);
+		capture->next = captures;
+		captures = capture;
+	}
+
+	capture->refs++;
+
+	pthread_mutex_unlock(&captures_mutex);
+	return capture;
+}
+
+
+static void region_capture_release(struct region_capture *capture)
+{
+	struct region_capture **prev;
+	bool last;
+
+	if (!capture)
+		return;
+
+	pthread_mutex_lock(&captures_mutex);
+
+	last = --capture->refs == 0;
+	if (last) {
+		for (prev = &captures; *prev != capture; prev = &(*prev)->next)
+			;
+		*prev = capture->next;
+	}
+
+	pthread_mutex_unlock(&captures_mutex);
+
+	if (!last)
+		return;
+
+	obs_enter_graphics();
+	gs_texrender_destroy(capture->texrender);
+	obs_leave_graphics();
+
+	obs_weak_source_release(capture->source);
+	bfree(capture);
+}
+
+
+static obs_source_t *region_capture_get_source(struct region_capture *capture)
+{
+	return capture ? obs_weak_source_get_source(capture->source) : NULL;
+}
+
+
+/* Renders the captured source at its base size, at most once per frame;
+ * every region source drawn after the first in the same frame gets the same
+ * texture back. */
+static gs_texture_t *region_capture_render(struct region_capture *capture)
+{
+	uint64_t frame_time = obs_get_video_frame_time();
+	obs_source_t *source;
+	uint32_t cx;
+	uint32_t cy;
+
+	if (capture->rendered && capture->frame_time == frame_time)
+		return gs_texrender_get_texture(capture->texrender);
+
+	source = region_capture_get_source(capture);
+	if (!source)
+		return NULL;
+
+	cx = obs_source_get_base_width(source);
+	cy = obs_source_get_base_height(source);
+
+	if (!capture->texrender)
+		capture->texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+
+	gs_texrender_reset(capture->texrender);
+
+	capture->rendered = cx && cy && gdq_render_region(capture->texrender,
+			source, 0.0f, 0.0f, (float)cx, (float)cy, cx, cy);
+	capture->frame_time = frame_time;
+
+	obs_source_release(source);
+
+	return capture->rendered ?
+		gs_texrender_get_texture(capture->texrender) : NULL;
+}
+
+
+static const char *region_source_get_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("GDQCropRegion");
+}
+
+
+static void region_source_set_capture(struct region_source_data *region,
+	obs_source_t *source)
+{
+	struct region_capture *capture = NULL;
+	struct region_capture *old;
+	obs_source_t *old_source;
+
+	if (source && source != region->context)
+		capture = region_capture_get(source);
+
+	/* the capture is only used from video_render, so swapping it under
+	 * the graphics lock is enough */
+	obs_enter_graphics();
+	old = region->capture;
+	region->capture = capture;
+	obs_leave_graphics();
+
+	if (region->showing) {
+		old_source = region_capture_get_source(old);
+		if (old_source) {
+			obs_source_dec_showing(old_source);
+			obs_source_release(old_source);
+		}
+		if (capture)
+			obs_source_inc_showing(source);
+	}
+
+	region_capture_release(old);
+}
+
+
+static void region_source_update(void *data, obs_data_t *settings)
+{
+	struct region_source_data *region = data;
+	const char *name = obs_data_get_string(settings, S_SOURCE);
+	obs_source_t *source = *name ? obs_get_source_by_name(name) : NULL;
+
+	region->split = (enum region_split)obs_data_get_int(settings, S_SPLIT);
+	if (region->split >= REGION_SPLIT_COUNT)
+		region->split = REGION_SPLIT_FULL;
+
+	region->left = (int)obs_data_get_int(settings, "left");
+	region->top = (int)obs_data_get_int(settings, "top");
+	region->right = (int)obs_data_get_int(settings, "right");
+	region->bottom = (int)obs_data_get_int(settings, "bottom");
+	os_atomic_set_bool(&region->dirty, true);
+
+	if ((region->left == 0) &&
+		(region->top == 0) &&
+		(region->right == 0) &&
+		(region->bottom == 0)) {
+		obs_data_set_string(settings, "console", "None");
+	}
+	else {
+		obs_data_set_string(settings, "console", "Custom");
+	}
+
+	bfree(region->source_name);
+	region->source_name = bstrdup(name);
+	region->retry_time = 0.0f;
+
+	region_source_set_capture(region, source);
+	obs_source_release(source);
+}
+
+
+static void *region_source_create(obs_data_t *settings, obs_source_t *context)
+{
+	struct region_source_data *region = bzalloc(sizeof(*region));
+
+	region->context = context;
+	region->effect = gdq_effect_ref(GDQ_EFFECT_CROP);
+
+	if (!region->effect) {
+		bfree(region);
+		return NULL;
+	}
+
+	/* draws straight out of the shared capture, so it has no output
+	 * texture of its own to count */
+	region->counters = gdq_counters_create(context,
+		"gdq_crop_region_source");
+	region_source_update(region, settings);
+	return region;
+}
+
+
+static void region_source_destroy(void *data)
+{
+	struct region_source_data *region = data;
+
+	region_capture_release(region->capture);
+	gdq_effect_unref(GDQ_EFFECT_CROP);
+	gdq_counters_destroy(region->counters);
+
+	bfree(region->source_name);
+	bfree(region);
+}
+
+
+static void region_source_show(void *data)
+{
+	struct region_source_data *region = data;
+	obs_source_t *source = region_capture_get_source(region->capture);
+
+	region->showing = true;
+
+	if (source) {
+		obs_source_inc_showing(source);
+		obs_source_release(source);
+	}
+}
+
+
+static void region_source_hide(void *data)
+{
+	struct region_source_data *region = data;
+	obs_source_t *source = region_capture_get_source(region->capture);
+
+	region->showing = false;
+
+	if (source) {
+		obs_source_dec_showing(source);
+		obs_source_release(source);
+	}
+}
+
+
+static void region_source_enum_active_sources(void *data,
+	obs_source_enum_proc_t enum_callback, void *param)
+{
+	struct region_source_data *region = data;
+	obs_source_t *source = region_capture_get_source(region->capture);
+
+	if (source) {
+		enum_callback(region->context, source, param);
+		obs_source_release(source);
+	}
+}
+
+
+static void region_source_calc(struct region_source_data *region,
+	uint32_t cx, uint32_t cy)
+{
+	uint32_t col = region_cells[region->split].col;
+	uint32_t row = region_cells[region->split].row;
+	uint32_t cols = region_cells[region->split].cols;
+	uint32_t rows = region_cells[region->split].rows;
+	uint32_t x = cx * col / cols;
+	uint32_t y = cy * row / rows;
+
+	region->cell_width = cx * (col + 1) / cols - x;
+	region->cell_height = cy * (row + 1) / rows - y;
+
+	/* crop inside the cell, then map the result into the whole capture */
+	gdq_calc_crop(region->cell_width, region->cell_height,
+		region->left, region->right, region->top, region->bottom,
+		&region->width, &region->height,
+		&region->mul_val, &region->add_val);
+
+	if (!region->width || !region->height)
+		return;
+
+	vec2_set(&region->mul_val,
+		(float)region->width / (float)cx,
+		(float)region->height / (float)cy);
+	vec2_set(&region->add_val,
+		(float)(x + region->left) / (float)cx,
+		(float)(y + region->top) / (float)cy);
+}
+
+
+/* The captured source may be created after this one when a scene collection
+ * loads, or renamed later on; look it up again once a second until found. */
+static void region_source_find_capture(struct region_source_data *region,
+	float seconds)
+{
+	obs_source_t *source;
+
+	region->retry_time -= seconds;
+	if (region->retry_time > 0.0f)
+		return;
+
+	region->retry_time = 1.0f;
+
+	source = obs_get_source_by_name(region->source_name);
+	if (source) {
+		region_source_set_capture(region, source);
+		obs_source_release(source);
+	}
+}
+
+
+static void region_source_tick(void *data, float seconds)
+{
+	struct region_source_data *region = data;
+	obs_source_t *source;
+	uint32_t width = 0;
+	uint32_t height = 0;
+
+	if (!region->capture && region->source_name && *region->source_name)
+		region_source_find_capture(region, seconds);
+
+	source = region_capture_get_source(region->capture);
+
+	if (source) {
+		width = obs_source_get_base_width(source);
+		height = obs_source_get_base_height(source);
+		obs_source_release(source);
+	}
+
+	if (!width || !height)
+		gdq_counters_invalid_tick(region->counters);
+
+	if (!os_atomic_set_bool(&region->dirty, false) &&
+		width == region->target_width &&
+		height == region->target_height)
+		return;
+
+	region->target_width = width;
+	region->target_height = height;
+
+	region->width = 0;
+	region->height = 0;
+	if (width && height)
+		region_source_calc(region, width, height);
+
+	UNUSED_PARAMETER(seconds);
+}
+
+
+static void region_source_render(void *data, gs_effect_t *effect)
+{
+	struct region_source_data *region = data;
+	const struct gdq_effect *e = region->effect;
+	gs_texture_t *tex = NULL;
+
+	if (region->capture && region->width && region->height)
+		tex = region_capture_render(region->capture);
+
+	if (!tex) {
+		gdq_counters_skipped(region->counters);
+		return;
+	}
+
+	gdq_counters_rendered(region->counters);
+
+	gs_effect_set_texture(e->image, tex);
+	gs_effect_set_vec2(e->mul_val, &region->mul_val);
+	gs_effect_set_vec2(e->add_val, &region->add_val);
+
+	while (gs_effect_loop(e->effect, "Draw"))
+		gs_draw_sprite(tex, 0, region->width, region->height);
+
+	UNUSED_PARAMETER(effect);
+}
+
+
+static bool add_source_name(void *data, obs_source_t *source)
+{
+	obs_property_t *p = data;
+	uint32_t flags = obs_source_get_output_flags(source);
+	const char *name = obs_source_get_name(source);
+
+	if ((flags & OBS_SOURCE_VIDEO) != 0 &&
+		strcmp(obs_source_get_id(source), "gdq_crop_region_source") != 0)
+		obs_property_list_add_string(p, name, name);
+
+	return true;
+}
+
+
+static obs_properties_t *region_source_properties(void *data)
+{
+	struct region_source_data *region = data;
+	obs_properties_t *props = obs_properties_create();
+	obs_property_t *p;
+	uint32_t width = 0;
+	uint32_t height = 0;
+
+	if (region) {
+		width = region->cell_width;
+		height = region->cell_height;
+	}
+
+	p = obs_properties_add_list(props, S_SOURCE, T_SOURCE,
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+	obs_enum_sources(add_source_name, p);
+
+	p = obs_properties_add_list(props, S_SPLIT, T_SPLIT,
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(p, T_SPLIT_FULL, REGION_SPLIT_FULL);
+	obs_property_list_add_int(p, T_SPLIT_LEFT, REGION_SPLIT_LEFT);
+	obs_property_list_add_int(p, T_SPLIT_RIGHT, REGION_SPLIT_RIGHT);
+	obs_property_list_add_int(p, T_SPLIT_TOP_LEFT, REGION_SPLIT_TOP_LEFT);
+	obs_property_list_add_int(p, T_SPLIT_TOP_RIGHT, REGION_SPLIT_TOP_RIGHT);
+	obs_property_list_add_int(p, T_SPLIT_BOTTOM_LEFT,
+		REGION_SPLIT_BOTTOM_LEFT);
+	obs_property_list_add_int(p, T_SPLIT_BOTTOM_RIGHT,
+		REGION_SPLIT_BOTTOM_RIGHT);
+
+	gdq_add_crop_properties(props, width, height);
+
+	return props;
+}
+
+
+static void region_source_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_string(settings, S_SOURCE, "");
+	obs_data_set_default_int(settings, S_SPLIT, REGION_SPLIT_FULL);
+	obs_data_set_default_string(settings, "console", "None");
+}
+
+
+static uint32_t region_source_width(void *data)
+{
+	struct region_source_data *region = data;
+	return region->width;
+}
+
+
+static uint32_t region_source_height(void *data)
+{
+	struct region_source_data *region = data;
+	return region->height;
+}
+
+
+struct obs_source_info gdq_crop_region_source = {
+	.id                            = "gdq_crop_region_source",
+	.type                          = OBS_SOURCE_TYPE_INPUT,
+	.output_flags                  = OBS_SOURCE_VIDEO |
+	                                 OBS_SOURCE_CUSTOM_DRAW,
+	.get_name                      = region_source_get_name,
+	.create                        = region_source_create,
+	.destroy                       = region_source_destroy,
+	.update                        = region_source_update,
+	.get_properties                = region_source_properties,
+	.get_defaults                  = region_source_defaults,
+	.show                          = region_source_show,
+	.hide                          = region_source_hide,
+	.enum_active_sources           = region_source_enum_active_sources,
+	.video_tick                    = region_source_tick,
+	.video_render                  = region_source_render,
+	.get_width                     = region_source_width,
+	.get_height                    = region_source_height
+};
@@ -0,0 +1,223 @@
+#include <obs-module.h>
+#include <graphics/vec4.h>
+#include <util/threading.h>
+#include "gdq-crop.h"
+
+#define S_RERENDER                      "rerender"
+
+#define T_RERENDER                      obs_module_text("Rerender")
+#define T_RERENDER_ALWAYS               obs_module_text("Rerender.Always")
+#define T_RERENDER_NEW_FRAME            obs_module_text("Rerender.NewFrame")
+#define T_RERENDER_INVALIDATED          obs_module_text("Rerender.Invalidated")
+
+/* a kept output is redrawn at least this often, so a source that stops
+ * sending frames is not frozen on its last one for good */
+#define RERENDER_MAX_AGE_NS             1000000000ULL
+
+/*
+ * Shared render helpers for filters that draw their target themselves
+ * instead of going through obs_source_process_filter_begin.
+ */
+
+
+bool gdq_can_render_target(obs_source_t *filter)
+{
+	obs_source_t *target = obs_filter_get_target(filter);
+	obs_source_t *parent = obs_filter_get_parent(filter);
+	uint32_t flags;
+
+	if (!target || !parent)
+		return false;
+
+	/* an earlier filter in the chain renders through its own video_render */
+	if (target != parent)
+		return true;
+
+	/* synchronous parents that are not custom-draw expect the caller to
+	 * run the effect loop, which only obs_source_process_filter_begin
+	 * sets up for them */
+	flags = obs_source_get_output_flags(parent);
+	return (flags & (OBS_SOURCE_CUSTOM_DRAW | OBS_SOURCE_ASYNC)) != 0;
+}
+
+
+/* Begins drawing into texrender with blending off and a pixel projection;
+ * on success gdq_texrender_end has to follow. */
+bool gdq_texrender_begin(gs_texrender_t *texrender, uint32_t cx, uint32_t cy)
+{
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+	if (!gs_texrender_begin(texrender, cx, cy)) {
+		gs_blend_state_pop();
+		return false;
+	}
+
+	gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+	return true;
+}
+
+
+void gdq_texrender_end(gs_texrender_t *texrender)
+{
+	gs_texrender_end(texrender);
+	gs_blend_state_pop();
+}
+
+
+bool gdq_render_region(gs_texrender_t *texrender, obs_source_t *target,
+	float left, float top, float right, float bottom,
+	uint32_t cx, uint32_t cy)
+{
+	return gdq_render_subregion(texrender, target, left, top, right, bottom,
+		cx, cy, cx, cy);
+}
+
+
+/* Same as gdq_render_region, but into the top left cx by cy corner of a
+ * texture that is tex_cx by tex_cy, so a size change does not have to
+ * reallocate the texture. */
+bool gdq_render_subregion(gs_texrender_t *texrender, obs_source_t *target,
+	float left, float top, float right, float bottom,
+	uint32_t cx, uint32_t cy, uint32_t tex_cx, uint32_t tex_cy)
+{
+	struct vec4 clear_color;
+
+	if (!gdq_texrender_begin(texrender, tex_cx, tex_cy))
+		return false;
+
+	vec4_zero(&clear_color);
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+
+	/* only the requested region of the target lands in the render
+	 * target, everything else is clipped */
+	gs_set_viewport(0, 0, (int)cx, (int)cy);
+	gs_ortho(left, right, top, bottom, -100.0f, 100.0f);
+	obs_source_video_render(target);
+
+	gdq_texrender_end(texrender);
+	return true;
+}
+
+
+void gdq_draw_texture(gs_texture_t *tex, uint32_t cx, uint32_t cy)
+{
+	gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
+
+	gs_effect_set_texture(image, tex);
+
+	while (gs_effect_loop(effect, "Draw"))
+		gs_draw_sprite(tex, 0, cx, cy);
+}
+
+
+/* Draws the top left cx by cy corner of tex at its own size. */
+void gdq_draw_texture_subregion(gs_texture_t *tex, uint32_t cx, uint32_t cy)
+{
+	gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
+
+	gs_effect_set_texture(image, tex);
+
+	while (gs_effect_loop(effect, "Draw"))
+		gs_draw_sprite_subregion(tex, 0, 0, 0, cx, cy);
+}
+
+
+/*
+ * Frame tracking for filters that keep their last output.  Async parents
+ * report every new frame through the filter's filter_video, which libobs
+ * calls right before the parent's filter chain is rendered with it; other
+ * parents only change on an explicit "invalidate" call on the filter's proc
+ * handler.  Settings and size changes invalidate as well.
+ */
+
+static void frame_state_invalidate_proc(void *data, calldata_t *cd)
+{
+	gdq_frame_state_invalidate(data);
+	UNUSED_PARAMETER(cd);
+}
+
+
+void gdq_frame_state_init(struct gdq_frame_state *state, obs_source_t *filter)
+{
+	state->filter = filter;
+	state->frames = 1;
+
+	proc_handler_add(obs_source_get_proc_handler(filter),
+		"void invalidate()", frame_state_invalidate_proc, state);
+}
+
+
+void gdq_frame_state_update(struct gdq_frame_state *state,
+	obs_data_t *settings)
+{
+	state->mode = (enum gdq_rerender)obs_data_get_int(settings, S_RERENDER);
+	gdq_frame_state_invalidate(state);
+}
+
+
+void gdq_frame_state_invalidate(struct gdq_frame_state *state)
+{
+	os_atomic_inc_long(&state->frames);
+}
+
+
+/* Whether the mode allows reusing an output at all for the current parent. */
+bool gdq_frame_state_can_reuse(const struct gdq_frame_state *state)
+{
+	obs_source_t *target = obs_filter_get_target(state->filter);
+	obs_source_t *parent = obs_filter_get_parent(state->filter);
+	uint32_t flags;
+
+	/* earlier filters in the chain may change their output every frame */
+	if (state->mode == GDQ_RERENDER_ALWAYS || !target || target != parent)
+		return false;
+
+	flags = obs_source_get_output_flags(parent);
+	if ((flags & OBS_SOURCE_ASYNC) == 0)
+		return state->mode == GDQ_RERENDER_INVALIDATED;
+
+	/* deinterlacing can produce a new picture per field */
+	return obs_source_get_deinterlace_mode(parent) ==
+		OBS_DEINTERLACE_MODE_DISABLE;
+}
+
+
+/* Whether the output has to be drawn again rather than reused. */
+bool gdq_frame_state_changed(const struct gdq_frame_state *state)
+{
+	uint64_t frame_time = obs_get_video_frame_time();
+
+	return !gdq_frame_state_can_reuse(state) ||
+		os_atomic_load_long(&state->frames) != state->rendered_frames ||
+		frame_time - state->rendered_time >= RERENDER_MAX_AGE_NS;
+}
+
+
+void gdq_frame_state_rendered(struct gdq_frame_state *state)
+{
+	state->rendered_frames = os_atomic_load_long(&state->frames);
+	state->rendered_time = obs_get_video_frame_time();
+}
+
+
+void gdq_add_rerender_property(obs_properties_t *props)
+{
+	obs_property_t *p;
+
+	p = obs_properties_add_list(props, S_RERENDER, T_RERENDER,
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(p, T_RERENDER_ALWAYS, GDQ_RERENDER_ALWAYS);
+	obs_property_list_add_int(p, T_RERENDER_NEW_FRAME,
+		GDQ_RERENDER_NEW_FRAME);
+	obs_property_list_add_int(p, T_RERENDER_INVALIDATED,
+		GDQ_RERENDER_INVALIDATED);
+}
+
+
+void gdq_rerender_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_int(settings, S_RERENDER, GDQ_RERENDER_NEW_FRAME);
+}
@@ -1,404 +1,1112 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <util/dstr.h>
-#include <obs-module.h>
-#include <util/platform.h>
-#include <graphics/vec2.h>
-#include <graphics/math-defs.h>
-
-#define S_RESOLUTION                    "resolution"
-#define S_SAMPLING                      "sampling"
-#define S_UNDISTORT                     "undistort"
-
-#define T_RESOLUTION                    obs_module_text("Resolution")
-#define T_NONE                          obs_module_text("None")
-#define T_SAMPLING                      obs_module_text("ScaleFiltering")
-#define T_SAMPLING_POINT                obs_module_text("ScaleFiltering.Point")
-#define T_SAMPLING_BILINEAR             obs_module_text("ScaleFiltering.Bilinear")
-#define T_SAMPLING_BICUBIC              obs_module_text("ScaleFiltering.Bicubic")
-#define T_SAMPLING_LANCZOS              obs_module_text("ScaleFiltering.Lanczos")
-#define T_UNDISTORT                     obs_module_text("UndistortCenter")
-
-#define S_SAMPLING_POINT                "point"
-#define S_SAMPLING_BILINEAR             "bilinear"
-#define S_SAMPLING_BICUBIC              "bicubic"
-#define S_SAMPLING_LANCZOS              "lanczos"
-
-struct scale_filter_data {
-	obs_source_t                    *context;
-	gs_effect_t                     *effect;
-	gs_eparam_t                     *image_param;
-	gs_eparam_t                     *dimension_param;
-	gs_eparam_t                     *undistort_factor_param;
-	struct vec2                     dimension_i;
-	double                          undistort_factor;
-	int                             cx_in;
-	int                             cy_in;
-	int                             cx_out;
-	int                             cy_out;
-	enum obs_scale_type             sampling;
-	gs_samplerstate_t               *point_sampler;
-	bool                            aspect_ratio_only;
-	bool                            target_valid;
-	bool                            valid;
-	bool                            undistort;
-};
-
-static const char *scale_filter_name(void *unused)
-{
-	UNUSED_PARAMETER(unused);
-	return obs_module_text("ScaleFilter");
-}
-
-static void scale_filter_update(void *data, obs_data_t *settings)
-{
-	struct scale_filter_data *filter = data;
-	int ret;
-
-	const char *res_str = obs_data_get_string(settings, S_RESOLUTION);
-	const char *sampling = obs_data_get_string(settings, S_SAMPLING);
-
-	filter->valid = true;
-
-	ret = sscanf(res_str, "%dx%d", &filter->cx_in, &filter->cy_in);
-	if (ret == 2) {
-		filter->aspect_ratio_only = false;
-	} else {
-		ret = sscanf(res_str, "%d:%d", &filter->cx_in, &filter->cy_in);
-		if (ret != 2) {
-			filter->valid = false;
-			return;
-		}
-
-		filter->aspect_ratio_only = true;
-	}
-
-	if (astrcmpi(sampling, S_SAMPLING_POINT) == 0) {
-		filter->sampling = OBS_SCALE_POINT;
-
-	} else if (astrcmpi(sampling, S_SAMPLING_BILINEAR) == 0) {
-		filter->sampling = OBS_SCALE_BILINEAR;
-
-	} else if (astrcmpi(sampling, S_SAMPLING_LANCZOS) == 0) {
-		filter->sampling = OBS_SCALE_LANCZOS;
-
-	} else { /* S_SAMPLING_BICUBIC */
-		filter->sampling = OBS_SCALE_BICUBIC;
-	}
-
-	filter->undistort = obs_data_get_bool(settings, S_UNDISTORT);
-}
-
-static void scale_filter_destroy(void *data)
-{
-	struct scale_filter_data *filter = data;
-
-	obs_enter_graphics();
-	gs_samplerstate_destroy(filter->point_sampler);
-	obs_leave_graphics();
-	bfree(data);
-}
-
-static void *scale_filter_create(obs_data_t *settings, obs_source_t *context)
-{
-	struct scale_filter_data *filter =
-		bzalloc(sizeof(struct scale_filter_data));
-	struct gs_sampler_info sampler_info = {0};
-
-	filter->context = context;
-
-	obs_enter_graphics();
-	filter->point_sampler = gs_samplerstate_create(&sampler_info);
-	obs_leave_graphics();
-
-	scale_filter_update(filter, settings);
-
-	t
-
-	return filter;
-}
-
-static void scale_filter_tick(void *data, float seconds)
-{
-	struct scale_filter_data *filter = data;
-	enum obs_base_effect type;
-	obs_source_t *target;
-	bool lower_than_2x;
-	double cx_f;
-	double cy_f;
-	int cx;
-	int cy;
-
-	target = obs_filter_get_target(filter->context);
-	filter->cx_out = 0;
-	filter->cy_out = 0;
-
-	filter->target_valid = !!target;
-	if (!filter->target_valid)
-		return;
-
-	cx = obs_source_get_base_width(target);
-	cy = obs_source_get_base_height(target);
-
-	if (!cx || !cy) {
-		filter->target_valid = false;
-		return;
-	}
-
-	filter->cx_out = cx;
-	filter->cy_out = cy;
-
-	if (!filter->valid)
-		return;
-
-	/* ------------------------- */
-
-	cx_f = (double)cx;
-	cy_f = (double)cy;
-
-	double old_aspect = cx_f / cy_f;
-	double new_aspect =
-		(double)filter->cx_in / (double)filter->cy_in;
-
-	if (filter->aspect_ratio_only) {
-		if (fabs(old_aspect - new_aspect) <= EPSILON) {
-			filter->target_valid = false;
-			return;
-		} else {
-			if (new_aspect > old_aspect) {
-				filter->cx_out = (int)(cy_f * new_aspect);
-				filter->cy_out = cy;
-			} else {
-				filter->cx_out = cx;
-				filter->cy_out = (int)(cx_f / new_aspect);
-			}
-		}
-	} else {
-		filter->cx_out = filter->cx_in;
-		filter->cy_out = filter->cy_in;
-	}
-
-	vec2_set(&filter->dimension_i,
-			1.0f / (float)cx,
-			1.0f / (float)cy);
-
-	if (filter->undistort) {
-		filter->undistort_factor = new_aspect / old_aspect;
-	} else {
-		filter->undistort_factor = 1.0;
-	}
-
-	/* ------------------------- */
-
-	lower_than_2x = filter->cx_out < cx / 2 || filter->cy_out < cy / 2;
-
-	if (lower_than_2x && filter->sampling != OBS_SCALE_POINT) {
-		type = OBS_EFFECT_BILINEAR_LOWRES;
-	} else {
-		switch (filter->sampling) {
-		default:
-		case OBS_SCALE_POINT:
-		case OBS_SCALE_BILINEAR: type = OBS_EFFECT_DEFAULT; break;
-		case OBS_SCALE_BICUBIC:  type = OBS_EFFECT_BICUBIC; break;
-		case OBS_SCALE_LANCZOS:  type = OBS_EFFECT_LANCZOS; break;
-		}
-	}
-
-	filter->effect = obs_get_base_effect(type);
-	filter->image_param = gs_effect_get_param_by_name(filter->effect,
-			"image");
-
-	if (type != OBS_EFFECT_DEFAULT) {
-		filter->dimension_param = gs_effect_get_param_by_name(
-				filter->effect, "base_dimension_i");
-	} else {
-		filter->dimension_param = NULL;
-	}
-
-	if (type == OBS_EFFECT_BICUBIC || type == OBS_EFFECT_LANCZOS) {
-		filter->undistort_factor_param = gs_effect_get_param_by_name(
-			filter->effect, "undistort_factor");
-	}
-	else {
-		filter->undistort_factor_param = NULL;
-	}
-
-	UNUSED_PARAMETER(seconds);
-}
-
-static void scale_filter_render(void *data, gs_effect_t *effect)
-{
-	struct scale_filter_data *filter = data;
-	const char *technique = filter->undistort ?
-		"DrawUndistort" : "Draw";
-
-	if (!filter->valid || !filter->target_valid) {
-		obs_source_skip_video_filter(filter->context);
-		return;
-	}
-
-	if (!obs_source_process_filter_begin(filter->context, GS_RGBA,
-				OBS_NO_DIRECT_RENDERING))
-		return;
-
-	if (filter->dimension_param)
-		gs_effect_set_vec2(filter->dimension_param,
-				&filter->dimension_i);
-
-	if (filter->undistort_factor_param)
-		gs_effect_set_float(filter->undistort_factor_param,
-			(float)filter->undistort_factor);
-
-	if (filter->sampling == OBS_SCALE_POINT)
-		gs_effect_set_next_sampler(filter->image_param,
-				filter->point_sampler);
-
-	obs_source_process_filter_tech_end(filter->context, filter->effect,
-			filter->cx_out, filter->cy_out, technique);
-
-	UNUSED_PARAMETER(effect);
-}
-
-static const double downscale_vals[] = {
-	1.0,
-	1.25,
-	(1.0/0.75),
-	1.5,
-	(1.0/0.6),
-	1.75,
-	2.0,
-	2.25,
-	2.5,
-	2.75,
-	3.0
-};
-
-#define NUM_DOWNSCALES (sizeof(downscale_vals) / sizeof(double))
-
-static const char *aspects[] = {
-	"16:9",
-	"16:10",
-	"4:3",
-	"1:1"
-};
-
-#define NUM_ASPECTS (sizeof(aspects) / sizeof(const char *))
-
-static bool sampling_modified(obs_properties_t *props, obs_property_t *p,
-	obs_data_t *settings)
-{
-	const char *sampling = obs_data_get_string(settings, S_SAMPLING);
-
-	bool has_undistort;
-	if (astrcmpi(sampling, S_SAMPLING_POINT) == 0) {
-		has_undistort = false;
-
-	}
-	else if (astrcmpi(sampling, S_SAMPLING_BILINEAR) == 0) {
-		has_undistort = false;
-
-	}
-	else if (astrcmpi(sampling, S_SAMPLING_LANCZOS) == 0) {
-		has_undistort = true;
-
-	}
-	else { /* S_SAMPLING_BICUBIC */
-		has_undistort = true;
-	}
-
-	obs_property_set_visible(obs_properties_get(props, S_UNDISTORT), has_undistort);
-
-	UNUSED_PARAMETER(p);
-	return true;
-}
-
-static obs_properties_t *scale_filter_properties(void *data)
-{
-	obs_properties_t *props = obs_properties_create();
-	struct obs_video_info ovi;
-	obs_property_t *p;
-	uint32_t cx;
-	uint32_t cy;
-
-	struct {
-		int cx;
-		int cy;
-	} downscales[NUM_DOWNSCALES];
-
-	/* ----------------- */
-
-	obs_get_video_info(&ovi);
-	cx = ovi.base_width;
-	cy = ovi.base_height;
-
-	for (size_t i = 0; i < NUM_DOWNSCALES; i++) {
-		downscales[i].cx = (int)((double)cx / downscale_vals[i]);
-		downscales[i].cy = (int)((double)cy / downscale_vals[i]);
-	}
-
-	p = obs_properties_add_list(props, S_SAMPLING, T_SAMPLING,
-			OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
-	obs_property_set_modified_callback(p, sampling_modified);
-	obs_property_list_add_string(p, T_SAMPLING_POINT,    S_SAMPLING_POINT);
-	obs_property_list_add_string(p, T_SAMPLING_BILINEAR, S_SAMPLING_BILINEAR);
-	obs_property_list_add_string(p, T_SAMPLING_BICUBIC,  S_SAMPLING_BICUBIC);
-	obs_property_list_add_string(p, T_SAMPLING_LANCZOS,  S_SAMPLING_LANCZOS);
-
-	/* ----------------- */
-
-	p = obs_properties_add_list(props, S_RESOLUTION, T_RESOLUTION,
-			OBS_COMBO_TYPE_EDITABLE, OBS_COMBO_FORMAT_STRING);
-
-	obs_property_list_add_string(p, T_NONE, T_NONE);
-
-	for (size_t i = 0; i < NUM_ASPECTS; i++)
-		obs_property_list_add_string(p, aspects[i], aspects[i]);
-
-	for (size_t i = 0; i < NUM_DOWNSCALES; i++) {
-		char str[32];
-		snprintf(str, 32, "%dx%d", downscales[i].cx, downscales[i].cy);
-		obs_property_list_add_string(p, str, str);
-	}
-
-	obs_properties_add_bool(props, S_UNDISTORT, T_UNDISTORT);
-
-	/* ----------------- */
-
-	UNUSED_PARAMETER(data);
-	return props;
-}
-
-static void scale_filter_defaults(obs_data_t *settings)
-{
-	obs_data_set_default_string(settings, S_SAMPLING, S_SAMPLING_BICUBIC);
-	obs_data_set_default_string(settings, S_RESOLUTION, T_NONE);
-	obs_data_set_default_bool(settings, S_UNDISTORT, 0);
-}
-
-static uint32_t scale_filter_width(void *data)
-{
-	struct scale_filter_data *filter = data;
-	return (uint32_t)filter->cx_out;
-}
-
-static uint32_t scale_filter_height(void *data)
-{
-	struct scale_filter_data *filter = data;
-	return (uint32_t)filter->cy_out;
-}
-
-struct obs_source_info scale_filter = {
-	.id                            = "scale_filter",
-	.type                          = OBS_SOURCE_TYPE_FILTER,
-	.output_flags                  = OBS_SOURCE_VIDEO,
-	.get_name                      = scale_filter_name,
-	.create                        = scale_filter_create,
-	.destroy                       = scale_filter_destroy,
-	.video_tick                    = scale_filter_tick,
-	.video_render                  = scale_filter_render,
-	.update                        = scale_filter_update,
-	.get_properties                = scale_filter_properties,
-	.get_defaults                  = scale_filter_defaults,
-	.get_width                     = scale_filter_width,
-	.get_height                    = scale_filter_height
-};
+#include <stdio.h>
+#include <stdlib.h>
+#include <util/dstr.h>
+#include <obs-module.h>
+#include <util/platform.h>
+#include <graphics/vec2.h>
+#include <graphics/math-defs.h>
+#include <util/profiler.h>
+#include <util/threading.h>
+#include <util/util_uint64.h>
+#include "gdq-crop.h"
+
+#define S_RESOLUTION                    "resolution"
+#define S_SAMPLING                      "sampling"
+#define S_UNDISTORT                     "undistort"
+#define S_PRESCALE                      "cpu_prescale"
+#define S_PRESCALE_BENCHMARK            "cpu_prescale_benchmark"
+#define S_PRESCALE_RESULT               "cpu_prescale_result"
+
+#define T_RESOLUTION                    obs_module_text("Resolution")
+#define T_NONE                          obs_module_text("None")
+#define T_SAMPLING                      obs_module_text("ScaleFiltering")
+#define T_SAMPLING_POINT                obs_module_text("ScaleFiltering.Point")
+#define T_SAMPLING_BILINEAR             obs_module_text("ScaleFiltering.Bilinear")
+#define T_SAMPLING_BICUBIC              obs_module_text("ScaleFiltering.Bicubic")
+#define T_SAMPLING_LANCZOS              obs_module_text("ScaleFiltering.Lanczos")
+#define T_SAMPLING_AREA                 obs_module_text("ScaleFiltering.Area")
+#define T_SAMPLING_SHARP_BILINEAR       obs_module_text("ScaleFiltering.SharpBilinear")
+#define T_UNDISTORT                     obs_module_text("UndistortCenter")
+#define T_PRESCALE                      obs_module_text("PreScale")
+#define T_PRESCALE_BENCHMARK            obs_module_text("PreScale.Benchmark")
+#define T_PRESCALE_RESULT               obs_module_text("PreScale.Result")
+#define T_PRESCALE_RUNNING              obs_module_text("PreScale.Running")
+
+#define S_SAMPLING_POINT                "point"
+#define S_SAMPLING_BILINEAR             "bilinear"
+#define S_SAMPLING_BICUBIC              "bicubic"
+#define S_SAMPLING_LANCZOS              "lanczos"
+#define S_SAMPLING_AREA                 "area"
+#define S_SAMPLING_SHARP_BILINEAR       "sharp_bilinear"
+
+/* frame size the benchmark assumes before the source has sent one */
+#define BENCHMARK_WIDTH                 3840
+#define BENCHMARK_HEIGHT                2160
+#define BENCHMARK_RUNS                  20
+/* how long the benchmark waits for a GPU timer query to come back */
+#define BENCHMARK_QUERY_TRIES           100
+#define BENCHMARK_QUERY_WAIT_MS         10
+
+/* the profiler tells scopes apart by the name's address */
+static const char *scale_tick_name = "gdq_scale_filter_tick";
+static const char *scale_render_name = "gdq_scale_filter_render";
+
+/* what the benchmark runs with, taken when the button is clicked */
+struct prescale_benchmark {
+	enum video_format               format;
+	uint32_t                        width;
+	uint32_t                        height;
+	uint32_t                        cx;
+	uint32_t                        cy;
+	enum obs_scale_type             sampling;
+};
+
+struct scale_filter_data {
+	obs_source_t                    *context;
+	gs_effect_t                     *effect;
+	gs_eparam_t                     *image_param;
+	gs_eparam_t                     *dimension_param;
+	gs_eparam_t                     *undistort_factor_param;
+	const struct gdq_effect         *shared;
+	const char                      *shared_technique;
+	struct vec2                     dimension_i;
+	struct vec2                     footprint;
+	struct vec2                     prescale;
+	double                          undistort_factor;
+	int                             cx_in;
+	int                             cy_in;
+	int                             cx_out;
+	int                             cy_out;
+	int                             cx_target;
+	int                             cy_target;
+	enum obs_scale_type             sampling;
+	gs_samplerstate_t               *point_sampler;
+	struct gdq_cache_entry          *output;
+	struct gdq_frame_state          frames;
+	struct gdq_profile              *profile;
+	struct gdq_counters             *counters;
+	bool                            aspect_ratio_only;
+	bool                            target_valid;
+	bool                            valid;
+	bool                            undistort;
+	bool                            sharp;
+	volatile bool                   dirty;
+
+	/* async frames far larger than the output are box-filtered down on
+	 * the CPU before upload, see gdq-prescale.c */
+	bool                            cpu_prescale;
+	bool                            prescale_active;
+	struct obs_source_frame         *prescaled;
+
+	/* the benchmark runs on a thread of its own; the last frame size is
+	 * written by filter_video, the rest by the benchmark */
+	pthread_mutex_t                 benchmark_mutex;
+	enum video_format               last_format;
+	uint32_t                        last_width;
+	uint32_t                        last_height;
+	struct prescale_benchmark       benchmark;
+	pthread_t                       benchmark_thread;
+	bool                            benchmark_started;
+	bool                            benchmark_running;
+	bool                            benchmark_stop;
+	char                            benchmark_result[256];
+};
+
+static const char *scale_filter_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("GDQScaleFilter");
+}
+
+bool scale_parse_resolution(const char *res_str, int *cx, int *cy,
+	bool *aspect_ratio_only)
+{
+	int ret;
+
+	ret = sscanf(res_str, "%dx%d", cx, cy);
+	if (ret == 2) {
+		*aspect_ratio_only = false;
+		return true;
+	}
+
+	ret = sscanf(res_str, "%d:%d", cx, cy);
+	if (ret != 2)
+		return false;
+
+	*aspect_ratio_only = true;
+	return true;
+}
+
+enum obs_scale_type scale_parse_sampling(const char *sampling)
+{
+	if (astrcmpi(sampling, S_SAMPLING_POINT) == 0)
+		return OBS_SCALE_POINT;
+	else if (astrcmpi(sampling, S_SAMPLING_BILINEAR) == 0)
+		return OBS_SCALE_BILINEAR;
+	else if (astrcmpi(sampling, S_SAMPLING_LANCZOS) == 0)
+		return OBS_SCALE_LANCZOS;
+	else if (astrcmpi(sampling, S_SAMPLING_AREA) == 0)
+		return OBS_SCALE_AREA;
+
+	/* S_SAMPLING_BICUBIC */
+	return OBS_SCALE_BICUBIC;
+}
+
+static void scale_filter_update(void *data, obs_data_t *settings)
+{
+	struct scale_filter_data *filter = data;
+
+	const char *res_str = obs_data_get_string(settings, S_RESOLUTION);
+	const char *sampling = obs_data_get_string(settings, S_SAMPLING);
+
+	os_atomic_set_bool(&filter->dirty, true);
+
+	filter->valid = scale_parse_resolution(res_str,
+			&filter->cx_in, &filter->cy_in,
+			&filter->aspect_ratio_only);
+	if (!filter->valid)
+		return;
+
+	filter->sharp = astrcmpi(sampling, S_SAMPLING_SHARP_BILINEAR) == 0;
+	filter->sampling = filter->sharp ?
+		OBS_SCALE_BILINEAR : scale_parse_sampling(sampling);
+	filter->undistort = obs_data_get_bool(settings, S_UNDISTORT);
+	filter->cpu_prescale = obs_data_get_bool(settings, S_PRESCALE);
+	gdq_frame_state_update(&filter->frames, settings);
+}
+
+static void scale_filter_destroy(void *data)
+{
+	struct scale_filter_data *filter = data;
+
+	pthread_mutex_lock(&filter->benchmark_mutex);
+	filter->benchmark_stop = true;
+	pthread_mutex_unlock(&filter->benchmark_mutex);
+	if (filter->benchmark_started)
+		pthread_join(filter->benchmark_thread, NULL);
+	pthread_mutex_destroy(&filter->benchmark_mutex);
+
+	obs_enter_graphics();
+	gs_samplerstate_destroy(filter->point_sampler);
+	obs_leave_graphics();
+
+	gdq_cache_release(filter->output);
+	gdq_profile_destroy(filter->profile);
+	gdq_counters_destroy(filter->counters);
+	obs_source_frame_destroy(filter->prescaled);
+
+	if (filter->shared)
+		gdq_effect_unref(GDQ_EFFECT_CROP_SCALE);
+
+	bfree(data);
+}
+
+static void *scale_filter_create(obs_data_t *settings, obs_source_t *context)
+{
+	struct scale_filter_data *filter =
+		bzalloc(sizeof(struct scale_filter_data));
+	struct gs_sampler_info sampler_info = {0};
+
+	filter->context = context;
+	pthread_mutex_init(&filter->benchmark_mutex, NULL);
+
+	obs_enter_graphics();
+	filter->point_sampler = gs_samplerstate_create(&sampler_info);
+	obs_leave_graphics();
+
+	/* area and sharp bilinear sampling are not libobs base effects;
+	 * without this effect the filter falls back to the base ones */
+	filter->shared = gdq_effect_ref(GDQ_EFFECT_CROP_SCALE);
+	gdq_frame_state_init(&filter->frames, context);
+	filter->profile = gdq_profile_create(context);
+	filter->counters = gdq_counters_create(context, "gdq_scale_filter");
+
+	scale_filter_update(filter, settings);
+
+	return filter;
+}
+
+bool scale_calc_output_size(int cx, int cy, int cx_in, int cy_in,
+	bool aspect_ratio_only, int *cx_out, int *cy_out)
+{
+	double cx_f = (double)cx;
+	double cy_f = (double)cy;
+
+	double old_aspect = cx_f / cy_f;
+	double new_aspect = (double)cx_in / (double)cy_in;
+
+	if (aspect_ratio_only) {
+		if (fabs(old_aspect - new_aspect) <= EPSILON)
+			return false;
+
+		if (new_aspect > old_aspect) {
+			*cx_out = (int)(cy_f * new_aspect);
+			*cy_out = cy;
+		} else {
+			*cx_out = cx;
+			*cy_out = (int)(cx_f / new_aspect);
+		}
+	} else {
+		*cx_out = cx_in;
+		*cy_out = cy_in;
+	}
+
+	return true;
+}
+
+/* Base effect for a sampling; lower_than_2x if the output is less than half
+ * the input on either axis. */
+static enum obs_base_effect scale_base_effect(enum obs_scale_type sampling,
+	bool lower_than_2x)
+{
+	if (lower_than_2x && sampling != OBS_SCALE_POINT)
+		return OBS_EFFECT_BILINEAR_LOWRES;
+
+	switch (sampling) {
+	default:
+	case OBS_SCALE_POINT:
+	case OBS_SCALE_BILINEAR: return OBS_EFFECT_DEFAULT;
+	case OBS_SCALE_BICUBIC:  return OBS_EFFECT_BICUBIC;
+	case OBS_SCALE_LANCZOS:  return OBS_EFFECT_LANCZOS;
+	}
+}
+
+/* Recomputes the output size and picks the effect; only called when the
+ * settings or the target size changed. */
+static void scale_filter_calc(struct scale_filter_data *filter, int cx, int cy)
+{
+	enum obs_base_effect type;
+	bool lower_than_2x;
+	double cx_f;
+	double cy_f;
+
+	filter->cx_out = 0;
+	filter->cy_out = 0;
+
+	filter->target_valid = cx && cy;
+	if (!filter->target_valid)
+		return;
+
+	filter->cx_out = cx;
+	filter->cy_out = cy;
+
+	if (!filter->valid)
+		return;
+
+	/* ------------------------- */
+
+	cx_f = (double)cx;
+	cy_f = (double)cy;
+
+	double old_aspect = cx_f / cy_f;
+	double new_aspect =
+		(double)filter->cx_in / (double)filter->cy_in;
+
+	if (!scale_calc_output_size(cx, cy, filter->cx_in, filter->cy_in,
+				filter->aspect_ratio_only,
+				&filter->cx_out, &filter->cy_out)) {
+		filter->target_valid = false;
+		return;
+	}
+
+	vec2_set(&filter->dimension_i,
+			1.0f / (float)cx,
+			1.0f / (float)cy);
+
+	if (filter->undistort) {
+		filter->undistort_factor = new_aspect / old_aspect;
+	} else {
+		filter->undistort_factor = 1.0;
+	}
+
+	/* ------------------------- */
+
+	lower_than_2x = filter->cx_out < cx / 2 || filter->cy_out < cy / 2;
+
+	filter->shared_technique = NULL;
+	if (filter->shared && filter->sampling == OBS_SCALE_AREA) {
+		vec2_set(&filter->footprint,
+				(float)cx / (float)filter->cx_out,
+				(float)cy / (float)filter->cy_out);
+		filter->shared_technique = "DrawArea";
+	} else if (filter->shared && filter->sharp && !lower_than_2x) {
+		vec2_set(&filter->prescale,
+				fmaxf(floorf((float)filter->cx_out / (float)cx), 1.0f),
+				fmaxf(floorf((float)filter->cy_out / (float)cy), 1.0f));
+		filter->shared_technique = "DrawSharpBilinear";
+	}
+
+	if (filter->shared_technique) {
+		filter->effect = filter->shared->effect;
+		filter->image_param = filter->shared->image;
+		filter->dimension_param = filter->shared->base_dimension_i;
+		filter->undistort_factor_param = NULL;
+		return;
+	}
+
+	type = scale_base_effect(filter->sampling, lower_than_2x);
+
+	filter->effect = obs_get_base_effect(type);
+	filter->image_param = gs_effect_get_param_by_name(filter->effect,
+			"image");
+
+	if (type != OBS_EFFECT_DEFAULT) {
+		filter->dimension_param = gs_effect_get_param_by_name(
+				filter->effect, "base_dimension_i");
+	} else {
+		filter->dimension_param = NULL;
+	}
+
+	if (type == OBS_EFFECT_BICUBIC || type == OBS_EFFECT_LANCZOS) {
+		filter->undistort_factor_param = gs_effect_get_param_by_name(
+			filter->effect, "undistort_factor");
+	}
+	else {
+		filter->undistort_factor_param = NULL;
+	}
+}
+
+/* The kept output for the "re-render" modes, shared with identical instances
+ * through gdq-cache.c. */
+static void scale_filter_update_output(struct scale_filter_data *filter,
+	obs_source_t *target)
+{
+	struct gdq_cache_key key;
+	struct gdq_cache_entry *old = filter->output;
+
+	filter->output = NULL;
+
+	if (target && filter->valid && filter->target_valid) {
+		gdq_cache_key_init(&key, "gdq_scale_filter", target);
+		key.cx = (uint32_t)filter->cx_out;
+		key.cy = (uint32_t)filter->cy_out;
+		key.variant = filter->effect;
+		key.flags = (uint32_t)filter->sampling |
+			(uint32_t)filter->undistort << 8 |
+			(uint32_t)filter->sharp << 9;
+		filter->output = gdq_cache_acquire(&key);
+	}
+
+	gdq_counters_output_size(filter->counters,
+		filter->output ? (uint32_t)filter->cx_out : 0,
+		filter->output ? (uint32_t)filter->cy_out : 0);
+	gdq_cache_release(old);
+}
+
+static void scale_filter_set_target(struct scale_filter_data *filter,
+	obs_source_t *target, int cx, int cy)
+{
+	filter->cx_target = cx;
+	filter->cy_target = cy;
+	scale_filter_calc(filter, cx, cy);
+	scale_filter_update_output(filter, target);
+	gdq_frame_state_invalidate(&filter->frames);
+}
+
+static void scale_filter_tick(void *data, float seconds)
+{
+	struct scale_filter_data *filter = data;
+	obs_source_t *target = obs_filter_get_target(filter->context);
+	int cx = 0;
+	int cy = 0;
+
+	if (target) {
+		cx = obs_source_get_base_width(target);
+		cy = obs_source_get_base_height(target);
+	}
+
+	profile_start(scale_tick_name);
+
+	if (!cx || !cy)
+		gdq_counters_invalid_tick(filter->counters);
+
+	if (os_atomic_set_bool(&filter->dirty, false) ||
+	    cx != filter->cx_target || cy != filter->cy_target)
+		scale_filter_set_target(filter, target, cx, cy);
+
+	profile_end(scale_tick_name);
+
+	UNUSED_PARAMETER(seconds);
+}
+
+static void scale_filter_draw(struct scale_filter_data *filter)
+{
+	const char *technique = filter->undistort ?
+		"DrawUndistort" : "Draw";
+
+	if (!obs_source_process_filter_begin(filter->context, GS_RGBA,
+				OBS_NO_DIRECT_RENDERING))
+		return;
+
+	if (filter->dimension_param)
+		gs_effect_set_vec2(filter->dimension_param,
+				&filter->dimension_i);
+
+	if (filter->undistort_factor_param)
+		gs_effect_set_float(filter->undistort_factor_param,
+			(float)filter->undistort_factor);
+
+	if (filter->sampling == OBS_SCALE_POINT)
+		gs_effect_set_next_sampler(filter->image_param,
+				filter->point_sampler);
+
+	/* the effect is shared with the crop filters, so the crop uniforms
+	 * have to be reset to the full texture */
+	if (filter->shared_technique) {
+		struct vec2 mul_val;
+		struct vec2 add_val;
+
+		vec2_set(&mul_val, 1.0f, 1.0f);
+		vec2_zero(&add_val);
+		gs_effect_set_vec2(filter->shared->mul_val, &mul_val);
+		gs_effect_set_vec2(filter->shared->add_val, &add_val);
+		gs_effect_set_vec2(filter->shared->area_footprint,
+				&filter->footprint);
+		gs_effect_set_vec2(filter->shared->sharp_prescale,
+				&filter->prescale);
+		technique = filter->shared_technique;
+	}
+
+	obs_source_process_filter_tech_end(filter->context, filter->effect,
+			filter->cx_out, filter->cy_out, technique);
+}
+
+/* Keeps the scaled output in the cache entry and only scales again when an
+ * identical instance has not already done so this frame and the target has
+ * changed since. */
+static void scale_filter_render_cached(struct scale_filter_data *filter)
+{
+	gs_texture_t *tex = gdq_cache_lookup(filter->output);
+	gs_texrender_t *texrender;
+
+	if (tex)
+		gdq_frame_state_rendered(&filter->frames);
+	else if (!gdq_frame_state_changed(&filter->frames))
+		tex = gdq_cache_reuse(filter->output);
+
+	if (!tex) {
+		texrender = gdq_cache_begin(filter->output);
+		if (!gdq_texrender_begin(texrender, filter->cx_out,
+					filter->cy_out))
+			return;
+
+		scale_filter_draw(filter);
+		gdq_texrender_end(texrender);
+
+		tex = gdq_cache_end(filter->output);
+		gdq_frame_state_rendered(&filter->frames);
+	}
+
+	gdq_draw_texture(tex, filter->cx_out, filter->cy_out);
+}
+
+static void scale_filter_render(void *data, gs_effect_t *effect)
+{
+	struct scale_filter_data *filter = data;
+
+	if (!filter->valid || !filter->target_valid) {
+		obs_source_skip_video_filter(filter->context);
+		gdq_counters_skipped(filter->counters);
+		return;
+	}
+
+	gdq_counters_rendered(filter->counters);
+	profile_start(scale_render_name);
+	gdq_profile_begin(filter->profile);
+
+	if (filter->output && gdq_frame_state_can_reuse(&filter->frames))
+		scale_filter_render_cached(filter);
+	else
+		scale_filter_draw(filter);
+
+	gdq_profile_end(filter->profile);
+	profile_end(scale_render_name);
+
+	UNUSED_PARAMETER(effect);
+}
+
+/* True if what the target draws is the frame as this filter hands it on:
+ * the parent's own, or a crop filter's right before that already cut its
+ * part out of the frame, as in the usual crop then scale chain. */
+static bool scale_filter_target_is_frame(struct scale_filter_data *filter,
+	obs_source_t *parent)
+{
+	obs_source_t *target = obs_filter_get_target(filter->context);
+
+	return target == parent ||
+		(obs_filter_get_target(target) == parent &&
+		gdq_crop_passes_frames(target));
+}
+
+/* Whole factors the frame can be box-filtered down by on the CPU while
+ * staying at least as large as the output; false if it has to be uploaded
+ * as it is. */
+static bool scale_filter_prescale_factors(struct scale_filter_data *filter,
+	obs_source_t *parent, const struct obs_source_frame *frame,
+	uint32_t *kx, uint32_t *ky)
+{
+	/* point sampling would lose its hard edges, an output size that
+	 * follows the frame's aspect would move with the frame, and any
+	 * other earlier filter in the chain expects the whole frame */
+	if (!filter->cpu_prescale || !filter->valid ||
+		filter->aspect_ratio_only ||
+		filter->sampling == OBS_SCALE_POINT || frame->flip ||
+		!gdq_prescale_supported(frame->format) ||
+		!scale_filter_target_is_frame(filter, parent) ||
+		obs_source_get_deinterlace_mode(parent) !=
+		OBS_DEINTERLACE_MODE_DISABLE)
+		return false;
+
+	*kx = gdq_prescale_factor(frame->width, (uint32_t)filter->cx_in);
+	*ky = gdq_prescale_factor(frame->height, (uint32_t)filter->cy_in);
+	return *kx > 1 || *ky > 1;
+}
+
+/* Called for every new frame of an async parent, right before the frame is
+ * uploaded and the filter chain renders it. */
+static struct obs_source_frame *scale_filter_video(void *data,
+	struct obs_source_frame *frame)
+{
+	struct scale_filter_data *filter = data;
+	obs_source_t *parent = obs_filter_get_parent(filter->context);
+	obs_source_t *target = obs_filter_get_target(filter->context);
+	struct obs_source_frame *out = filter->prescaled;
+	uint32_t kx;
+	uint32_t ky;
+	uint32_t cx;
+	uint32_t cy;
+
+	gdq_frame_state_invalidate(&filter->frames);
+
+	pthread_mutex_lock(&filter->benchmark_mutex);
+	filter->last_format = frame->format;
+	filter->last_width = frame->width;
+	filter->last_height = frame->height;
+	pthread_mutex_unlock(&filter->benchmark_mutex);
+
+	if (!scale_filter_prescale_factors(filter, parent, frame, &kx, &ky)) {
+		/* the whole frame is back, and the target with it */
+		if (filter->prescale_active) {
+			filter->prescale_active = false;
+			if (target == parent)
+				scale_filter_set_target(filter, target,
+					(int)frame->width, (int)frame->height);
+			else
+				os_atomic_set_bool(&filter->dirty, true);
+		}
+		return frame;
+	}
+
+	gdq_prescale_size(frame->format, frame->width, frame->height, kx, ky,
+		&cx, &cy);
+
+	if (!out || out->format != frame->format ||
+		out->width != cx || out->height != cy) {
+		obs_source_frame_destroy(out);
+		out = obs_source_frame_create(frame->format, cx, cy);
+		filter->prescaled = out;
+	}
+
+	gdq_prescale_frame(out, frame, kx, ky);
+
+	out->timestamp = frame->timestamp;
+	out->full_range = frame->full_range;
+	memcpy(out->color_matrix, frame->color_matrix,
+		sizeof(out->color_matrix));
+	memcpy(out->color_range_min, frame->color_range_min,
+		sizeof(out->color_range_min));
+	memcpy(out->color_range_max, frame->color_range_max,
+		sizeof(out->color_range_max));
+
+	/* libobs releases the returned frame like one of its own; the extra
+	 * reference keeps it, and the original is not needed any more */
+	out->refs = 2;
+	obs_source_release_frame(parent, frame);
+
+	/* the target takes the new size before the chain renders, so the
+	 * scale follows right away instead of on the next tick */
+	filter->prescale_active = true;
+	if ((int)cx != filter->cx_target || (int)cy != filter->cy_target)
+		scale_filter_set_target(filter, target, (int)cx, (int)cy);
+
+	return out;
+}
+
+/* Draws image scaled to cx by cy into texrender, as the filter would with
+ * the base effect of its sampling. */
+static void benchmark_draw(gs_texrender_t *texrender, gs_texture_t *image,
+	enum obs_scale_type sampling, uint32_t cx, uint32_t cy)
+{
+	uint32_t width = gs_texture_get_width(image);
+	uint32_t height = gs_texture_get_height(image);
+	bool lower_than_2x = cx < width / 2 || cy < height / 2;
+	gs_effect_t *effect = obs_get_base_effect(
+		scale_base_effect(sampling, lower_than_2x));
+	gs_eparam_t *dimension = gs_effect_get_param_by_name(effect,
+		"base_dimension_i");
+	struct vec2 dimension_i;
+
+	gs_texrender_reset(texrender);
+	if (!gdq_texrender_begin(texrender, cx, cy))
+		return;
+
+	vec2_set(&dimension_i, 1.0f / (float)width, 1.0f / (float)height);
+	if (dimension)
+		gs_effect_set_vec2(dimension, &dimension_i);
+	gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"),
+		image);
+
+	while (gs_effect_loop(effect, "Draw"))
+		gs_draw_sprite(image, 0, cx, cy);
+
+	gdq_texrender_end(texrender);
+}
+
+/* GPU time of one run in ns, waiting for the query to come back; 0 if it
+ * does not, or the clock changed under it. */
+static uint64_t benchmark_query_ns(gs_timer_range_t *range, gs_timer_t *timer)
+{
+	for (int i = 0; i < BENCHMARK_QUERY_TRIES; i++) {
+		uint64_t frequency = 0;
+		uint64_t ticks = 0;
+		bool disjoint = false;
+		bool ready;
+
+		obs_enter_graphics();
+		ready = gs_timer_range_get_data(range, &disjoint, &frequency) &&
+			gs_timer_get_data(timer, &ticks);
+		obs_leave_graphics();
+
+		if (ready)
+			return disjoint || !frequency ? 0 :
+				util_mul_div64(ticks, 1000000000ULL, frequency);
+
+		os_sleep_ms(BENCHMARK_QUERY_WAIT_MS);
+	}
+
+	return 0;
+}
+
+/* Times what the GPU does with a frame of that format and size: the upload,
+ * as one plane of bytes, and the scale to cx by cy.  The result is GPU time
+ * from timer queries, or the time taken to submit the work where the
+ * renderer has none; gpu_timed says which. */
+static double benchmark_gpu_path(const struct obs_source_frame *frame,
+	uint32_t cx, uint32_t cy, enum obs_scale_type sampling,
+	bool *gpu_timed)
+{
+	gs_timer_range_t *ranges[BENCHMARK_RUNS] = {0};
+	gs_timer_t *timers[BENCHMARK_RUNS] = {0};
+	uint32_t rows = frame->height;
+	uint32_t linesize = frame->width;
+	gs_texture_t *upload;
+	gs_texture_t *image;
+	gs_texrender_t *texrender;
+	uint64_t submit_ns = 0;
+	uint64_t gpu_ns = 0;
+	uint8_t *data;
+
+	if (frame->format == VIDEO_FORMAT_I420 ||
+		frame->format == VIDEO_FORMAT_NV12)
+		rows += frame->height / 2;
+	else
+		linesize *= 4;
+
+	data = bzalloc((size_t)linesize * rows);
+	*gpu_timed = true;
+
+	obs_enter_graphics();
+	upload = gs_texture_create(linesize, rows, GS_R8, 1, NULL, GS_DYNAMIC);
+	/* stands in for the frame once libobs has converted it */
+	image = gs_texture_create(frame->width, frame->height, GS_RGBA, 1,
+		NULL, GS_RENDER_TARGET);
+	texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	obs_leave_graphics();
+
+	/* a run per graphics lock, so the video thread keeps rendering frames
+	 * in between */
+	for (int i = 0; upload && image && i < BENCHMARK_RUNS; i++) {
+		uint64_t start;
+
+		obs_enter_graphics();
+
+		ranges[i] = gs_timer_range_create();
+		timers[i] = gs_timer_create();
+		*gpu_timed = *gpu_timed && ranges[i] && timers[i];
+
+		start = os_gettime_ns();
+		if (*gpu_timed) {
+			gs_timer_range_begin(ranges[i]);
+			gs_timer_begin(timers[i]);
+		}
+
+		gs_texture_set_image(upload, data, linesize, false);
+		benchmark_draw(texrender, image, sampling, cx, cy);
+
+		if (*gpu_timed) {
+			gs_timer_end(timers[i]);
+			gs_timer_range_end(ranges[i]);
+		}
+		gs_flush();
+		submit_ns += os_gettime_ns() - start;
+
+		obs_leave_graphics();
+	}
+
+	for (int i = 0; *gpu_timed && i < BENCHMARK_RUNS; i++)
+		gpu_ns += benchmark_query_ns(ranges[i], timers[i]);
+
+	obs_enter_graphics();
+	for (int i = 0; i < BENCHMARK_RUNS; i++) {
+		if (timers[i])
+			gs_timer_destroy(timers[i]);
+		if (ranges[i])
+			gs_timer_range_destroy(ranges[i]);
+	}
+	gs_texrender_destroy(texrender);
+	gs_texture_destroy(image);
+	gs_texture_destroy(upload);
+	obs_leave_graphics();
+
+	bfree(data);
+	return (double)(*gpu_timed ? gpu_ns : submit_ns) / BENCHMARK_RUNS /
+		1000000.0;
+}
+
+/* Times both ways of getting a frame to the output size: uploading it whole
+ * for the GPU to scale, or pre-scaling it and letting the GPU scale the
+ * rest.  The pre-scale runs on this thread alone, where live frames are
+ * split across the pre-scale workers as well. */
+static void prescale_benchmark_run(const struct prescale_benchmark *bench,
+	char *result, size_t size)
+{
+	struct obs_source_frame *src;
+	struct obs_source_frame *dst;
+	uint32_t kx;
+	uint32_t ky;
+	uint32_t cx;
+	uint32_t cy;
+	uint64_t start;
+	double prescale_ms;
+	double cpu_ms;
+	double gpu_ms;
+	bool cpu_timed;
+	bool gpu_timed;
+
+	kx = gdq_prescale_factor(bench->width, bench->cx);
+	ky = gdq_prescale_factor(bench->height, bench->cy);
+	gdq_prescale_size(bench->format, bench->width, bench->height, kx, ky,
+		&cx, &cy);
+	src = obs_source_frame_create(bench->format, bench->width,
+		bench->height);
+	dst = obs_source_frame_create(bench->format, cx, cy);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < BENCHMARK_RUNS; i++)
+		gdq_prescale_frame_local(dst, src, kx, ky);
+	prescale_ms = (double)(os_gettime_ns() - start) / BENCHMARK_RUNS /
+		1000000.0;
+
+	cpu_ms = benchmark_gpu_path(dst, bench->cx, bench->cy,
+		bench->sampling, &cpu_timed);
+	gpu_ms = benchmark_gpu_path(src, bench->cx, bench->cy,
+		bench->sampling, &gpu_timed);
+
+	snprintf(result, size,
+		"%ux%u to %ux%u: pre-scale to %ux%u %.2f ms on one thread + "
+		"upload and scale %.2f ms = %.2f ms, upload and scale whole "
+		"%.2f ms (%s)",
+		bench->width, bench->height, bench->cx, bench->cy, cx, cy,
+		prescale_ms, cpu_ms, prescale_ms + cpu_ms, gpu_ms,
+		cpu_timed && gpu_timed ? "GPU time" :
+		"submit time, no GPU timer queries");
+
+	obs_source_frame_destroy(src);
+	obs_source_frame_destroy(dst);
+}
+
+static void *prescale_benchmark_thread(void *data)
+{
+	struct scale_filter_data *filter = data;
+	char result[sizeof(filter->benchmark_result)];
+	bool stop;
+
+	os_set_thread_name("gdq-prescale-benchmark");
+
+	prescale_benchmark_run(&filter->benchmark, result, sizeof(result));
+
+	GDQ_LOG(LOG_INFO, "'%s' pre-scale benchmark: %s",
+		obs_source_get_name(filter->context), result);
+
+	pthread_mutex_lock(&filter->benchmark_mutex);
+	strcpy(filter->benchmark_result, result);
+	filter->benchmark_running = false;
+	stop = filter->benchmark_stop;
+	pthread_mutex_unlock(&filter->benchmark_mutex);
+
+	/* shows the result in properties that are open */
+	if (!stop)
+		obs_source_update_properties(filter->context);
+
+	return NULL;
+}
+
+/* Starts the benchmark on a thread of its own for the last frame size; the
+ * result shows up in the properties once it is done. */
+static bool prescale_benchmark_clicked(obs_properties_t *props,
+	obs_property_t *p, void *data)
+{
+	struct scale_filter_data *filter = data;
+	struct prescale_benchmark *bench = &filter->benchmark;
+	const char *error = NULL;
+
+	pthread_mutex_lock(&filter->benchmark_mutex);
+
+	if (filter->benchmark_running)
+		goto done;
+
+	if (filter->benchmark_started) {
+		pthread_join(filter->benchmark_thread, NULL);
+		filter->benchmark_started = false;
+	}
+
+	bench->format = filter->last_format;
+	bench->width = filter->last_width;
+	bench->height = filter->last_height;
+	bench->cx = (uint32_t)filter->cx_in;
+	bench->cy = (uint32_t)filter->cy_in;
+	bench->sampling = filter->sampling;
+
+	if (!gdq_prescale_supported(bench->format) || !bench->width ||
+		!bench->height) {
+		bench->format = VIDEO_FORMAT_NV12;
+		bench->width = BENCHMARK_WIDTH;
+		bench->height = BENCHMARK_HEIGHT;
+	}
+
+	if (!filter->valid || filter->aspect_ratio_only)
+		error = obs_module_text("PreScale.NeedsResolution");
+	else if (gdq_prescale_factor(bench->width, bench->cx) == 1 &&
+		gdq_prescale_factor(bench->height, bench->cy) == 1)
+		error = obs_module_text("PreScale.NotSmaller");
+
+	if (error) {
+		snprintf(filter->benchmark_result,
+			sizeof(filter->benchmark_result), "%s", error);
+		goto done;
+	}
+
+	filter->benchmark_result[0] = 0;
+	filter->benchmark_running = pthread_create(&filter->benchmark_thread,
+		NULL, prescale_benchmark_thread, filter) == 0;
+	filter->benchmark_started = filter->benchmark_running;
+
+done:
+	pthread_mutex_unlock(&filter->benchmark_mutex);
+
+	UNUSED_PARAMETER(props);
+	UNUSED_PARAMETER(p);
+	return true;
+}
+
+/* The benchmark result as of when the properties are opened; it is not
+ * kept in the settings. */
+static void prescale_benchmark_add_property(obs_properties_t *props,
+	struct scale_filter_data *filter)
+{
+	char str[sizeof(filter->benchmark_result) + 64];
+
+	pthread_mutex_lock(&filter->benchmark_mutex);
+	if (filter->benchmark_running)
+		snprintf(str, sizeof(str), "%s: %s", T_PRESCALE_RESULT,
+			T_PRESCALE_RUNNING);
+	else if (filter->benchmark_result[0])
+		snprintf(str, sizeof(str), "%s: %s", T_PRESCALE_RESULT,
+			filter->benchmark_result);
+	else
+		str[0] = 0;
+	pthread_mutex_unlock(&filter->benchmark_mutex);
+
+	if (str[0])
+		obs_properties_add_text(props, S_PRESCALE_RESULT, str,
+			OBS_TEXT_INFO);
+}
+
+static const double downscale_vals[] = {
+	1.0,
+	1.25,
+	(1.0/0.75),
+	1.5,
+	(1.0/0.6),
+	1.75,
+	2.0,
+	2.25,
+	2.5,
+	2.75,
+	3.0
+};
+
+#define NUM_DOWNSCALES (sizeof(downscale_vals) / sizeof(double))
+
+static const char *aspects[] = {
+	"16:9",
+	"16:10",
+	"4:3",
+	"1:1"
+};
+
+#define NUM_ASPECTS (sizeof(aspects) / sizeof(const char *))
+
+static bool sampling_modified(obs_properties_t *props, obs_property_t *p,
+	obs_data_t *settings)
+{
+	const char *sampling = obs_data_get_string(settings, S_SAMPLING);
+
+	bool has_undistort;
+	if (astrcmpi(sampling, S_SAMPLING_POINT) == 0) {
+		has_undistort = false;
+
+	}
+	else if (astrcmpi(sampling, S_SAMPLING_BILINEAR) == 0) {
+		has_undistort = false;
+
+	}
+	else if (astrcmpi(sampling, S_SAMPLING_LANCZOS) == 0) {
+		has_undistort = true;
+
+	}
+	else if (astrcmpi(sampling, S_SAMPLING_AREA) == 0) {
+		has_undistort = false;
+
+	}
+	else if (astrcmpi(sampling, S_SAMPLING_SHARP_BILINEAR) == 0) {
+		has_undistort = false;
+
+	}
+	else { /* S_SAMPLING_BICUBIC */
+		has_undistort = true;
+	}
+
+	obs_property_set_visible(obs_properties_get(props, S_UNDISTORT), has_undistort);
+
+	UNUSED_PARAMETER(p);
+	return true;
+}
+
+void scale_add_resolution_property(obs_properties_t *props)
+{
+	struct obs_video_info ovi;
+	obs_property_t *p;
+	uint32_t cx;
+	uint32_t cy;
+
+	struct {
+		int cx;
+		int cy;
+	} downscales[NUM_DOWNSCALES];
+
+	/* ----------------- */
+
+	obs_get_video_info(&ovi);
+	cx = ovi.base_width;
+	cy = ovi.base_height;
+
+	for (size_t i = 0; i < NUM_DOWNSCALES; i++) {
+		downscales[i].cx = (int)((double)cx / downscale_vals[i]);
+		downscales[i].cy = (int)((double)cy / downscale_vals[i]);
+	}
+
+	p = obs_properties_add_list(props, S_RESOLUTION, T_RESOLUTION,
+			OBS_COMBO_TYPE_EDITABLE, OBS_COMBO_FORMAT_STRING);
+
+	obs_property_list_add_string(p, T_NONE, T_NONE);
+
+	for (size_t i = 0; i < NUM_ASPECTS; i++)
+		obs_property_list_add_string(p, aspects[i], aspects[i]);
+
+	for (size_t i = 0; i < NUM_DOWNSCALES; i++) {
+		char str[32];
+		snprintf(str, 32, "%dx%d", downscales[i].cx, downscales[i].cy);
+		obs_property_list_add_string(p, str, str);
+	}
+}
+
+static obs_properties_t *scale_filter_properties(void *data)
+{
+	obs_properties_t *props = obs_properties_create();
+	obs_property_t *p;
+
+	p = obs_properties_add_list(props, S_SAMPLING, T_SAMPLING,
+			OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+	obs_property_set_modified_callback(p, sampling_modified);
+	obs_property_list_add_string(p, T_SAMPLING_POINT,    S_SAMPLING_POINT);
+	obs_property_list_add_string(p, T_SAMPLING_BILINEAR, S_SAMPLING_BILINEAR);
+	obs_property_list_add_string(p, T_SAMPLING_BICUBIC,  S_SAMPLING_BICUBIC);
+	obs_property_list_add_string(p, T_SAMPLING_LANCZOS,  S_SAMPLING_LANCZOS);
+	obs_property_list_add_string(p, T_SAMPLING_AREA,     S_SAMPLING_AREA);
+	obs_property_list_add_string(p, T_SAMPLING_SHARP_BILINEAR,
+			S_SAMPLING_SHARP_BILINEAR);
+
+	/* ----------------- */
+
+	scale_add_resolution_property(props);
+
+	obs_properties_add_bool(props, S_UNDISTORT, T_UNDISTORT);
+
+	gdq_add_rerender_property(props);
+
+	/* ----------------- */
+
+	obs_properties_add_bool(props, S_PRESCALE, T_PRESCALE);
+	obs_properties_add_button(props, S_PRESCALE_BENCHMARK,
+			T_PRESCALE_BENCHMARK, prescale_benchmark_clicked);
+
+	/* ----------------- */
+
+	if (data) {
+		struct scale_filter_data *filter = data;
+
+		prescale_benchmark_add_property(props, filter);
+		gdq_profile_add_property(props, filter->profile);
+	}
+
+	return props;
+}
+
+static void scale_filter_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_string(settings, S_SAMPLING, S_SAMPLING_BICUBIC);
+	obs_data_set_default_string(settings, S_RESOLUTION, T_NONE);
+	obs_data_set_default_bool(settings, S_UNDISTORT, 0);
+	obs_data_set_default_bool(settings, S_PRESCALE, false);
+	gdq_rerender_defaults(settings);
+}
+
+static uint32_t scale_filter_width(void *data)
+{
+	struct scale_filter_data *filter = data;
+	return (uint32_t)filter->cx_out;
+}
+
+static uint32_t scale_filter_height(void *data)
+{
+	struct scale_filter_data *filter = data;
+	return (uint32_t)filter->cy_out;
+}
+
+struct obs_source_info scale_filter = {
+	.id                            = "gdq_scale_filter",
+	.type                          = OBS_SOURCE_TYPE_FILTER,
+	.output_flags                  = OBS_SOURCE_VIDEO,
+	.get_name                      = scale_filter_name,
+	.create                        = scale_filter_create,
+	.destroy                       = scale_filter_destroy,
+	.video_tick                    = scale_filter_tick,
+	.video_render                  = scale_filter_render,
+	.filter_video                  = scale_filter_video,
+	.update                        = scale_filter_update,
+	.get_properties                = scale_filter_properties,
+	.get_defaults                  = scale_filter_defaults,
+	.get_width                     = scale_filter_width,
+	.get_height                    = scale_filter_height
+};
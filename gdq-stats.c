@@ -0,0 +1,236 @@
+#include <obs-module.h>
+#include <util/threading.h>
+#include "gdq-crop.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/*
+ * Runtime counters.  Every filter instance owns a counter block that only
+ * it writes, with single atomic adds or stores on the render path, and
+ * that is linked into a registry for as long as the instance lives.  The
+ * module's "gdq_get_stats" proc returns a JSON snapshot of all blocks,
+ * their totals and the render target pool, for monitoring to poll.
+ *
+ * The counters are 64-bit: a marathon runs for a week at 60 frames a
+ * second, and long is 32-bit on Windows.  libobs only has atomics for long,
+ * so the few needed here are defined below.
+ */
+
+struct gdq_counters {
+	obs_source_t                   *source;
+	const char                     *kind;
+
+	volatile long long             frames_rendered;
+	volatile long long             frames_skipped;
+	volatile long long             reallocations;
+	volatile long long             invalid_ticks;
+	volatile long long             texture_bytes;
+
+	/* last output size, only seen by the graphics thread */
+	uint32_t                       cx;
+	uint32_t                       cy;
+
+	struct gdq_counters            *next;
+	struct gdq_counters            **prev_next;
+};
+
+static struct gdq_counters *registry;
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+#ifdef _MSC_VER
+static inline void counter_inc(volatile long long *val)
+{
+	_InterlockedIncrement64(val);
+}
+
+static inline void counter_set(volatile long long *ptr, long long val)
+{
+	_InterlockedExchange64(ptr, val);
+}
+
+static inline long long counter_load(volatile long long *ptr)
+{
+	return _InterlockedCompareExchange64(ptr, 0, 0);
+}
+#else
+static inline void counter_inc(volatile long long *val)
+{
+	__atomic_add_fetch(val, 1, __ATOMIC_RELAXED);
+}
+
+static inline void counter_set(volatile long long *ptr, long long val)
+{
+	__atomic_store_n(ptr, val, __ATOMIC_RELAXED);
+}
+
+static inline long long counter_load(volatile long long *ptr)
+{
+	return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+}
+#endif
+
+
+struct gdq_counters *gdq_counters_create(obs_source_t *source,
+	const char *kind)
+{
+	struct gdq_counters *counters = bzalloc(sizeof(*counters));
+
+	counters->source = source;
+	counters->kind = kind;
+
+	pthread_mutex_lock(&registry_mutex);
+	counters->next = registry;
+	counters->prev_next = &registry;
+	if (registry)
+		registry->prev_next = &counters->next;
+	registry = counters;
+	pthread_mutex_unlock(&registry_mutex);
+
+	return counters;
+}
+
+
+void gdq_counters_destroy(struct gdq_counters *counters)
+{
+	if (!counters)
+		return;
+
+	pthread_mutex_lock(&registry_mutex);
+	*counters->prev_next = counters->next;
+	if (counters->next)
+		counters->next->prev_next = counters->prev_next;
+	pthread_mutex_unlock(&registry_mutex);
+
+	bfree(counters);
+}
+
+
+void gdq_counters_rendered(struct gdq_counters *counters)
+{
+	if (counters)
+		counter_inc(&counters->frames_rendered);
+}
+
+
+void gdq_counters_skipped(struct gdq_counters *counters)
+{
+	if (counters)
+		counter_inc(&counters->frames_skipped);
+}
+
+
+void gdq_counters_invalid_tick(struct gdq_counters *counters)
+{
+	if (counters)
+		counter_inc(&counters->invalid_ticks);
+}
+
+
+/* Notes the size of the output texture after a geometry change; a new
+ * size means the texture is allocated again.  0 by 0 is no texture. */
+void gdq_counters_output_size(struct gdq_counters *counters,
+	uint32_t cx, uint32_t cy)
+{
+	if (!counters || (cx == counters->cx && cy == counters->cy))
+		return;
+
+	if (cx && cy && counters->cx && counters->cy)
+		counter_inc(&counters->reallocations);
+
+	counters->cx = cx;
+	counters->cy = cy;
+	counter_set(&counters->texture_bytes, (long long)cx * cy * 4);
+}
+
+
+static void stats_set_counters(obs_data_t *data, long long rendered,
+	long long skipped, long long reallocations, long long invalid_ticks,
+	long long texture_bytes)
+{
+	obs_data_set_int(data, "frames_rendered", rendered);
+	obs_data_set_int(data, "frames_skipped", skipped);
+	obs_data_set_int(data, "reallocations", reallocations);
+	obs_data_set_int(data, "invalid_ticks", invalid_ticks);
+	obs_data_set_int(data, "texture_bytes", texture_bytes);
+}
+
+
+/* void gdq_get_stats(out string json) */
+static void stats_get_proc(void *data, calldata_t *cd)
+{
+	obs_data_t *snapshot = obs_data_create();
+	obs_data_t *totals = obs_data_create();
+	obs_data_t *pool = obs_data_create();
+	obs_data_array_t *instances = obs_data_array_create();
+	struct gdq_pool_stats pool_stats;
+	long long sums[4] = {0};
+	long long texture_bytes = 0;
+
+	pthread_mutex_lock(&registry_mutex);
+
+	for (struct gdq_counters *c = registry; c; c = c->next) {
+		obs_data_t *instance = obs_data_create();
+		bool filter = obs_source_get_type(c->source) ==
+			OBS_SOURCE_TYPE_FILTER;
+		obs_source_t *parent = filter ?
+			obs_filter_get_parent(c->source) : NULL;
+		long long values[4] = {
+			counter_load(&c->frames_rendered),
+			counter_load(&c->frames_skipped),
+			counter_load(&c->reallocations),
+			counter_load(&c->invalid_ticks)
+		};
+		long long bytes = counter_load(&c->texture_bytes);
+
+		/* a source that is not a filter counts for itself; a filter
+		 * being removed has no parent any more */
+		obs_data_set_string(instance, "filter",
+			filter ? obs_source_get_name(c->source) : "");
+		obs_data_set_string(instance, "source",
+			filter ? (parent ? obs_source_get_name(parent) : "") :
+			obs_source_get_name(c->source));
+		obs_data_set_string(instance, "kind", c->kind);
+		stats_set_counters(instance, values[0], values[1], values[2],
+			values[3], bytes);
+		obs_data_array_push_back(instances, instance);
+		obs_data_release(instance);
+
+		for (size_t i = 0; i < 4; i++)
+			sums[i] += values[i];
+		texture_bytes += bytes;
+	}
+
+	pthread_mutex_unlock(&registry_mutex);
+
+	stats_set_counters(totals, sums[0], sums[1], sums[2], sums[3],
+		texture_bytes);
+
+	gdq_pool_get_stats(&pool_stats);
+	obs_data_set_int(pool, "current_bytes",
+		(long long)pool_stats.current_bytes);
+	obs_data_set_int(pool, "peak_bytes", (long long)pool_stats.peak_bytes);
+	obs_data_set_int(pool, "in_use_bytes",
+		(long long)pool_stats.in_use_bytes);
+
+	obs_data_set_array(snapshot, "instances", instances);
+	obs_data_set_obj(snapshot, "totals", totals);
+	obs_data_set_obj(snapshot, "pool", pool);
+
+	calldata_set_string(cd, "json", obs_data_get_json(snapshot));
+
+	obs_data_array_release(instances);
+	obs_data_release(pool);
+	obs_data_release(totals);
+	obs_data_release(snapshot);
+	UNUSED_PARAMETER(data);
+}
+
+
+void gdq_stats_init(void)
+{
+	proc_handler_add(obs_get_proc_handler(),
+		"void gdq_get_stats(out string json)", stats_get_proc, NULL);
+}
@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <obs-module.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include "obs-stub.h"
+#include "gdq-crop.h"
+
+/*
+ * CPU cost of the module's source callbacks and preset lookups, run headless
+ * against the libobs stub.  Nothing is drawn, so the render column is the
+ * filters' own bookkeeping around draws that do nothing.
+ *
+ *   gdq-bench [--quick]
+ *
+ * --quick runs the smallest sizes only, to check that the benchmark itself
+ * still works.
+ */
+
+static char config_dir[] = "/tmp/gdq-bench-XXXXXX";
+
+static const size_t instance_counts[] = {1, 10, 100, 1000};
+static const size_t preset_counts[] = {10, 100, 1000, 10000, 100000};
+
+/* lookups timed per preset file, spread over its entries */
+#define LOOKUPS                         10000
+#define SETS                            100
+
+
+static double elapsed_us(uint64_t start, size_t count)
+{
+	return (double)(os_gettime_ns() - start) / 1000.0 /
+		(double)(count ? count : 1);
+}
+
+
+static void config_path(struct dstr *path, const char *name)
+{
+	dstr_printf(path, "%s/%s", config_dir, name);
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+struct instance {
+	obs_source_t                   *input;
+	obs_source_t                   *crop;
+	obs_source_t                   *scale;
+};
+
+
+static obs_data_t *input_settings(uint32_t width, uint32_t height)
+{
+	obs_data_t *settings = obs_data_create();
+
+	obs_data_set_int(settings, "width", width);
+	obs_data_set_int(settings, "height", height);
+	return settings;
+}
+
+
+static void instance_create(struct instance *inst, size_t i)
+{
+	struct dstr name = {0};
+	obs_data_t *settings = input_settings(720, 480);
+
+	dstr_printf(&name, "input %zu", i);
+	inst->input = obs_source_create(STUB_INPUT_ID, name.array, settings,
+		NULL);
+	obs_data_release(settings);
+
+	settings = obs_data_create();
+	obs_data_set_int(settings, "left", 8);
+	obs_data_set_int(settings, "right", 8);
+	obs_data_set_int(settings, "top", 4);
+	obs_data_set_int(settings, "bottom", 4);
+	inst->crop = obs_source_create("gdq_crop_console_filter", "crop",
+		settings, NULL);
+	obs_source_filter_add(inst->input, inst->crop);
+	obs_data_release(settings);
+
+	settings = obs_data_create();
+	obs_data_set_string(settings, "resolution", "4:3");
+	inst->scale = obs_source_create("gdq_scale_filter", "scale", settings,
+		NULL);
+	obs_source_filter_add(inst->input, inst->scale);
+	obs_data_release(settings);
+
+	dstr_free(&name);
+}
+
+
+static void instance_destroy(struct instance *inst)
+{
+	obs_source_filter_remove(inst->input, inst->scale);
+	obs_source_filter_remove(inst->input, inst->crop);
+	obs_source_release(inst->scale);
+	obs_source_release(inst->crop);
+	obs_source_release(inst->input);
+}
+
+
+static void bench_instances(size_t count)
+{
+	struct instance *insts = bzalloc(count * sizeof(*insts));
+	double create_us;
+	double update_us;
+	double tick_us;
+	double props_us;
+	double render_us;
+	double destroy_us;
+	uint64_t start;
+
+	start = os_gettime_ns();
+	for (size_t i = 0; i < count; i++)
+		instance_create(&insts[i], i);
+	stub_video_tick(1.0f / 60.0f);
+	create_us = elapsed_us(start, count);
+
+	/* a new crop each, applied in the next frame */
+	start = os_gettime_ns();
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *settings = obs_data_create();
+
+		obs_data_set_int(settings, "left", 4 + (int)(i % 8));
+		obs_source_update(insts[i].crop, settings);
+		obs_data_release(settings);
+	}
+	stub_video_tick(1.0f / 60.0f);
+	update_us = elapsed_us(start, count);
+
+	start = os_gettime_ns();
+	for (int frame = 0; frame < 10; frame++)
+		stub_video_tick(1.0f / 60.0f);
+	tick_us = elapsed_us(start, count * 10);
+
+	start = os_gettime_ns();
+	for (size_t i = 0; i < count; i++) {
+		obs_properties_destroy(obs_source_properties(insts[i].crop));
+		obs_properties_destroy(obs_source_properties(insts[i].scale));
+	}
+	props_us = elapsed_us(start, count);
+
+	start = os_gettime_ns();
+	for (int frame = 0; frame < 10; frame++)
+		for (size_t i = 0; i < count; i++)
+			obs_source_video_render(insts[i].input);
+	render_us = elapsed_us(start, count * 10);
+
+	start = os_gettime_ns();
+	for (size_t i = 0; i < count; i++)
+		instance_destroy(&insts[i]);
+	destroy_us = elapsed_us(start, count);
+
+	printf("%9zu %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f\n", count,
+		create_us, update_us, tick_us, props_us, render_us,
+		destroy_us);
+
+	bfree(insts);
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+static void preset_name(struct dstr *name, size_t i)
+{
+	dstr_printf(name, "Console %zu", i);
+}
+
+
+/* Every tenth preset has a group, every fourth a size of its own. */
+static void write_presets(size_t count)
+{
+	struct dstr path = {0};
+	struct dstr text = {0};
+
+	for (size_t i = 0; i < count; i++) {
+		dstr_catf(&text, "Console %zu\n", i);
+		dstr_catf(&text, "\tleft:%zu, right:%zu, top:%zu, bottom:%zu",
+			i % 16, i % 16, i % 8, i % 8);
+		if (i % 4 == 0)
+			dstr_catf(&text, ", size:%zux%zu", 320 + i, 240 + i);
+		if (i % 10 == 0)
+			dstr_catf(&text, ", group:Group %zu", i % 100);
+		dstr_cat(&text, "\n");
+	}
+
+	config_path(&path, "gdq-crop.cfg");
+	os_quick_write_utf8_file_safe(path.array, text.array, text.len, false,
+		"tmp", NULL);
+
+	config_path(&path, "gdq-crop.journal");
+	unlink(path.array);
+
+	dstr_free(&text);
+	dstr_free(&path);
+}
+
+
+static void bench_presets(size_t count)
+{
+	obs_properties_t *props = obs_properties_create();
+	obs_property_t *list = obs_properties_add_list(props, "list", "",
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+	struct dstr name = {0};
+	struct crop_rect rect;
+	size_t found = 0;
+	double init_us;
+	double find_us;
+	double size_us;
+	double list_us;
+	double set_us;
+	uint64_t start;
+
+	write_presets(count);
+
+	start = os_gettime_ns();
+	gdq_presets_init();
+	init_us = elapsed_us(start, 1);
+
+	start = os_gettime_ns();
+	for (size_t i = 0; i < LOOKUPS; i++) {
+		preset_name(&name, i * 7919 % count);
+		found += gdq_presets_find(name.array, &rect);
+	}
+	find_us = elapsed_us(start, LOOKUPS);
+
+	start = os_gettime_ns();
+	for (size_t i = 0; i < LOOKUPS; i++) {
+		size_t n = i * 7919 % count / 4 * 4;
+
+		found += gdq_presets_find_size(320 + (uint32_t)n,
+			240 + (uint32_t)n, &rect);
+	}
+	size_us = elapsed_us(start, LOOKUPS);
+
+	/* what the console and group lists in the properties cost */
+	start = os_gettime_ns();
+	gdq_presets_list_groups(list);
+	obs_property_list_clear(list);
+	gdq_presets_list(list, "", 0);
+	list_us = elapsed_us(start, 1);
+
+	start = os_gettime_ns();
+	for (size_t i = 0; i < SETS; i++) {
+		preset_name(&name, count + i);
+		gdq_presets_set(name.array, "", &rect, 0, 0);
+	}
+	set_us = elapsed_us(start, SETS);
+
+	/* not timed: stopping waits out the file watcher's poll */
+	gdq_presets_free();
+
+	if (found != LOOKUPS * 2)
+		fprintf(stderr, "only %zu of %d lookups found a preset\n",
+			found, LOOKUPS * 2);
+
+	printf("%9zu %10.0f %10.3f %10.3f %10.0f %10.2f\n", count, init_us,
+		find_us, size_us, list_us, set_us);
+
+	dstr_free(&name);
+	obs_properties_destroy(props);
+}
+
+
+static void remove_config(void)
+{
+	struct dstr path = {0};
+
+	config_path(&path, "gdq-crop.cfg");
+	unlink(path.array);
+	config_path(&path, "gdq-crop.journal");
+	unlink(path.array);
+	rmdir(config_dir);
+	dstr_free(&path);
+}
+
+
+int main(int argc, char *argv[])
+{
+	bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+	size_t instance_runs = quick ? 2 :
+		sizeof(instance_counts) / sizeof(instance_counts[0]);
+	size_t preset_runs = quick ? 2 :
+		sizeof(preset_counts) / sizeof(preset_counts[0]);
+
+	if (!mkdtemp(config_dir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+
+	stub_startup(GDQ_DATA_DIR, config_dir);
+
+	write_presets(10);
+	obs_module_load();
+
+	printf("per instance of an input with a crop and a scale filter, us\n");
+	printf("%9s %10s %10s %10s %10s %10s %10s\n", "instances", "create",
+		"update", "tick", "properties", "render", "destroy");
+	for (size_t i = 0; i < instance_runs; i++)
+		bench_instances(instance_counts[i]);
+
+	obs_module_unload();
+
+	printf("\npreset file operations, us; find, size and set per call\n");
+	printf("%9s %10s %10s %10s %10s %10s\n", "presets", "init", "find",
+		"size", "list", "set");
+	for (size_t i = 0; i < preset_runs; i++)
+		bench_presets(preset_counts[i]);
+
+	stub_shutdown();
+	remove_config();
+	return 0;
+}
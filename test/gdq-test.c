@@ -0,0 +1,867 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <obs-module.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include "obs-stub.h"
+#include "gdq-crop.h"
+
+/*
+ * Tests of the module's geometry, preset and CPU paths, run headless
+ * against the libobs stub in libobs-stub/.  Each test_* function checks
+ * one area; a failed check is reported and the remaining ones still run.
+ */
+
+static int failures;
+static int checks;
+
+#define CHECK(cond)                                                         \
+	do {                                                                \
+		checks++;                                                   \
+		if (!(cond)) {                                              \
+			failures++;                                         \
+			fprintf(stderr, "%s:%d: %s: check failed: %s\n",    \
+				__FILE__, __LINE__, __func__, #cond);       \
+		}                                                           \
+	} while (false)
+
+#define CHECK_FLOAT(a, b) CHECK(fabsf((float)(a) - (float)(b)) < 1e-5f)
+
+static char config_dir[] = "/tmp/gdq-test-XXXXXX";
+
+
+static void write_file(const char *name, const char *contents)
+{
+	struct dstr path = {0};
+	FILE *f;
+
+	dstr_printf(&path, "%s/%s", config_dir, name);
+	f = fopen(path.array, "wb");
+	if (f) {
+		fputs(contents, f);
+		fclose(f);
+	}
+	dstr_free(&path);
+}
+
+
+static char *read_file(const char *name)
+{
+	struct dstr path = {0};
+	char *contents;
+
+	dstr_printf(&path, "%s/%s", config_dir, name);
+	contents = os_quick_read_utf8_file(path.array);
+	dstr_free(&path);
+	return contents;
+}
+
+
+static void remove_file(const char *name)
+{
+	struct dstr path = {0};
+
+	dstr_printf(&path, "%s/%s", config_dir, name);
+	unlink(path.array);
+	dstr_free(&path);
+}
+
+
+static bool rect_is(const struct crop_rect *rect, int left, int right,
+	int top, int bottom)
+{
+	return rect->left == left && rect->right == right &&
+		rect->top == top && rect->bottom == bottom;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+static void test_calc_crop(void)
+{
+	struct vec2 mul;
+	struct vec2 add;
+	uint32_t cx;
+	uint32_t cy;
+
+	gdq_calc_crop(720, 480, 8, 12, 4, 6, &cx, &cy, &mul, &add);
+	CHECK(cx == 700 && cy == 470);
+	CHECK_FLOAT(mul.x, 700.0f / 720.0f);
+	CHECK_FLOAT(mul.y, 470.0f / 480.0f);
+	CHECK_FLOAT(add.x, 8.0f / 720.0f);
+	CHECK_FLOAT(add.y, 4.0f / 480.0f);
+
+	gdq_calc_crop(720, 480, 0, 0, 0, 0, &cx, &cy, &mul, &add);
+	CHECK(cx == 720 && cy == 480);
+	CHECK_FLOAT(mul.x, 1.0f);
+	CHECK_FLOAT(add.x, 0.0f);
+
+	/* cropping everything away leaves nothing, with zeroed factors */
+	gdq_calc_crop(720, 480, 400, 400, 0, 480, &cx, &cy, &mul, &add);
+	CHECK(cx == 0 && cy == 0);
+	CHECK_FLOAT(mul.x, 0.0f);
+	CHECK_FLOAT(mul.y, 0.0f);
+	CHECK_FLOAT(add.y, 0.0f);
+
+	/* no target yet */
+	gdq_calc_crop(0, 0, 8, 8, 8, 8, &cx, &cy, &mul, &add);
+	CHECK(cx == 0 && cy == 0);
+}
+
+
+static void test_aspects(void)
+{
+	CHECK(strcmp(gdq_aspect_resolution("Default [16:9]"), "16:9") == 0);
+	CHECK(strcmp(gdq_aspect_resolution("4:3"), "4:3") == 0);
+	CHECK(strcmp(gdq_aspect_name("3:2"),
+		"GameCube Game played on Wii Console [3:2]") == 0);
+
+	/* the override leaves the scale filters alone */
+	CHECK(gdq_aspect_name("total override [Do not use!]") != NULL);
+	CHECK(gdq_aspect_resolution("total override [Do not use!]") == NULL);
+
+	CHECK(gdq_aspect_name("21:9") == NULL);
+	CHECK(gdq_aspect_resolution("") == NULL);
+}
+
+
+static void test_scale_size(void)
+{
+	bool aspect_only;
+	int cx;
+	int cy;
+
+	CHECK(scale_parse_resolution("1280x720", &cx, &cy, &aspect_only));
+	CHECK(cx == 1280 && cy == 720 && !aspect_only);
+	CHECK(scale_parse_resolution("16:9", &cx, &cy, &aspect_only));
+	CHECK(cx == 16 && cy == 9 && aspect_only);
+	CHECK(!scale_parse_resolution("None", &cx, &cy, &aspect_only));
+
+	CHECK(scale_parse_sampling("LANCZOS") == OBS_SCALE_LANCZOS);
+	CHECK(scale_parse_sampling("area") == OBS_SCALE_AREA);
+	CHECK(scale_parse_sampling("unknown") == OBS_SCALE_BICUBIC);
+
+	/* a wider aspect widens, a narrower one makes it taller */
+	CHECK(scale_calc_output_size(720, 480, 16, 9, true, &cx, &cy));
+	CHECK(cx == 853 && cy == 480);
+	CHECK(scale_calc_output_size(720, 480, 4, 3, true, &cx, &cy));
+	CHECK(cx == 720 && cy == 540);
+
+	/* already the aspect: nothing to scale */
+	CHECK(!scale_calc_output_size(640, 480, 4, 3, true, &cx, &cy));
+
+	CHECK(scale_calc_output_size(720, 480, 1920, 1080, false, &cx, &cy));
+	CHECK(cx == 1920 && cy == 1080);
+}
+
+
+static void test_autocrop_detect(void)
+{
+	const uint32_t width = 320;
+	const uint32_t height = 240;
+	const uint32_t linesize = width * 4 + 16;
+	uint8_t *image = bzalloc(linesize * height);
+	struct crop_rect rect = {0};
+
+	/* a noisy picture inside dark, slightly noisy borders */
+	srand(1);
+	for (uint32_t y = 0; y < height; y++) {
+		for (uint32_t x = 0; x < width; x++) {
+			uint8_t *px = image + y * linesize + x * 4;
+			bool inside = x >= 24 && x < width - 16 &&
+				y >= 10 && y < height - 6;
+
+			px[0] = (uint8_t)(inside ? 40 + rand() % 200 : 0);
+			px[1] = (uint8_t)(inside ? rand() % 256 : rand() % 12);
+			px[2] = (uint8_t)(inside ? rand() % 256 : 0);
+			px[3] = 255;
+		}
+	}
+
+	CHECK(gdq_autocrop_detect(image, linesize, width, height, 24, &rect));
+	CHECK(rect_is(&rect, 24, 16, 10, 6));
+
+	/* a black picture has no borders to find */
+	memset(image, 0, linesize * height);
+	CHECK(!gdq_autocrop_detect(image, linesize, width, height, 24, &rect));
+
+	bfree(image);
+}
+
+
+/* Every output sample is the rounded mean of its kx by ky block. */
+static bool prescale_matches(const struct obs_source_frame *src,
+	const struct obs_source_frame *dst, size_t plane, uint32_t channels,
+	uint32_t cx, uint32_t cy, uint32_t kx, uint32_t ky)
+{
+	for (uint32_t y = 0; y < cy; y++) {
+		for (uint32_t x = 0; x < cx * channels; x++) {
+			uint32_t sum = 0;
+
+			for (uint32_t j = 0; j < ky; j++)
+				for (uint32_t i = 0; i < kx; i++)
+					sum += src->data[plane][(y * ky + j) *
+						src->linesize[plane] +
+						((x / channels) * kx + i) *
+						channels + x % channels];
+
+			if (dst->data[plane][y * dst->linesize[plane] + x] !=
+				(sum + kx * ky / 2) / (kx * ky))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+
+static void test_prescale(void)
+{
+	const enum video_format formats[] = {
+		VIDEO_FORMAT_BGRA, VIDEO_FORMAT_NV12
+	};
+	const uint32_t width = 203;
+	const uint32_t height = 117;
+
+	CHECK(gdq_prescale_supported(VIDEO_FORMAT_NV12));
+	CHECK(!gdq_prescale_supported(VIDEO_FORMAT_YUY2));
+	CHECK(gdq_prescale_factor(3840, 1280) == 3);
+	CHECK(gdq_prescale_factor(1280, 1280) == 1);
+
+	srand(2);
+
+	for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+		bool nv12 = formats[f] == VIDEO_FORMAT_NV12;
+		struct obs_source_frame *src =
+			obs_source_frame_create(formats[f], width, height);
+
+		for (uint32_t i = 0; i < src->linesize[0] * height; i++)
+			src->data[0][i] = (uint8_t)rand();
+		for (uint32_t i = 0; nv12 &&
+			i < src->linesize[1] * ((height + 1) / 2); i++)
+			src->data[1][i] = (uint8_t)rand();
+
+		for (uint32_t k = 1; k <= 4; k++) {
+			struct obs_source_frame *dst;
+			uint32_t cx;
+			uint32_t cy;
+
+			gdq_prescale_size(formats[f], width, height, k, k, &cx,
+				&cy);
+			dst = obs_source_frame_create(formats[f], cx, cy);
+
+			CHECK(gdq_prescale_frame(dst, src, k, k));
+			CHECK(prescale_matches(src, dst, 0, nv12 ? 1 : 4, cx, cy,
+				k, k));
+			CHECK(!nv12 || prescale_matches(src, dst, 1, 2, cx / 2,
+				cy / 2, k, k));
+
+			/* the benchmark's, without the workers */
+			memset(dst->data[0], 0, dst->linesize[0] * cy);
+			CHECK(gdq_prescale_frame_local(dst, src, k, k));
+			CHECK(prescale_matches(src, dst, 0, nv12 ? 1 : 4, cx, cy,
+				k, k));
+
+			obs_source_frame_destroy(dst);
+		}
+
+		obs_source_frame_destroy(src);
+	}
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+static const char presets_cfg[] =
+	"SNES\n"
+	"\tleft:8, right:8, top:16, bottom:16, size:720x480, group:Nintendo\n"
+	"N64\n"
+	"\tleft:4, right:4, top:0, bottom:0, group:Nintendo\n"
+	"Genesis\n"
+	"\tleft:12, right:12, top:8, bottom:8, size:1920x1080\n"
+	"Broken\n"
+	"\tleft:, right:1\n"
+	"PS1\n"
+	"\tleft:1, right:2, top:3, bottom:4\n";
+
+
+static void test_cache_keys(void)
+{
+	static struct gdq_cache_entry *entries[100];
+	obs_source_t *targets[2] = {(obs_source_t *)&entries[0],
+		(obs_source_t *)&entries[1]};
+	struct gdq_cache_entry *entry;
+	struct gdq_cache_key key;
+	bool distinct = true;
+	bool found = true;
+
+	/* enough crops to make the table grow a few times */
+	for (int i = 0; i < 100; i++) {
+		gdq_cache_key_init(&key, "test", targets[i % 2]);
+		key.left = i;
+		entries[i] = gdq_cache_acquire(&key);
+	}
+
+	for (int i = 0; i < 100; i++) {
+		gdq_cache_key_init(&key, "test", targets[i % 2]);
+		key.left = i;
+		entry = gdq_cache_acquire(&key);
+		found = found && entry == entries[i];
+		distinct = distinct && (i == 0 || entries[i] != entries[i - 1]);
+		gdq_cache_release(entry);
+	}
+
+	CHECK(found);
+	CHECK(distinct);
+
+	/* differs only in a field after the crop */
+	gdq_cache_key_init(&key, "test", targets[0]);
+	key.flags = 1;
+	entry = gdq_cache_acquire(&key);
+	CHECK(entry != entries[0]);
+	gdq_cache_release(entry);
+
+	for (int i = 0; i < 100; i++)
+		gdq_cache_release(entries[i]);
+}
+
+
+static void test_presets_file(void)
+{
+	struct crop_rect rect = {0};
+	obs_properties_t *props = obs_properties_create();
+	obs_property_t *list = obs_properties_add_list(props, "list", "",
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+
+	CHECK(gdq_presets_find("SNES", &rect));
+	CHECK(rect_is(&rect, 8, 8, 16, 16));
+	CHECK(gdq_presets_find("PS1", &rect));
+	CHECK(rect_is(&rect, 1, 2, 3, 4));
+	CHECK(!gdq_presets_find("Broken", &rect));
+	CHECK(!gdq_presets_find("snes", &rect));
+
+	CHECK(gdq_presets_find_size(1920, 1080, &rect));
+	CHECK(rect_is(&rect, 12, 12, 8, 8));
+	CHECK(!gdq_presets_find_size(640, 480, &rect));
+
+	CHECK(gdq_presets_list_groups(list) == 1);
+	CHECK(strcmp(obs_property_list_item_string(list, 0), "Nintendo") == 0);
+
+	obs_property_list_clear(list);
+	CHECK(gdq_presets_list(list, "Nintendo", 0) == 2);
+	CHECK(obs_property_list_item_count(list) == 2);
+
+	obs_property_list_clear(list);
+	gdq_presets_list(list, "", 0);
+	CHECK(obs_property_list_item_count(list) == 2);
+
+	obs_property_list_clear(list);
+	CHECK(gdq_presets_list(list, "", 1) == 2);
+	CHECK(obs_property_list_item_count(list) == 0);
+
+	obs_properties_destroy(props);
+}
+
+
+static void test_presets_set(void)
+{
+	struct crop_rect rect = {5, 6, 7, 8};
+	char *saved;
+
+	CHECK(gdq_presets_set("Saturn", "Sega", &rect, 640, 480));
+	CHECK(gdq_presets_find_size(640, 480, &rect));
+	CHECK(rect_is(&rect, 5, 6, 7, 8));
+
+	/* changing a preset moves it and its size */
+	rect.left = 9;
+	CHECK(!gdq_presets_set("SNES", "Nintendo", &rect, 0, 0));
+	CHECK(gdq_presets_find("SNES", &rect));
+	CHECK(rect.left == 9);
+	CHECK(!gdq_presets_find_size(720, 480, &rect));
+
+	/* the size falls back to the preset that had it before */
+	rect.left = 10;
+	CHECK(gdq_presets_set("Sega CD", "Sega", &rect, 640, 480));
+	CHECK(gdq_presets_find_size(640, 480, &rect) && rect.left == 10);
+	CHECK(!gdq_presets_set("Sega CD", "Sega", &rect, 0, 0));
+	CHECK(gdq_presets_find_size(640, 480, &rect));
+	CHECK(rect_is(&rect, 5, 6, 7, 8));
+
+	/* the writer folds everything into the file when it stops */
+	gdq_presets_free();
+	saved = read_file("gdq-crop.cfg");
+	CHECK(saved && strstr(saved, "Saturn\n"));
+	CHECK(saved && strstr(saved, "size:640x480"));
+	CHECK(saved && strstr(saved, "group:Sega"));
+	bfree(saved);
+
+	gdq_presets_init();
+	CHECK(gdq_presets_find("Saturn", &rect));
+	CHECK(rect_is(&rect, 5, 6, 7, 8));
+	CHECK(gdq_presets_find("SNES", &rect));
+	CHECK(rect.left == 9);
+}
+
+
+/* Saves made before the file was first written, left in the journal by a
+ * crash, are loaded and folded into a new file. */
+static void test_presets_journal_only(void)
+{
+	struct crop_rect rect;
+	char *kept;
+	char *saved;
+
+	gdq_presets_free();
+	kept = read_file("gdq-crop.cfg");
+	remove_file("gdq-crop.cfg");
+	write_file("gdq-crop.journal",
+		"Dreamcast\n\tleft:6, right:7, top:8, bottom:9\n");
+
+	gdq_presets_init();
+	CHECK(gdq_presets_find("Dreamcast", &rect));
+	CHECK(rect_is(&rect, 6, 7, 8, 9));
+
+	gdq_presets_free();
+	saved = read_file("gdq-crop.cfg");
+	CHECK(saved && strstr(saved, "Dreamcast\n"));
+	bfree(saved);
+
+	write_file("gdq-crop.cfg", kept ? kept : "");
+	remove_file("gdq-crop.journal");
+	bfree(kept);
+	gdq_presets_init();
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+static obs_source_t *create_input(const char *name, uint32_t width,
+	uint32_t height)
+{
+	obs_data_t *settings = obs_data_create();
+	obs_source_t *input;
+
+	obs_data_set_int(settings, "width", width);
+	obs_data_set_int(settings, "height", height);
+	input = obs_source_create(STUB_INPUT_ID, name, settings, NULL);
+	obs_data_release(settings);
+
+	return input;
+}
+
+
+static void resize_input(obs_source_t *input, uint32_t width,
+	uint32_t height)
+{
+	obs_data_t *settings = obs_data_create();
+
+	obs_data_set_int(settings, "width", width);
+	obs_data_set_int(settings, "height", height);
+	obs_source_update(input, settings);
+	obs_data_release(settings);
+}
+
+
+static obs_source_t *add_filter(obs_source_t *input, const char *id,
+	const char *name, obs_data_t *settings)
+{
+	obs_source_t *filter = obs_source_create(id, name, settings, NULL);
+
+	obs_source_filter_add(input, filter);
+	obs_source_release(filter);
+	return filter;
+}
+
+
+static obs_data_t *crop_settings(int left, int right, int top, int bottom)
+{
+	obs_data_t *settings = obs_data_create();
+
+	obs_data_set_int(settings, "left", left);
+	obs_data_set_int(settings, "right", right);
+	obs_data_set_int(settings, "top", top);
+	obs_data_set_int(settings, "bottom", bottom);
+	return settings;
+}
+
+
+static void test_filter_chain(void)
+{
+	obs_source_t *input = create_input("chain", 720, 480);
+	obs_data_t *settings = crop_settings(8, 8, 4, 4);
+	obs_source_t *crop = add_filter(input, "gdq_crop_console_filter",
+		"crop", settings);
+	long draws;
+
+	obs_data_release(settings);
+
+	/* the settings land in the first tick */
+	stub_video_tick(1.0f / 60.0f);
+	CHECK(obs_source_get_width(input) == 704);
+	CHECK(obs_source_get_height(input) == 472);
+
+	settings = obs_data_create();
+	obs_data_set_string(settings, "resolution", "4:3");
+	add_filter(input, "gdq_scale_filter", "scale", settings);
+	obs_data_release(settings);
+
+	stub_video_tick(1.0f / 60.0f);
+	CHECK(obs_source_get_width(input) == 704);
+	CHECK(obs_source_get_height(input) == 528);
+
+	/* a new input size goes through both */
+	resize_input(input, 800, 600);
+	stub_video_tick(1.0f / 60.0f);
+	CHECK(obs_source_get_base_width(crop) == 784);
+	CHECK(obs_source_get_width(input) == 789);
+	CHECK(obs_source_get_height(input) == 592);
+
+	draws = stub_record.draws;
+	obs_source_video_render(input);
+	CHECK(stub_record.draws > draws);
+
+	/* cropping everything away makes the crop skip itself */
+	settings = crop_settings(400, 400, 0, 0);
+	obs_source_update(crop, settings);
+	obs_data_release(settings);
+	stub_video_tick(1.0f / 60.0f);
+	CHECK(obs_source_get_base_width(crop) == 0);
+
+	obs_source_release(input);
+}
+
+
+static void test_match_size(void)
+{
+	obs_source_t *input = create_input("match", 720, 480);
+	obs_data_t *settings = crop_settings(1, 1, 1, 1);
+	obs_source_t *crop = add_filter(input, "gdq_crop_console_filter",
+		"crop", settings);
+	struct crop_rect saved = {2, 2, 2, 2};
+
+	obs_data_release(settings);
+	gdq_presets_set("Small", "", &saved, 320, 240);
+
+	/* the first size is what the settings were made for */
+	stub_video_tick(1.0f / 60.0f);
+	CHECK(obs_source_get_base_width(crop) == 718);
+
+	resize_input(input, 320, 240);
+	stub_video_tick(1.0f / 60.0f);
+	stub_video_tick(1.0f / 60.0f);
+	CHECK(obs_source_get_base_width(crop) == 316);
+
+	settings = obs_source_get_settings(crop);
+	CHECK(obs_data_get_int(settings, "left") == 2);
+	CHECK(obs_data_get_int(settings, "bottom") == 2);
+	obs_data_release(settings);
+
+	/* switched off, a size with a preset changes nothing */
+	settings = obs_data_create();
+	obs_data_set_bool(settings, "match_size", false);
+	obs_source_update(crop, settings);
+	obs_data_release(settings);
+	resize_input(input, 720, 480);
+	stub_video_tick(1.0f / 60.0f);
+	resize_input(input, 320, 240);
+	stub_video_tick(1.0f / 60.0f);
+	CHECK(obs_source_get_base_width(crop) == 316);
+
+	obs_source_release(input);
+}
+
+
+static void test_properties(void)
+{
+	obs_source_t *input = create_input("props", 720, 480);
+	obs_data_t *settings = crop_settings(3, 4, 5, 6);
+	obs_source_t *crop = add_filter(input, "gdq_crop_console_filter",
+		"crop", settings);
+	obs_properties_t *props;
+	obs_property_t *p;
+	struct crop_rect rect;
+	bool listed = false;
+
+	obs_data_release(settings);
+	stub_video_tick(1.0f / 60.0f);
+
+	props = obs_source_properties(crop);
+	CHECK(props != NULL);
+
+	p = obs_properties_get(props, "console");
+	for (size_t i = 0; i < obs_property_list_item_count(p); i++)
+		listed = listed || strcmp(obs_property_list_item_string(p, i),
+			"PS1") == 0;
+	CHECK(listed);
+	CHECK(obs_property_visible(obs_properties_get(props,
+		"console_group")));
+
+	/* saving a preset from the dialog */
+	settings = obs_source_get_settings(crop);
+	obs_data_set_string(settings, "newconsole", "Dialog");
+	CHECK(obs_property_button_clicked(obs_properties_get(props,
+		"newbutton"), obs_properties_get_param(props)));
+	CHECK(strcmp(obs_data_get_string(settings, "console"), "Dialog") == 0);
+	obs_data_release(settings);
+
+	CHECK(gdq_presets_find("Dialog", &rect));
+	CHECK(rect_is(&rect, 3, 4, 5, 6));
+
+	obs_properties_destroy(props);
+	obs_source_release(input);
+}
+
+
+static void test_properties_pages(void)
+{
+	obs_source_t *input = create_input("pages", 720, 480);
+	obs_data_t *settings = crop_settings(1, 1, 1, 1);
+	struct crop_rect rect = {1, 1, 1, 1};
+	obs_source_t *crop;
+	obs_properties_t *props;
+	obs_property_t *pages;
+	obs_property_t *list;
+	struct dstr name = {0};
+
+	for (int i = 0; i < GDQ_PRESETS_PAGE + 50; i++) {
+		dstr_printf(&name, "Paged %d", i);
+		gdq_presets_set(name.array, "Paged", &rect, 0, 0);
+	}
+
+	obs_data_set_string(settings, "console_group", "Paged");
+	crop = add_filter(input, "gdq_crop_console_filter", "crop", settings);
+	obs_data_release(settings);
+	stub_video_tick(1.0f / 60.0f);
+
+	/* the first page, and the chosen preset from the second */
+	settings = obs_source_get_settings(crop);
+	obs_data_set_string(settings, "console", "Paged 120");
+	obs_data_release(settings);
+	props = obs_source_properties(crop);
+	pages = obs_properties_get(props, "console_page");
+	list = obs_properties_get(props, "console");
+	CHECK(obs_property_visible(pages));
+	CHECK(obs_property_list_item_count(pages) == 2);
+	CHECK(obs_property_list_item_count(list) == 3 + 1 + GDQ_PRESETS_PAGE);
+	CHECK(strcmp(obs_property_list_item_string(list, 3), "Paged 120") == 0);
+
+	settings = obs_source_get_settings(crop);
+	obs_data_set_int(settings, "console_page", 1);
+	obs_property_modified(pages, settings);
+	CHECK(obs_property_list_item_count(list) == 3 + 50);
+
+	/* a group that fits a page has no pages to pick */
+	obs_data_set_string(settings, "console_group", "Nintendo");
+	obs_property_modified(obs_properties_get(props, "console_group"),
+		settings);
+	CHECK(!obs_property_visible(pages));
+	CHECK(obs_data_get_int(settings, "console_page") == 0);
+	CHECK(obs_property_list_item_count(list) == 3 + 1 + 2);
+	obs_data_release(settings);
+
+	obs_properties_destroy(props);
+	obs_source_release(input);
+	dstr_free(&name);
+}
+
+
+/* Outputs a BGRA frame with value inside the crop and 0 outside. */
+static void output_frame(obs_source_t *input, uint32_t width,
+	uint32_t height, const struct crop_rect *crop, uint8_t value)
+{
+	struct obs_source_frame *frame =
+		obs_source_frame_create(VIDEO_FORMAT_BGRA, width, height);
+
+	for (uint32_t y = (uint32_t)crop->top;
+		y < height - (uint32_t)crop->bottom; y++)
+		memset(frame->data[0] + (size_t)y * frame->linesize[0] +
+			(size_t)crop->left * 4, value,
+			(width - (uint32_t)(crop->left + crop->right)) * 4);
+
+	obs_source_output_video(input, frame);
+	obs_source_frame_destroy(frame);
+}
+
+
+/* The usual chain of a crop, done on the CPU, and then a scale: the scale
+ * pre-scales the crop's view of the frame. */
+static void test_crop_then_prescale(void)
+{
+	obs_source_t *input = obs_source_create(STUB_ASYNC_INPUT_ID, "async",
+		NULL, NULL);
+	struct crop_rect crop = {320, 320, 0, 0};
+	obs_data_t *settings = crop_settings(crop.left, crop.right, crop.top,
+		crop.bottom);
+	obs_source_t *crop_filter;
+	const struct obs_source_frame *seen;
+	bool inside = true;
+
+	obs_data_set_bool(settings, "cpu_crop", true);
+	crop_filter = add_filter(input, "gdq_crop_console_filter", "crop",
+		settings);
+	obs_data_release(settings);
+
+	settings = obs_data_create();
+	obs_data_set_string(settings, "resolution", "640x480");
+	obs_data_set_bool(settings, "cpu_prescale", true);
+	add_filter(input, "gdq_scale_filter", "scale", settings);
+	obs_data_release(settings);
+
+	/* the filters take their settings in the first tick */
+	stub_video_tick(1.0f / 60.0f);
+
+	output_frame(input, 2560, 1440, &crop, 200);
+	stub_video_tick(1.0f / 60.0f);
+	output_frame(input, 2560, 1440, &crop, 200);
+	stub_video_tick(1.0f / 60.0f);
+
+	/* 1920x1440 left after the crop, a third of it uploaded */
+	CHECK(obs_source_get_base_width(input) == 640);
+	CHECK(obs_source_get_base_height(input) == 480);
+	CHECK(obs_source_get_base_width(crop_filter) == 640);
+	CHECK(obs_source_get_width(input) == 640);
+	CHECK(obs_source_get_height(input) == 480);
+
+	/* the borders were cut off before the box filter saw them */
+	seen = stub_async_frame(input);
+	CHECK(seen && seen->width == 640 && seen->height == 480);
+	for (uint32_t y = 0; seen && y < seen->height; y++)
+		for (uint32_t x = 0; x < seen->width * 4; x++)
+			inside = inside &&
+				seen->data[0][y * seen->linesize[0] + x] == 200;
+	CHECK(inside);
+
+	obs_source_release(input);
+}
+
+
+static void test_prescale_benchmark(void)
+{
+	obs_source_t *input = create_input("benchmark", 720, 480);
+	obs_data_t *settings = obs_data_create();
+	long updates = os_atomic_load_long(&stub_record.property_updates);
+	obs_source_t *scale;
+	obs_properties_t *props;
+	obs_property_t *p;
+
+	obs_data_set_string(settings, "resolution", "640x360");
+	obs_data_set_bool(settings, "cpu_prescale", true);
+	scale = add_filter(input, "gdq_scale_filter", "scale", settings);
+	obs_data_release(settings);
+	stub_video_tick(1.0f / 60.0f);
+
+	props = obs_source_properties(scale);
+	CHECK(obs_properties_get(props, "cpu_prescale_result") == NULL);
+	CHECK(obs_property_button_clicked(obs_properties_get(props,
+		"cpu_prescale_benchmark"), obs_obj_get_data(scale)));
+	obs_properties_destroy(props);
+
+	/* runs on its own thread and refreshes the properties when done */
+	for (int i = 0; i < 1000 &&
+		os_atomic_load_long(&stub_record.property_updates) == updates;
+		i++)
+		os_sleep_ms(10);
+	CHECK(os_atomic_load_long(&stub_record.property_updates) ==
+		updates + 1);
+
+	props = obs_source_properties(scale);
+	p = obs_properties_get(props, "cpu_prescale_result");
+	CHECK(p && strstr(obs_property_description(p), "3840x2160 to 640x360"));
+	obs_properties_destroy(props);
+
+	/* shown, not saved */
+	settings = obs_source_get_settings(scale);
+	CHECK(!*obs_data_get_string(settings, "cpu_prescale_result"));
+	obs_data_release(settings);
+
+	obs_source_release(input);
+}
+
+
+static void test_stats_proc(void)
+{
+	obs_source_t *input = create_input("stats", 720, 480);
+	obs_data_t *settings = obs_data_create();
+	obs_source_t *region;
+	calldata_t cd;
+	const char *json;
+
+	add_filter(input, "gdq_crop_console_filter", "counted", NULL);
+	add_filter(input, "gdq_crop_scale_filter", "scaled", NULL);
+
+	/* not a filter, so it has no parent */
+	obs_data_set_string(settings, "source", "stats");
+	region = obs_source_create("gdq_crop_region_source", "region",
+		settings, NULL);
+	obs_data_release(settings);
+
+	stub_video_tick(1.0f / 60.0f);
+	obs_source_video_render(input);
+	obs_source_video_render(region);
+
+	calldata_init(&cd);
+	CHECK(proc_handler_call(obs_get_proc_handler(), "gdq_get_stats", &cd));
+	json = calldata_string(&cd, "json");
+	CHECK(json && strstr(json, "\"filter\":\"counted\""));
+	CHECK(json && strstr(json, "\"filter\":\"scaled\""));
+	CHECK(json && strstr(json, "\"source\":\"stats\""));
+	CHECK(json && strstr(json, "\"source\":\"region\""));
+	CHECK(json && strstr(json, "\"kind\":\"gdq_crop_region_source\""));
+	CHECK(json && strstr(json, "\"totals\":{"));
+	calldata_free(&cd);
+
+	obs_source_release(region);
+	obs_source_release(input);
+}
+
+
+int main(void)
+{
+	long allocs;
+
+	if (!mkdtemp(config_dir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+
+	allocs = bnum_allocs();
+	stub_startup(GDQ_DATA_DIR, config_dir);
+
+	test_calc_crop();
+	test_aspects();
+	test_scale_size();
+	test_autocrop_detect();
+	test_prescale();
+	test_cache_keys();
+
+	write_file("gdq-crop.cfg", presets_cfg);
+	obs_module_load();
+
+	test_presets_file();
+	test_presets_set();
+	test_presets_journal_only();
+	test_filter_chain();
+	test_match_size();
+	test_properties();
+	test_properties_pages();
+	test_crop_then_prescale();
+	test_prescale_benchmark();
+	test_stats_proc();
+
+	obs_module_unload();
+	CHECK(stub_record.resources == 0);
+
+	stub_shutdown();
+	CHECK(bnum_allocs() == allocs);
+
+	remove_file("gdq-crop.cfg");
+	remove_file("gdq-crop.journal");
+	rmdir(config_dir);
+
+	printf("%d checks, %d failed\n", checks, failures);
+	return failures ? 1 : 0;
+}
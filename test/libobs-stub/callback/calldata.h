@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string.h>
+#include "../util/c99defs.h"
+
+/* A list of named values instead of libobs' packed stack; the accessors
+ * are the same. */
+
+struct calldata_item;
+
+typedef struct calldata {
+	struct calldata_item           *items;
+	size_t                         num;
+	size_t                         capacity;
+} calldata_t;
+
+static inline void calldata_init(calldata_t *data)
+{
+	memset(data, 0, sizeof(*data));
+}
+
+extern void calldata_free(calldata_t *data);
+
+extern void calldata_set_int(calldata_t *data, const char *name,
+	long long val);
+extern void calldata_set_string(calldata_t *data, const char *name,
+	const char *str);
+
+extern long long calldata_int(const calldata_t *data, const char *name);
+extern const char *calldata_string(const calldata_t *data, const char *name);
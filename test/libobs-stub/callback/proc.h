@@ -0,0 +1,17 @@
+#pragma once
+
+#include "calldata.h"
+
+struct proc_handler;
+typedef struct proc_handler proc_handler_t;
+
+typedef void (*proc_handler_proc_t)(void *, calldata_t *);
+
+extern proc_handler_t *proc_handler_create(void);
+extern void proc_handler_destroy(proc_handler_t *handler);
+
+/* only the name is taken from decl_string, the parameters are not checked */
+extern void proc_handler_add(proc_handler_t *handler, const char *decl_string,
+	proc_handler_proc_t proc, void *data);
+extern bool proc_handler_call(proc_handler_t *handler, const char *name,
+	calldata_t *params);
@@ -0,0 +1,523 @@
+#include <stdio.h>
+#include <string.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/threading.h>
+#include "obs-stub.h"
+
+/*
+ * Settings objects: named values with a user value and a default each,
+ * reference counted like libobs'.  Lookups are linear, which is fine for
+ * the few keys a filter has.  JSON can be written, for the procs that
+ * return it, but not read back.
+ */
+
+enum data_type {
+	DATA_NONE,
+	DATA_STRING,
+	DATA_INT,
+	DATA_DOUBLE,
+	DATA_BOOL,
+	DATA_OBJ,
+	DATA_ARRAY
+};
+
+struct data_value {
+	enum data_type                 type;
+	union {
+		char                   *str;
+		long long              i;
+		double                 d;
+		bool                   b;
+		obs_data_t             *obj;
+		obs_data_array_t       *array;
+	};
+};
+
+struct data_item {
+	char                           *name;
+	struct data_value              user;
+	struct data_value              def;
+};
+
+struct obs_data {
+	volatile long                  refs;
+	DARRAY(struct data_item)       items;
+	char                           *json;
+};
+
+struct obs_data_array {
+	volatile long                  refs;
+	DARRAY(obs_data_t *)           objs;
+};
+
+
+static void value_clear(struct data_value *value)
+{
+	switch (value->type) {
+	case DATA_STRING: bfree(value->str); break;
+	case DATA_OBJ:    obs_data_release(value->obj); break;
+	case DATA_ARRAY:  obs_data_array_release(value->array); break;
+	default:          break;
+	}
+
+	memset(value, 0, sizeof(*value));
+}
+
+
+/* src may point into the value being replaced, so it is copied first. */
+static void value_copy(struct data_value *dst, const struct data_value *src)
+{
+	struct data_value copy = *src;
+
+	switch (src->type) {
+	case DATA_STRING: copy.str = bstrdup(src->str); break;
+	case DATA_OBJ:    obs_data_addref(src->obj); break;
+	case DATA_ARRAY:  os_atomic_inc_long(&src->array->refs); break;
+	default:          break;
+	}
+
+	value_clear(dst);
+	*dst = copy;
+}
+
+
+obs_data_t *obs_data_create(void)
+{
+	struct obs_data *data = bzalloc(sizeof(*data));
+
+	data->refs = 1;
+	return data;
+}
+
+
+/* Not supported; callers get what libobs returns for invalid JSON. */
+obs_data_t *obs_data_create_from_json(const char *json_string)
+{
+	UNUSED_PARAMETER(json_string);
+	blog(LOG_WARNING, "obs_data_create_from_json: not supported by the stub");
+	return NULL;
+}
+
+
+void obs_data_addref(obs_data_t *data)
+{
+	if (data)
+		os_atomic_inc_long(&data->refs);
+}
+
+
+void obs_data_release(obs_data_t *data)
+{
+	if (!data || os_atomic_dec_long(&data->refs) != 0)
+		return;
+
+	for (size_t i = 0; i < data->items.num; i++) {
+		struct data_item *item = &data->items.array[i];
+
+		value_clear(&item->user);
+		value_clear(&item->def);
+		bfree(item->name);
+	}
+
+	da_free(data->items);
+	bfree(data->json);
+	bfree(data);
+}
+
+
+static struct data_item *data_find(obs_data_t *data, const char *name)
+{
+	if (!data || !name)
+		return NULL;
+
+	for (size_t i = 0; i < data->items.num; i++)
+		if (strcmp(data->items.array[i].name, name) == 0)
+			return &data->items.array[i];
+
+	return NULL;
+}
+
+
+static struct data_item *data_get_item(obs_data_t *data, const char *name)
+{
+	struct data_item *item = data_find(data, name);
+
+	if (!item && data && name) {
+		item = da_push_back_new(data->items);
+		item->name = bstrdup(name);
+	}
+
+	return item;
+}
+
+
+/* The user value if there is one, else the default. */
+static const struct data_value *data_get(obs_data_t *data, const char *name,
+	enum data_type type)
+{
+	struct data_item *item = data_find(data, name);
+
+	if (!item)
+		return NULL;
+	if (item->user.type == type)
+		return &item->user;
+	if (item->def.type == type)
+		return &item->def;
+	return NULL;
+}
+
+
+static void data_set(obs_data_t *data, const char *name, bool def,
+	const struct data_value *value)
+{
+	struct data_item *item = data_get_item(data, name);
+
+	if (item)
+		value_copy(def ? &item->def : &item->user, value);
+}
+
+
+/* Copies the user values of apply_data over those of target. */
+void obs_data_apply(obs_data_t *target, obs_data_t *apply_data)
+{
+	if (!target || !apply_data || target == apply_data)
+		return;
+
+	for (size_t i = 0; i < apply_data->items.num; i++) {
+		struct data_item *item = &apply_data->items.array[i];
+
+		if (item->user.type != DATA_NONE)
+			data_set(target, item->name, false, &item->user);
+	}
+}
+
+
+bool obs_data_has_user_value(obs_data_t *data, const char *name)
+{
+	struct data_item *item = data_find(data, name);
+
+	return item && item->user.type != DATA_NONE;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+void obs_data_set_string(obs_data_t *data, const char *name, const char *val)
+{
+	struct data_value value = {.type = DATA_STRING};
+
+	value.str = (char *)(val ? val : "");
+	data_set(data, name, false, &value);
+}
+
+
+void obs_data_set_int(obs_data_t *data, const char *name, long long val)
+{
+	struct data_value value = {.type = DATA_INT};
+
+	value.i = val;
+	data_set(data, name, false, &value);
+}
+
+
+void obs_data_set_double(obs_data_t *data, const char *name, double val)
+{
+	struct data_value value = {.type = DATA_DOUBLE};
+
+	value.d = val;
+	data_set(data, name, false, &value);
+}
+
+
+void obs_data_set_bool(obs_data_t *data, const char *name, bool val)
+{
+	struct data_value value = {.type = DATA_BOOL};
+
+	value.b = val;
+	data_set(data, name, false, &value);
+}
+
+
+void obs_data_set_obj(obs_data_t *data, const char *name, obs_data_t *obj)
+{
+	struct data_value value = {.type = DATA_OBJ};
+
+	if (!obj)
+		return;
+
+	value.obj = obj;
+	data_set(data, name, false, &value);
+}
+
+
+void obs_data_set_array(obs_data_t *data, const char *name,
+	obs_data_array_t *array)
+{
+	struct data_value value = {.type = DATA_ARRAY};
+
+	if (!array)
+		return;
+
+	value.array = array;
+	data_set(data, name, false, &value);
+}
+
+
+void obs_data_set_default_string(obs_data_t *data, const char *name,
+	const char *val)
+{
+	struct data_value value = {.type = DATA_STRING};
+
+	value.str = (char *)(val ? val : "");
+	data_set(data, name, true, &value);
+}
+
+
+void obs_data_set_default_int(obs_data_t *data, const char *name,
+	long long val)
+{
+	struct data_value value = {.type = DATA_INT};
+
+	value.i = val;
+	data_set(data, name, true, &value);
+}
+
+
+void obs_data_set_default_double(obs_data_t *data, const char *name,
+	double val)
+{
+	struct data_value value = {.type = DATA_DOUBLE};
+
+	value.d = val;
+	data_set(data, name, true, &value);
+}
+
+
+void obs_data_set_default_bool(obs_data_t *data, const char *name, bool val)
+{
+	struct data_value value = {.type = DATA_BOOL};
+
+	value.b = val;
+	data_set(data, name, true, &value);
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+const char *obs_data_get_string(obs_data_t *data, const char *name)
+{
+	const struct data_value *value = data_get(data, name, DATA_STRING);
+
+	return value ? value->str : "";
+}
+
+
+/* Numbers convert between int and double, as in libobs. */
+long long obs_data_get_int(obs_data_t *data, const char *name)
+{
+	const struct data_value *value = data_get(data, name, DATA_INT);
+
+	if (value)
+		return value->i;
+
+	value = data_get(data, name, DATA_DOUBLE);
+	return value ? (long long)value->d : 0;
+}
+
+
+double obs_data_get_double(obs_data_t *data, const char *name)
+{
+	const struct data_value *value = data_get(data, name, DATA_DOUBLE);
+
+	if (value)
+		return value->d;
+
+	value = data_get(data, name, DATA_INT);
+	return value ? (double)value->i : 0.0;
+}
+
+
+bool obs_data_get_bool(obs_data_t *data, const char *name)
+{
+	const struct data_value *value = data_get(data, name, DATA_BOOL);
+
+	return value ? value->b : false;
+}
+
+
+obs_data_t *obs_data_get_obj(obs_data_t *data, const char *name)
+{
+	const struct data_value *value = data_get(data, name, DATA_OBJ);
+
+	if (!value)
+		return NULL;
+
+	obs_data_addref(value->obj);
+	return value->obj;
+}
+
+
+obs_data_array_t *obs_data_get_array(obs_data_t *data, const char *name)
+{
+	const struct data_value *value = data_get(data, name, DATA_ARRAY);
+
+	if (!value)
+		return NULL;
+
+	os_atomic_inc_long(&value->array->refs);
+	return value->array;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+obs_data_array_t *obs_data_array_create(void)
+{
+	struct obs_data_array *array = bzalloc(sizeof(*array));
+
+	array->refs = 1;
+	return array;
+}
+
+
+void obs_data_array_release(obs_data_array_t *array)
+{
+	if (!array || os_atomic_dec_long(&array->refs) != 0)
+		return;
+
+	for (size_t i = 0; i < array->objs.num; i++)
+		obs_data_release(array->objs.array[i]);
+
+	da_free(array->objs);
+	bfree(array);
+}
+
+
+size_t obs_data_array_count(obs_data_array_t *array)
+{
+	return array ? array->objs.num : 0;
+}
+
+
+obs_data_t *obs_data_array_item(obs_data_array_t *array, size_t idx)
+{
+	obs_data_t *data;
+
+	if (!array || idx >= array->objs.num)
+		return NULL;
+
+	data = array->objs.array[idx];
+	obs_data_addref(data);
+	return data;
+}
+
+
+size_t obs_data_array_push_back(obs_data_array_t *array, obs_data_t *obj)
+{
+	if (!array || !obj)
+		return 0;
+
+	obs_data_addref(obj);
+	return da_push_back(array->objs, &obj);
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+static void json_string(struct dstr *json, const char *str)
+{
+	dstr_cat_ch(json, '"');
+
+	for (const char *p = str; *p; p++) {
+		if (*p == '"' || *p == '\\') {
+			dstr_cat_ch(json, '\\');
+			dstr_cat_ch(json, *p);
+		} else if ((unsigned char)*p < 0x20) {
+			dstr_catf(json, "\\u%04x", (unsigned char)*p);
+		} else {
+			dstr_cat_ch(json, *p);
+		}
+	}
+
+	dstr_cat_ch(json, '"');
+}
+
+
+static void json_object(struct dstr *json, obs_data_t *data);
+
+
+static void json_value(struct dstr *json, const struct data_value *value)
+{
+	switch (value->type) {
+	case DATA_STRING:
+		json_string(json, value->str);
+		break;
+	case DATA_INT:
+		dstr_catf(json, "%lld", value->i);
+		break;
+	case DATA_DOUBLE:
+		dstr_catf(json, "%.17g", value->d);
+		break;
+	case DATA_BOOL:
+		dstr_cat(json, value->b ? "true" : "false");
+		break;
+	case DATA_OBJ:
+		json_object(json, value->obj);
+		break;
+	case DATA_ARRAY:
+		dstr_cat_ch(json, '[');
+		for (size_t i = 0; i < value->array->objs.num; i++) {
+			if (i)
+				dstr_cat_ch(json, ',');
+			json_object(json, value->array->objs.array[i]);
+		}
+		dstr_cat_ch(json, ']');
+		break;
+	default:
+		dstr_cat(json, "null");
+		break;
+	}
+}
+
+
+/* Only user values are written, as libobs does. */
+static void json_object(struct dstr *json, obs_data_t *data)
+{
+	bool first = true;
+
+	dstr_cat_ch(json, '{');
+
+	for (size_t i = 0; i < data->items.num; i++) {
+		struct data_item *item = &data->items.array[i];
+
+		if (item->user.type == DATA_NONE)
+			continue;
+
+		if (!first)
+			dstr_cat_ch(json, ',');
+		first = false;
+
+		json_string(json, item->name);
+		dstr_cat_ch(json, ':');
+		json_value(json, &item->user);
+	}
+
+	dstr_cat_ch(json, '}');
+}
+
+
+/* Valid until the next call on the same object. */
+const char *obs_data_get_json(obs_data_t *data)
+{
+	struct dstr json = {0};
+
+	if (!data)
+		return NULL;
+
+	json_object(&json, data);
+
+	bfree(data->json);
+	data->json = json.array;
+	return data->json;
+}
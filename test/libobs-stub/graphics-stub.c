@@ -0,0 +1,497 @@
+#include <string.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include "obs-stub.h"
+
+/*
+ * The graphics subsystem without a GPU.  Effects, textures, render targets
+ * and samplers are bookkeeping objects that remember their size; every one
+ * alive is counted in stub_record.resources so tests can check that
+ * nothing leaks.  Draws are counted and otherwise dropped.  Stage surfaces
+ * never map and timer queries do not exist, as on a renderer without
+ * readback or timestamp support.
+ */
+
+#define EFFECT_PARAMS                   16
+
+struct gs_effect_param {
+	char                           name[32];
+};
+
+struct gs_effect {
+	struct gs_effect_param         params[EFFECT_PARAMS];
+	size_t                         num_params;
+	bool                           looping;
+	bool                           base;
+};
+
+struct gs_texture {
+	uint32_t                       width;
+	uint32_t                       height;
+	enum gs_color_format           format;
+};
+
+struct gs_texture_render {
+	struct gs_texture              texture;
+	bool                           rendered;
+};
+
+struct gs_stage_surface {
+	uint32_t                       width;
+	uint32_t                       height;
+};
+
+struct gs_sampler_state {
+	struct gs_sampler_info         info;
+};
+
+static struct gs_effect base_effects[OBS_EFFECT_AREA + 1];
+
+static pthread_mutex_t graphics_mutex;
+static pthread_once_t graphics_once = PTHREAD_ONCE_INIT;
+
+
+static void *resource_create(size_t size)
+{
+	os_atomic_inc_long(&stub_record.resources);
+	return bzalloc(size);
+}
+
+
+static void resource_destroy(void *resource)
+{
+	if (resource) {
+		os_atomic_dec_long(&stub_record.resources);
+		bfree(resource);
+	}
+}
+
+
+static void graphics_mutex_init(void)
+{
+	pthread_mutexattr_t attr;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&graphics_mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+
+	for (size_t i = 0; i <= OBS_EFFECT_AREA; i++)
+		base_effects[i].base = true;
+}
+
+
+/* Recursive, like the libobs graphics lock. */
+void obs_enter_graphics(void)
+{
+	pthread_once(&graphics_once, graphics_mutex_init);
+	pthread_mutex_lock(&graphics_mutex);
+}
+
+
+void obs_leave_graphics(void)
+{
+	pthread_mutex_unlock(&graphics_mutex);
+}
+
+
+gs_effect_t *obs_get_base_effect(enum obs_base_effect effect)
+{
+	pthread_once(&graphics_once, graphics_mutex_init);
+	return effect <= OBS_EFFECT_AREA ? &base_effects[effect] : NULL;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+/* The file has to exist, it is not compiled. */
+gs_effect_t *gs_effect_create_from_file(const char *file, char **error_string)
+{
+	if (error_string)
+		*error_string = NULL;
+
+	if (!os_file_exists(file))
+		return NULL;
+
+	return resource_create(sizeof(struct gs_effect));
+}
+
+
+void gs_effect_destroy(gs_effect_t *effect)
+{
+	if (effect && !effect->base)
+		resource_destroy(effect);
+}
+
+
+/* Every name is a parameter; the same name gives the same handle. */
+gs_eparam_t *gs_effect_get_param_by_name(const gs_effect_t *effect,
+	const char *name)
+{
+	gs_effect_t *e = (gs_effect_t *)effect;
+
+	if (!e || !name)
+		return NULL;
+
+	for (size_t i = 0; i < e->num_params; i++)
+		if (strcmp(e->params[i].name, name) == 0)
+			return &e->params[i];
+
+	if (e->num_params == EFFECT_PARAMS)
+		return NULL;
+
+	strncpy(e->params[e->num_params].name, name,
+		sizeof(e->params[0].name) - 1);
+	return &e->params[e->num_params++];
+}
+
+
+/* One pass per technique. */
+bool gs_effect_loop(gs_effect_t *effect, const char *name)
+{
+	UNUSED_PARAMETER(name);
+
+	if (!effect)
+		return false;
+
+	effect->looping = !effect->looping;
+	return effect->looping;
+}
+
+
+void gs_effect_set_float(gs_eparam_t *param, float val)
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(val);
+}
+
+
+void gs_effect_set_vec2(gs_eparam_t *param, const struct vec2 *val)
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(val);
+}
+
+
+void gs_effect_set_texture(gs_eparam_t *param, gs_texture_t *val)
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(val);
+}
+
+
+void gs_effect_set_next_sampler(gs_eparam_t *param,
+	gs_samplerstate_t *sampler)
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(sampler);
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+gs_samplerstate_t *gs_samplerstate_create(const struct gs_sampler_info *info)
+{
+	struct gs_sampler_state *sampler =
+		resource_create(sizeof(struct gs_sampler_state));
+
+	sampler->info = *info;
+	return sampler;
+}
+
+
+void gs_samplerstate_destroy(gs_samplerstate_t *samplerstate)
+{
+	resource_destroy(samplerstate);
+}
+
+
+gs_texture_t *gs_texture_create(uint32_t width, uint32_t height,
+	enum gs_color_format color_format, uint32_t levels,
+	const uint8_t **data, uint32_t flags)
+{
+	struct gs_texture *tex;
+
+	if (!width || !height)
+		return NULL;
+
+	tex = resource_create(sizeof(struct gs_texture));
+	tex->width = width;
+	tex->height = height;
+	tex->format = color_format;
+
+	UNUSED_PARAMETER(levels);
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(flags);
+	return tex;
+}
+
+
+void gs_texture_destroy(gs_texture_t *tex)
+{
+	resource_destroy(tex);
+}
+
+
+void gs_texture_set_image(gs_texture_t *tex, const uint8_t *data,
+	uint32_t linesize, bool invert)
+{
+	UNUSED_PARAMETER(tex);
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(linesize);
+	UNUSED_PARAMETER(invert);
+}
+
+
+uint32_t gs_texture_get_width(const gs_texture_t *tex)
+{
+	return tex ? tex->width : 0;
+}
+
+
+uint32_t gs_texture_get_height(const gs_texture_t *tex)
+{
+	return tex ? tex->height : 0;
+}
+
+
+gs_texrender_t *gs_texrender_create(enum gs_color_format format,
+	enum gs_zstencil_format zsformat)
+{
+	struct gs_texture_render *texrender =
+		resource_create(sizeof(struct gs_texture_render));
+
+	texrender->texture.format = format;
+	UNUSED_PARAMETER(zsformat);
+	return texrender;
+}
+
+
+void gs_texrender_destroy(gs_texrender_t *texrender)
+{
+	resource_destroy(texrender);
+}
+
+
+/* Takes the size of the first begin until a reset, as libobs does. */
+bool gs_texrender_begin(gs_texrender_t *texrender, uint32_t cx, uint32_t cy)
+{
+	if (!texrender || !cx || !cy || texrender->rendered)
+		return false;
+
+	texrender->texture.width = cx;
+	texrender->texture.height = cy;
+	return true;
+}
+
+
+void gs_texrender_end(gs_texrender_t *texrender)
+{
+	if (texrender)
+		texrender->rendered = true;
+}
+
+
+void gs_texrender_reset(gs_texrender_t *texrender)
+{
+	if (texrender)
+		texrender->rendered = false;
+}
+
+
+gs_texture_t *gs_texrender_get_texture(const gs_texrender_t *texrender)
+{
+	return texrender && texrender->texture.width ?
+		(gs_texture_t *)&texrender->texture : NULL;
+}
+
+
+gs_stagesurf_t *gs_stagesurface_create(uint32_t width, uint32_t height,
+	enum gs_color_format color_format)
+{
+	struct gs_stage_surface *surface =
+		resource_create(sizeof(struct gs_stage_surface));
+
+	surface->width = width;
+	surface->height = height;
+	UNUSED_PARAMETER(color_format);
+	return surface;
+}
+
+
+void gs_stagesurface_destroy(gs_stagesurf_t *stagesurf)
+{
+	resource_destroy(stagesurf);
+}
+
+
+bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
+	uint32_t *linesize)
+{
+	UNUSED_PARAMETER(stagesurf);
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(linesize);
+	return false;
+}
+
+
+void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
+{
+	UNUSED_PARAMETER(stagesurf);
+}
+
+
+void gs_stage_texture(gs_stagesurf_t *dst, gs_texture_t *src)
+{
+	UNUSED_PARAMETER(dst);
+	UNUSED_PARAMETER(src);
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+gs_timer_t *gs_timer_create(void)
+{
+	return NULL;
+}
+
+
+void gs_timer_destroy(gs_timer_t *timer)
+{
+	UNUSED_PARAMETER(timer);
+}
+
+
+void gs_timer_begin(gs_timer_t *timer)
+{
+	UNUSED_PARAMETER(timer);
+}
+
+
+void gs_timer_end(gs_timer_t *timer)
+{
+	UNUSED_PARAMETER(timer);
+}
+
+
+bool gs_timer_get_data(gs_timer_t *timer, uint64_t *ticks)
+{
+	UNUSED_PARAMETER(timer);
+	UNUSED_PARAMETER(ticks);
+	return false;
+}
+
+
+gs_timer_range_t *gs_timer_range_create(void)
+{
+	return NULL;
+}
+
+
+void gs_timer_range_destroy(gs_timer_range_t *range)
+{
+	UNUSED_PARAMETER(range);
+}
+
+
+void gs_timer_range_begin(gs_timer_range_t *range)
+{
+	UNUSED_PARAMETER(range);
+}
+
+
+void gs_timer_range_end(gs_timer_range_t *range)
+{
+	UNUSED_PARAMETER(range);
+}
+
+
+bool gs_timer_range_get_data(gs_timer_range_t *range, bool *disjoint,
+	uint64_t *frequency)
+{
+	UNUSED_PARAMETER(range);
+	UNUSED_PARAMETER(disjoint);
+	UNUSED_PARAMETER(frequency);
+	return false;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+void gs_clear(uint32_t clear_flags, const struct vec4 *color, float depth,
+	uint8_t stencil)
+{
+	UNUSED_PARAMETER(clear_flags);
+	UNUSED_PARAMETER(color);
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(stencil);
+}
+
+
+void gs_ortho(float left, float right, float top, float bottom, float znear,
+	float zfar)
+{
+	UNUSED_PARAMETER(left);
+	UNUSED_PARAMETER(right);
+	UNUSED_PARAMETER(top);
+	UNUSED_PARAMETER(bottom);
+	UNUSED_PARAMETER(znear);
+	UNUSED_PARAMETER(zfar);
+}
+
+
+void gs_set_viewport(int x, int y, int width, int height)
+{
+	UNUSED_PARAMETER(x);
+	UNUSED_PARAMETER(y);
+	UNUSED_PARAMETER(width);
+	UNUSED_PARAMETER(height);
+}
+
+
+void gs_blend_state_push(void)
+{
+}
+
+
+void gs_blend_state_pop(void)
+{
+}
+
+
+void gs_blend_function(enum gs_blend_type src, enum gs_blend_type dest)
+{
+	UNUSED_PARAMETER(src);
+	UNUSED_PARAMETER(dest);
+}
+
+
+void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
+	uint32_t height)
+{
+	os_atomic_inc_long(&stub_record.draws);
+
+	UNUSED_PARAMETER(tex);
+	UNUSED_PARAMETER(flip);
+	UNUSED_PARAMETER(width);
+	UNUSED_PARAMETER(height);
+}
+
+
+void gs_draw_sprite_subregion(gs_texture_t *tex, uint32_t flip, uint32_t x,
+	uint32_t y, uint32_t cx, uint32_t cy)
+{
+	os_atomic_inc_long(&stub_record.draws);
+
+	UNUSED_PARAMETER(tex);
+	UNUSED_PARAMETER(flip);
+	UNUSED_PARAMETER(x);
+	UNUSED_PARAMETER(y);
+	UNUSED_PARAMETER(cx);
+	UNUSED_PARAMETER(cy);
+}
+
+
+void gs_flush(void)
+{
+}
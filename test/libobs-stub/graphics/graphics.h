@@ -0,0 +1,168 @@
+#pragma once
+
+#include "../util/c99defs.h"
+
+struct vec2;
+struct vec4;
+
+typedef struct gs_effect               gs_effect_t;
+typedef struct gs_effect_param         gs_eparam_t;
+typedef struct gs_texture              gs_texture_t;
+typedef struct gs_stage_surface        gs_stagesurf_t;
+typedef struct gs_sampler_state        gs_samplerstate_t;
+typedef struct gs_texture_render       gs_texrender_t;
+typedef struct gs_timer                gs_timer_t;
+typedef struct gs_timer_range          gs_timer_range_t;
+
+enum gs_color_format {
+	GS_UNKNOWN,
+	GS_A8,
+	GS_R8,
+	GS_RGBA,
+	GS_BGRX,
+	GS_BGRA,
+	GS_R10G10B10A2,
+	GS_RGBA16,
+	GS_R16,
+	GS_RGBA16F,
+	GS_RGBA32F,
+	GS_RG16F,
+	GS_RG32F,
+	GS_R16F,
+	GS_R32F
+};
+
+enum gs_zstencil_format {
+	GS_ZS_NONE,
+	GS_Z16,
+	GS_Z24_S8,
+	GS_Z32F,
+	GS_Z32F_S8X24
+};
+
+enum gs_blend_type {
+	GS_BLEND_ZERO,
+	GS_BLEND_ONE,
+	GS_BLEND_SRCCOLOR,
+	GS_BLEND_INVSRCCOLOR,
+	GS_BLEND_SRCALPHA,
+	GS_BLEND_INVSRCALPHA
+};
+
+enum gs_sample_filter {
+	GS_FILTER_POINT,
+	GS_FILTER_LINEAR
+};
+
+enum gs_address_mode {
+	GS_ADDRESS_CLAMP,
+	GS_ADDRESS_WRAP,
+	GS_ADDRESS_MIRROR,
+	GS_ADDRESS_BORDER
+};
+
+#define GS_CLEAR_COLOR                  (1 << 0)
+#define GS_CLEAR_DEPTH                  (1 << 1)
+#define GS_CLEAR_STENCIL                (1 << 2)
+
+#define GS_BUILD_MIPMAPS                (1 << 0)
+#define GS_DYNAMIC                      (1 << 1)
+#define GS_RENDER_TARGET                (1 << 2)
+
+struct gs_sampler_info {
+	enum gs_sample_filter          filter;
+	enum gs_address_mode           address_u;
+	enum gs_address_mode           address_v;
+	enum gs_address_mode           address_w;
+	int                            max_anisotropy;
+	uint32_t                       border_color;
+};
+
+static inline uint32_t gs_get_format_bpp(enum gs_color_format format)
+{
+	switch (format) {
+	case GS_A8:
+	case GS_R8:          return 8;
+	case GS_R16:
+	case GS_R16F:        return 16;
+	case GS_RGBA16:
+	case GS_RGBA16F:
+	case GS_RG32F:       return 64;
+	case GS_RGBA32F:     return 128;
+	case GS_UNKNOWN:     return 0;
+	default:             return 32;
+	}
+}
+
+/* effects */
+extern gs_effect_t *gs_effect_create_from_file(const char *file,
+	char **error_string);
+extern void gs_effect_destroy(gs_effect_t *effect);
+extern gs_eparam_t *gs_effect_get_param_by_name(const gs_effect_t *effect,
+	const char *name);
+extern bool gs_effect_loop(gs_effect_t *effect, const char *name);
+extern void gs_effect_set_float(gs_eparam_t *param, float val);
+extern void gs_effect_set_vec2(gs_eparam_t *param, const struct vec2 *val);
+extern void gs_effect_set_texture(gs_eparam_t *param, gs_texture_t *val);
+extern void gs_effect_set_next_sampler(gs_eparam_t *param,
+	gs_samplerstate_t *sampler);
+
+/* resources */
+extern gs_samplerstate_t *gs_samplerstate_create(
+	const struct gs_sampler_info *info);
+extern void gs_samplerstate_destroy(gs_samplerstate_t *samplerstate);
+
+extern gs_texture_t *gs_texture_create(uint32_t width, uint32_t height,
+	enum gs_color_format color_format, uint32_t levels,
+	const uint8_t **data, uint32_t flags);
+extern void gs_texture_destroy(gs_texture_t *tex);
+extern void gs_texture_set_image(gs_texture_t *tex, const uint8_t *data,
+	uint32_t linesize, bool invert);
+extern uint32_t gs_texture_get_width(const gs_texture_t *tex);
+extern uint32_t gs_texture_get_height(const gs_texture_t *tex);
+
+extern gs_texrender_t *gs_texrender_create(enum gs_color_format format,
+	enum gs_zstencil_format zsformat);
+extern void gs_texrender_destroy(gs_texrender_t *texrender);
+extern bool gs_texrender_begin(gs_texrender_t *texrender, uint32_t cx,
+	uint32_t cy);
+extern void gs_texrender_end(gs_texrender_t *texrender);
+extern void gs_texrender_reset(gs_texrender_t *texrender);
+extern gs_texture_t *gs_texrender_get_texture(
+	const gs_texrender_t *texrender);
+
+extern gs_stagesurf_t *gs_stagesurface_create(uint32_t width,
+	uint32_t height, enum gs_color_format color_format);
+extern void gs_stagesurface_destroy(gs_stagesurf_t *stagesurf);
+extern bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
+	uint32_t *linesize);
+extern void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf);
+extern void gs_stage_texture(gs_stagesurf_t *dst, gs_texture_t *src);
+
+/* timer queries */
+extern gs_timer_t *gs_timer_create(void);
+extern void gs_timer_destroy(gs_timer_t *timer);
+extern void gs_timer_begin(gs_timer_t *timer);
+extern void gs_timer_end(gs_timer_t *timer);
+extern bool gs_timer_get_data(gs_timer_t *timer, uint64_t *ticks);
+extern gs_timer_range_t *gs_timer_range_create(void);
+extern void gs_timer_range_destroy(gs_timer_range_t *range);
+extern void gs_timer_range_begin(gs_timer_range_t *range);
+extern void gs_timer_range_end(gs_timer_range_t *range);
+extern bool gs_timer_range_get_data(gs_timer_range_t *range, bool *disjoint,
+	uint64_t *frequency);
+
+/* state and drawing */
+extern void gs_clear(uint32_t clear_flags, const struct vec4 *color,
+	float depth, uint8_t stencil);
+extern void gs_ortho(float left, float right, float top, float bottom,
+	float znear, float zfar);
+extern void gs_set_viewport(int x, int y, int width, int height);
+extern void gs_blend_state_push(void);
+extern void gs_blend_state_pop(void);
+extern void gs_blend_function(enum gs_blend_type src, enum gs_blend_type dest);
+extern void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
+	uint32_t height);
+extern void gs_draw_sprite_subregion(gs_texture_t *tex, uint32_t flip,
+	uint32_t x, uint32_t y, uint32_t cx, uint32_t cy);
+extern void gs_flush(void);
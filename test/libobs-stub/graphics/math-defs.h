@@ -0,0 +1,10 @@
+#pragma once
+
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.1415926535897932384626433832795
+#endif
+
+#define M_INFINITE 3.4e38f
+#define EPSILON 1e-4f
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "math-defs.h"
+
+struct vec4 {
+	float                          x;
+	float                          y;
+	float                          z;
+	float                          w;
+};
+
+static inline void vec4_zero(struct vec4 *dst)
+{
+	dst->x = 0.0f;
+	dst->y = 0.0f;
+	dst->z = 0.0f;
+	dst->w = 0.0f;
+}
+
+static inline void vec4_set(struct vec4 *dst, float x, float y, float z,
+	float w)
+{
+	dst->x = x;
+	dst->y = y;
+	dst->z = z;
+	dst->w = w;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "obs.h"
+
+#define MODULE_EXPORT
+
+#define OBS_DECLARE_MODULE()                                      \
+	static obs_module_t *obs_module_pointer;                  \
+	void obs_module_set_pointer(obs_module_t *module);        \
+	void obs_module_set_pointer(obs_module_t *module)         \
+	{                                                         \
+		obs_module_pointer = module;                      \
+	}                                                         \
+	obs_module_t *obs_current_module(void)                    \
+	{                                                         \
+		return obs_module_pointer;                        \
+	}
+
+/* there is no locale to look strings up in, so every lookup falls back to
+ * the key, as libobs does for a missing string */
+#define OBS_MODULE_USE_DEFAULT_LOCALE(module_name, default_locale) \
+	const char *obs_module_text(const char *val)               \
+	{                                                          \
+		return val;                                        \
+	}
+
+extern const char *obs_module_text(const char *lookup_string);
+extern obs_module_t *obs_current_module(void);
+
+extern char *obs_find_module_file(obs_module_t *module, const char *file);
+extern char *obs_module_get_config_path(obs_module_t *module,
+	const char *file);
+
+#define obs_module_file(file) obs_find_module_file(obs_current_module(), file)
+#define obs_module_config_path(file) \
+	obs_module_get_config_path(obs_current_module(), file)
+
+extern bool obs_module_load(void);
+extern void obs_module_unload(void);
@@ -0,0 +1,1012 @@
+#include <stdio.h>
+#include <string.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/threading.h>
+#include "obs-stub.h"
+
+/*
+ * The libobs core without video output: registered source types, sources
+ * with their settings, filter chains and weak references, tick callbacks
+ * and the global proc handler.  Sources follow libobs' rules where the
+ * module can tell the difference: settings get the type's defaults, an
+ * update of a video source is deferred to its next tick, filters are drawn
+ * from the last one added down to the parent, and a filter's base size
+ * is its target's unless the filter reports one.  Rendering runs the
+ * filters' video_render on the calling thread, which stands in for the
+ * graphics thread.  An async source's frames go through the filters'
+ * filter_video in its next tick, from the source up.
+ */
+
+struct stub_input {
+	uint32_t                       width;
+	uint32_t                       height;
+};
+
+struct obs_weak_source {
+	volatile long                  refs;
+	volatile long                  weak_refs;
+	obs_source_t                   *source;
+};
+
+struct obs_source {
+	struct obs_source_info         info;
+	struct obs_weak_source         *control;
+	char                           *name;
+	void                           *data;
+	obs_data_t                     *settings;
+	proc_handler_t                 *procs;
+	volatile long                  defer_update;
+
+	obs_source_t                   *filter_parent;
+	obs_source_t                   *filter_target;
+	DARRAY(obs_source_t *)         filters;
+	bool                           rendering_filter;
+
+	/* async: the copies the stub made and not released yet, the one
+	 * waiting for the next tick, and the frame the filters handed back
+	 * for the last one */
+	DARRAY(struct obs_source_frame *) async_cache;
+	struct obs_source_frame        *async_pending;
+	struct obs_source_frame        *async_frame;
+	uint32_t                       async_width;
+	uint32_t                       async_height;
+};
+
+struct tick_callback {
+	void                           (*tick)(void *param, float seconds);
+	void                           *param;
+};
+
+struct stub_record stub_record;
+
+static DARRAY(struct obs_source_info) source_types;
+static DARRAY(obs_source_t *) sources;
+static DARRAY(struct tick_callback) tick_callbacks;
+static pthread_mutex_t core_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static proc_handler_t *core_procs;
+static uint64_t frame_time;
+static char *module_data_dir;
+static char *module_config_dir;
+
+
+/* ------------------------------------------------------------------------- */
+
+static void *stub_input_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct stub_input *input = bzalloc(sizeof(*input));
+
+	input->width = (uint32_t)obs_data_get_int(settings, "width");
+	input->height = (uint32_t)obs_data_get_int(settings, "height");
+
+	UNUSED_PARAMETER(source);
+	return input;
+}
+
+
+static void stub_input_destroy(void *data)
+{
+	bfree(data);
+}
+
+
+static void stub_input_update(void *data, obs_data_t *settings)
+{
+	struct stub_input *input = data;
+
+	input->width = (uint32_t)obs_data_get_int(settings, "width");
+	input->height = (uint32_t)obs_data_get_int(settings, "height");
+}
+
+
+static void stub_input_render(void *data, gs_effect_t *effect)
+{
+	os_atomic_inc_long(&stub_record.draws);
+
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(effect);
+}
+
+
+static uint32_t stub_input_width(void *data)
+{
+	struct stub_input *input = data;
+	return input->width;
+}
+
+
+static uint32_t stub_input_height(void *data)
+{
+	struct stub_input *input = data;
+	return input->height;
+}
+
+
+static void *stub_async_input_create(obs_data_t *settings,
+	obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+
+static void stub_async_input_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+
+static const struct obs_source_info stub_input_info = {
+	.id                            = STUB_INPUT_ID,
+	.type                          = OBS_SOURCE_TYPE_INPUT,
+	.output_flags                  = OBS_SOURCE_VIDEO,
+	.create                        = stub_input_create,
+	.destroy                       = stub_input_destroy,
+	.update                        = stub_input_update,
+	.video_render                  = stub_input_render,
+	.get_width                     = stub_input_width,
+	.get_height                    = stub_input_height
+};
+
+static const struct obs_source_info stub_async_input_info = {
+	.id                            = STUB_ASYNC_INPUT_ID,
+	.type                          = OBS_SOURCE_TYPE_INPUT,
+	.output_flags                  = OBS_SOURCE_ASYNC_VIDEO,
+	.create                        = stub_async_input_create,
+	.destroy                       = stub_async_input_destroy
+};
+
+
+/* ------------------------------------------------------------------------- */
+
+void stub_startup(const char *data_dir, const char *config_dir)
+{
+	module_data_dir = bstrdup(data_dir);
+	module_config_dir = bstrdup(config_dir);
+	core_procs = proc_handler_create();
+	frame_time = 0;
+
+	obs_register_source(&stub_input_info);
+	obs_register_source(&stub_async_input_info);
+}
+
+
+void stub_shutdown(void)
+{
+	if (sources.num)
+		blog(LOG_WARNING, "stub: %zu sources were not released",
+			sources.num);
+
+	da_free(sources);
+	da_free(source_types);
+	da_free(tick_callbacks);
+
+	proc_handler_destroy(core_procs);
+	core_procs = NULL;
+
+	bfree(module_data_dir);
+	bfree(module_config_dir);
+	module_data_dir = NULL;
+	module_config_dir = NULL;
+}
+
+
+static char *stub_path(const char *dir, const char *file)
+{
+	struct dstr path = {0};
+
+	if (!dir)
+		return NULL;
+
+	dstr_copy(&path, dir);
+	if (file && *file) {
+		dstr_cat_ch(&path, '/');
+		dstr_cat(&path, file);
+	}
+
+	return path.array;
+}
+
+
+char *obs_find_module_file(obs_module_t *module, const char *file)
+{
+	UNUSED_PARAMETER(module);
+	return stub_path(module_data_dir, file);
+}
+
+
+char *obs_module_get_config_path(obs_module_t *module, const char *file)
+{
+	UNUSED_PARAMETER(module);
+	return stub_path(module_config_dir, file);
+}
+
+
+proc_handler_t *obs_get_proc_handler(void)
+{
+	return core_procs;
+}
+
+
+bool obs_get_video_info(struct obs_video_info *ovi)
+{
+	memset(ovi, 0, sizeof(*ovi));
+	ovi->graphics_module = "stub";
+	ovi->fps_num = 60;
+	ovi->fps_den = 1;
+	ovi->base_width = 1920;
+	ovi->base_height = 1080;
+	ovi->output_width = 1920;
+	ovi->output_height = 1080;
+	return true;
+}
+
+
+uint64_t obs_get_video_frame_time(void)
+{
+	return frame_time;
+}
+
+
+void obs_add_tick_callback(void (*tick)(void *param, float seconds),
+	void *param)
+{
+	struct tick_callback cb = {tick, param};
+
+	pthread_mutex_lock(&core_mutex);
+	da_push_back(tick_callbacks, &cb);
+	pthread_mutex_unlock(&core_mutex);
+}
+
+
+void obs_remove_tick_callback(void (*tick)(void *param, float seconds),
+	void *param)
+{
+	struct tick_callback cb = {tick, param};
+
+	pthread_mutex_lock(&core_mutex);
+	da_erase_item(tick_callbacks, &cb);
+	pthread_mutex_unlock(&core_mutex);
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+void obs_register_source_s(const struct obs_source_info *info, size_t size)
+{
+	struct obs_source_info copy = {0};
+
+	memcpy(&copy, info, size < sizeof(copy) ? size : sizeof(copy));
+	da_push_back(source_types, &copy);
+}
+
+
+static const struct obs_source_info *find_source_type(const char *id)
+{
+	for (size_t i = 0; i < source_types.num; i++)
+		if (strcmp(source_types.array[i].id, id) == 0)
+			return &source_types.array[i];
+
+	return NULL;
+}
+
+
+obs_source_t *obs_source_create(const char *id, const char *name,
+	obs_data_t *settings, obs_data_t *hotkey_data)
+{
+	const struct obs_source_info *info = find_source_type(id);
+	struct obs_source *source;
+
+	UNUSED_PARAMETER(hotkey_data);
+
+	if (!info) {
+		blog(LOG_ERROR, "stub: source type '%s' not found", id);
+		return NULL;
+	}
+
+	source = bzalloc(sizeof(*source));
+	source->info = *info;
+	source->name = bstrdup(name);
+	source->procs = proc_handler_create();
+	source->settings = obs_data_create();
+	if (info->get_defaults)
+		info->get_defaults(source->settings);
+	obs_data_apply(source->settings, settings);
+
+	source->control = bzalloc(sizeof(*source->control));
+	source->control->refs = 1;
+	source->control->weak_refs = 1;
+	source->control->source = source;
+
+	pthread_mutex_lock(&core_mutex);
+	da_push_back(sources, &source);
+	pthread_mutex_unlock(&core_mutex);
+
+	source->data = info->create(source->settings, source);
+	if (!source->data)
+		blog(LOG_ERROR, "stub: failed to create source '%s'", name);
+
+	return source;
+}
+
+
+static void source_destroy(obs_source_t *source)
+{
+	pthread_mutex_lock(&core_mutex);
+	da_erase_item(sources, &source);
+	pthread_mutex_unlock(&core_mutex);
+
+	while (source->filters.num)
+		obs_source_filter_remove(source, source->filters.array[0]);
+	da_free(source->filters);
+
+	for (size_t i = 0; i < source->async_cache.num; i++)
+		obs_source_frame_destroy(source->async_cache.array[i]);
+	da_free(source->async_cache);
+
+	if (source->data)
+		source->info.destroy(source->data);
+
+	obs_data_release(source->settings);
+	proc_handler_destroy(source->procs);
+	bfree(source->name);
+	bfree(source);
+}
+
+
+obs_source_t *obs_source_get_ref(obs_source_t *source)
+{
+	long refs;
+
+	if (!source)
+		return NULL;
+
+	refs = os_atomic_load_long(&source->control->refs);
+	while (refs > 0) {
+		if (__atomic_compare_exchange_n(&source->control->refs, &refs,
+			refs + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+			return source;
+	}
+
+	return NULL;
+}
+
+
+void obs_source_release(obs_source_t *source)
+{
+	struct obs_weak_source *control;
+
+	if (!source)
+		return;
+
+	control = source->control;
+	if (os_atomic_dec_long(&control->refs) != 0)
+		return;
+
+	source_destroy(source);
+	obs_weak_source_release(control);
+}
+
+
+obs_weak_source_t *obs_source_get_weak_source(obs_source_t *source)
+{
+	if (!source)
+		return NULL;
+
+	os_atomic_inc_long(&source->control->weak_refs);
+	return source->control;
+}
+
+
+obs_source_t *obs_weak_source_get_source(obs_weak_source_t *weak)
+{
+	if (!weak)
+		return NULL;
+
+	/* refs only drops to 0 once, after which source is not touched */
+	return os_atomic_load_long(&weak->refs) > 0 ?
+		obs_source_get_ref(weak->source) : NULL;
+}
+
+
+void obs_weak_source_release(obs_weak_source_t *weak)
+{
+	if (weak && os_atomic_dec_long(&weak->weak_refs) == 0)
+		bfree(weak);
+}
+
+
+bool obs_weak_source_references_source(obs_weak_source_t *weak,
+	obs_source_t *source)
+{
+	return weak && source && source->control == weak;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+void *obs_obj_get_data(void *obj)
+{
+	obs_source_t *source = obj;
+
+	return source ? source->data : NULL;
+}
+
+
+const char *obs_source_get_id(const obs_source_t *source)
+{
+	return source ? source->info.id : NULL;
+}
+
+
+enum obs_source_type obs_source_get_type(const obs_source_t *source)
+{
+	return source ? source->info.type : OBS_SOURCE_TYPE_INPUT;
+}
+
+
+const char *obs_source_get_name(const obs_source_t *source)
+{
+	return source ? source->name : NULL;
+}
+
+
+uint32_t obs_source_get_output_flags(const obs_source_t *source)
+{
+	return source ? source->info.output_flags : 0;
+}
+
+
+uint32_t obs_source_get_base_width(obs_source_t *source)
+{
+	if (!source)
+		return 0;
+	if (source->info.get_width && source->data)
+		return source->info.get_width(source->data);
+	if (source->info.output_flags & OBS_SOURCE_ASYNC)
+		return source->async_width;
+
+	return source->filter_parent ?
+		obs_source_get_base_width(source->filter_target) : 0;
+}
+
+
+uint32_t obs_source_get_base_height(obs_source_t *source)
+{
+	if (!source)
+		return 0;
+	if (source->info.get_height && source->data)
+		return source->info.get_height(source->data);
+	if (source->info.output_flags & OBS_SOURCE_ASYNC)
+		return source->async_height;
+
+	return source->filter_parent ?
+		obs_source_get_base_height(source->filter_target) : 0;
+}
+
+
+/* The size after the filters. */
+uint32_t obs_source_get_width(obs_source_t *source)
+{
+	if (source && source->filters.num)
+		return obs_source_get_base_width(*da_end(source->filters));
+
+	return obs_source_get_base_width(source);
+}
+
+
+uint32_t obs_source_get_height(obs_source_t *source)
+{
+	if (source && source->filters.num)
+		return obs_source_get_base_height(*da_end(source->filters));
+
+	return obs_source_get_base_height(source);
+}
+
+
+obs_data_t *obs_source_get_settings(const obs_source_t *source)
+{
+	if (!source)
+		return NULL;
+
+	obs_data_addref(source->settings);
+	return source->settings;
+}
+
+
+/* Only counted; there is no properties view to refresh. */
+void obs_source_update_properties(obs_source_t *source)
+{
+	if (source)
+		os_atomic_inc_long(&stub_record.property_updates);
+}
+
+
+/* Video sources pick the new settings up in their next tick. */
+void obs_source_update(obs_source_t *source, obs_data_t *settings)
+{
+	if (!source)
+		return;
+
+	obs_data_apply(source->settings, settings);
+
+	if (source->info.output_flags & OBS_SOURCE_VIDEO) {
+		os_atomic_inc_long(&source->defer_update);
+	} else if (source->data && source->info.update) {
+		source->info.update(source->data, source->settings);
+		os_atomic_inc_long(&stub_record.updates);
+	}
+}
+
+
+/* The properties with the current settings applied, which runs every
+ * modified callback once, as the properties dialog does. */
+obs_properties_t *obs_source_properties(const obs_source_t *source)
+{
+	obs_properties_t *props;
+
+	if (!source || !source->info.get_properties)
+		return NULL;
+
+	props = source->info.get_properties(source->data);
+
+	for (obs_property_t *p = obs_properties_first(props); p;
+		obs_property_next(&p))
+		obs_property_modified(p, source->settings);
+
+	return props;
+}
+
+
+proc_handler_t *obs_source_get_proc_handler(const obs_source_t *source)
+{
+	return source ? source->procs : NULL;
+}
+
+
+enum obs_deinterlace_mode obs_source_get_deinterlace_mode(
+	const obs_source_t *source)
+{
+	UNUSED_PARAMETER(source);
+	return OBS_DEINTERLACE_MODE_DISABLE;
+}
+
+
+void obs_source_inc_showing(obs_source_t *source)
+{
+	UNUSED_PARAMETER(source);
+}
+
+
+void obs_source_dec_showing(obs_source_t *source)
+{
+	UNUSED_PARAMETER(source);
+}
+
+
+obs_source_t *obs_get_source_by_name(const char *name)
+{
+	obs_source_t *found = NULL;
+
+	pthread_mutex_lock(&core_mutex);
+	for (size_t i = 0; i < sources.num && !found; i++) {
+		obs_source_t *source = sources.array[i];
+
+		if (source->info.type == OBS_SOURCE_TYPE_INPUT &&
+			strcmp(source->name, name) == 0)
+			found = obs_source_get_ref(source);
+	}
+	pthread_mutex_unlock(&core_mutex);
+
+	return found;
+}
+
+
+/* Inputs only, as in libobs. */
+void obs_enum_sources(bool (*enum_proc)(void *, obs_source_t *), void *param)
+{
+	DARRAY(obs_source_t *) inputs = {0};
+
+	pthread_mutex_lock(&core_mutex);
+	for (size_t i = 0; i < sources.num; i++) {
+		obs_source_t *source = sources.array[i];
+
+		if (source->info.type == OBS_SOURCE_TYPE_INPUT &&
+			obs_source_get_ref(source))
+			da_push_back(inputs, &source);
+	}
+	pthread_mutex_unlock(&core_mutex);
+
+	for (size_t i = 0; i < inputs.num; i++) {
+		bool more = enum_proc(param, inputs.array[i]);
+
+		obs_source_release(inputs.array[i]);
+		if (!more) {
+			for (size_t j = i + 1; j < inputs.num; j++)
+				obs_source_release(inputs.array[j]);
+			break;
+		}
+	}
+
+	da_free(inputs);
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+/* The new filter is drawn last, on top of the ones added before. */
+void obs_source_filter_add(obs_source_t *source, obs_source_t *filter)
+{
+	if (!source || !filter || filter->filter_parent)
+		return;
+
+	filter->filter_parent = source;
+	filter->filter_target = source->filters.num ?
+		*da_end(source->filters) : source;
+
+	obs_source_get_ref(filter);
+	da_push_back(source->filters, &filter);
+}
+
+
+void obs_source_filter_remove(obs_source_t *source, obs_source_t *filter)
+{
+	size_t idx;
+
+	if (!source || !filter)
+		return;
+
+	idx = da_find(source->filters, &filter, 0);
+	if (idx == DARRAY_INVALID)
+		return;
+
+	if (idx + 1 < source->filters.num)
+		source->filters.array[idx + 1]->filter_target =
+			filter->filter_target;
+	da_erase(source->filters, idx);
+
+	if (filter->info.filter_remove && filter->data)
+		filter->info.filter_remove(filter->data, source);
+
+	filter->filter_parent = NULL;
+	filter->filter_target = NULL;
+	obs_source_release(filter);
+}
+
+
+/* From the source up, as libobs enumerates them. */
+void obs_source_enum_filters(obs_source_t *source,
+	obs_source_enum_proc_t callback, void *param)
+{
+	if (!source)
+		return;
+
+	for (size_t i = 0; i < source->filters.num; i++)
+		callback(source, source->filters.array[i], param);
+}
+
+
+obs_source_t *obs_filter_get_parent(const obs_source_t *filter)
+{
+	return filter ? filter->filter_parent : NULL;
+}
+
+
+obs_source_t *obs_filter_get_target(const obs_source_t *filter)
+{
+	return filter ? filter->filter_target : NULL;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+/* Hands the waiting frame to the filters, each getting what the one before
+ * returned; NULL from a filter drops the frame. */
+static void source_async_tick(obs_source_t *source)
+{
+	struct obs_source_frame *frame = source->async_pending;
+
+	if (!frame)
+		return;
+
+	source->async_pending = NULL;
+
+	for (size_t i = 0; i < source->filters.num && frame; i++) {
+		obs_source_t *filter = source->filters.array[i];
+
+		if (filter->data && filter->info.filter_video)
+			frame = filter->info.filter_video(filter->data, frame);
+	}
+
+	if (!frame)
+		return;
+
+	obs_source_release_frame(source, source->async_frame);
+	source->async_frame = frame;
+	source->async_width = frame->width;
+	source->async_height = frame->height;
+}
+
+
+static void source_tick(obs_source_t *source, float seconds)
+{
+	if (!source->data)
+		return;
+
+	source_async_tick(source);
+
+	if (os_atomic_exchange_long(&source->defer_update, 0) &&
+		source->info.update) {
+		source->info.update(source->data, source->settings);
+		os_atomic_inc_long(&stub_record.updates);
+	}
+
+	if (source->info.video_tick) {
+		source->info.video_tick(source->data, seconds);
+		os_atomic_inc_long(&stub_record.ticks);
+	}
+}
+
+
+void stub_video_tick(float seconds)
+{
+	DARRAY(struct tick_callback) callbacks = {0};
+	DARRAY(obs_source_t *) ticked = {0};
+
+	frame_time += (uint64_t)((double)seconds * 1000000000.0);
+
+	/* callbacks and sources may go away while they run */
+	pthread_mutex_lock(&core_mutex);
+	da_copy(callbacks, tick_callbacks);
+	for (size_t i = 0; i < sources.num; i++) {
+		obs_source_t *source = obs_source_get_ref(sources.array[i]);
+
+		if (source)
+			da_push_back(ticked, &source);
+	}
+	pthread_mutex_unlock(&core_mutex);
+
+	for (size_t i = 0; i < callbacks.num; i++)
+		callbacks.array[i].tick(callbacks.array[i].param, seconds);
+
+	for (size_t i = 0; i < ticked.num; i++) {
+		source_tick(ticked.array[i], seconds);
+		obs_source_release(ticked.array[i]);
+	}
+
+	da_free(callbacks);
+	da_free(ticked);
+}
+
+
+static void source_render(obs_source_t *source)
+{
+	if (source->data && source->info.video_render)
+		source->info.video_render(source->data, NULL);
+}
+
+
+/* A source with filters draws through the last one; the parent's own
+ * drawing is what the first filter's target renders to. */
+void obs_source_video_render(obs_source_t *source)
+{
+	if (!source)
+		return;
+
+	if (source->filters.num && !source->rendering_filter) {
+		source->rendering_filter = true;
+		source_render(*da_end(source->filters));
+		source->rendering_filter = false;
+	} else {
+		source_render(source);
+	}
+}
+
+
+bool obs_source_process_filter_begin(obs_source_t *filter,
+	enum gs_color_format format,
+	enum obs_allow_direct_render allow_direct)
+{
+	UNUSED_PARAMETER(format);
+	UNUSED_PARAMETER(allow_direct);
+
+	if (!filter || !filter->filter_target)
+		return false;
+
+	obs_source_video_render(filter->filter_target);
+	return true;
+}
+
+
+void obs_source_process_filter_end(obs_source_t *filter, gs_effect_t *effect,
+	uint32_t width, uint32_t height)
+{
+	obs_source_process_filter_tech_end(filter, effect, width, height,
+		"Draw");
+}
+
+
+void obs_source_process_filter_tech_end(obs_source_t *filter,
+	gs_effect_t *effect, uint32_t width, uint32_t height,
+	const char *tech_name)
+{
+	if (filter && effect && width && height)
+		os_atomic_inc_long(&stub_record.draws);
+
+	UNUSED_PARAMETER(tech_name);
+}
+
+
+void obs_source_skip_video_filter(obs_source_t *filter)
+{
+	if (!filter || !filter->filter_target)
+		return;
+
+	os_atomic_inc_long(&stub_record.skips);
+	obs_source_video_render(filter->filter_target);
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+/* Line sizes and rows of each plane, rows 32-byte aligned. */
+static void frame_layout(struct obs_source_frame *frame,
+	uint32_t plane_rows[MAX_AV_PLANES])
+{
+	uint32_t width = frame->width;
+	uint32_t height = frame->height;
+
+	switch (frame->format) {
+	case VIDEO_FORMAT_I420:
+		frame->linesize[0] = width;
+		frame->linesize[1] = (width + 1) / 2;
+		frame->linesize[2] = (width + 1) / 2;
+		plane_rows[0] = height;
+		plane_rows[1] = plane_rows[2] = (height + 1) / 2;
+		break;
+	case VIDEO_FORMAT_NV12:
+		frame->linesize[0] = width;
+		frame->linesize[1] = (width + 1) / 2 * 2;
+		plane_rows[0] = height;
+		plane_rows[1] = (height + 1) / 2;
+		break;
+	case VIDEO_FORMAT_I444:
+		for (size_t i = 0; i < 3; i++) {
+			frame->linesize[i] = width;
+			plane_rows[i] = height;
+		}
+		break;
+	case VIDEO_FORMAT_Y800:
+		frame->linesize[0] = width;
+		plane_rows[0] = height;
+		break;
+	case VIDEO_FORMAT_YVYU:
+	case VIDEO_FORMAT_YUY2:
+	case VIDEO_FORMAT_UYVY:
+		frame->linesize[0] = (width + 1) / 2 * 4;
+		plane_rows[0] = height;
+		break;
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+		frame->linesize[0] = width * 4;
+		plane_rows[0] = height;
+		break;
+	default:
+		break;
+	}
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
+		frame->linesize[i] = (frame->linesize[i] + 31) & ~31u;
+}
+
+
+/* One allocation for all planes. */
+struct obs_source_frame *obs_source_frame_create(enum video_format format,
+	uint32_t width, uint32_t height)
+{
+	struct obs_source_frame *frame;
+	uint32_t plane_rows[MAX_AV_PLANES] = {0};
+	size_t size = 0;
+	uint8_t *data;
+
+	frame = bzalloc(sizeof(*frame));
+	frame->format = format;
+	frame->width = width;
+	frame->height = height;
+
+	frame_layout(frame, plane_rows);
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
+		size += (size_t)frame->linesize[i] * plane_rows[i];
+
+	if (!size)
+		return frame;
+
+	data = bzalloc(size);
+	for (size_t i = 0; i < MAX_AV_PLANES && plane_rows[i]; i++) {
+		frame->data[i] = data;
+		data += (size_t)frame->linesize[i] * plane_rows[i];
+	}
+
+	return frame;
+}
+
+
+void obs_source_frame_destroy(struct obs_source_frame *frame)
+{
+	if (frame) {
+		bfree(frame->data[0]);
+		bfree(frame);
+	}
+}
+
+
+/* Only frames the source's copies were made in are its own, as in libobs;
+ * a filter's own frame handed back by the chain is left alone.  libobs
+ * reuses its copies, the stub frees them. */
+void obs_source_release_frame(obs_source_t *source,
+	struct obs_source_frame *frame)
+{
+	if (!frame)
+		return;
+
+	if (!source) {
+		obs_source_frame_destroy(frame);
+		return;
+	}
+
+	if (da_find(source->async_cache, &frame, 0) == DARRAY_INVALID)
+		return;
+
+	da_erase_item(source->async_cache, &frame);
+	obs_source_frame_destroy(frame);
+}
+
+
+/* Copies the frame, as libobs does, for the source's next tick; a frame
+ * still waiting is replaced. */
+void obs_source_output_video(obs_source_t *source,
+	const struct obs_source_frame *frame)
+{
+	struct obs_source_frame *copy;
+	uint32_t plane_rows[MAX_AV_PLANES] = {0};
+
+	if (!source || !frame)
+		return;
+
+	copy = obs_source_frame_create(frame->format, frame->width,
+		frame->height);
+	frame_layout(copy, plane_rows);
+
+	for (size_t i = 0; i < MAX_AV_PLANES && copy->data[i]; i++) {
+		uint32_t bytes = copy->linesize[i] < frame->linesize[i] ?
+			copy->linesize[i] : frame->linesize[i];
+
+		for (uint32_t y = 0; y < plane_rows[i]; y++)
+			memcpy(copy->data[i] + (size_t)y * copy->linesize[i],
+				frame->data[i] + (size_t)y * frame->linesize[i],
+				bytes);
+	}
+
+	copy->timestamp = frame->timestamp;
+	copy->full_range = frame->full_range;
+	copy->flip = frame->flip;
+	memcpy(copy->color_matrix, frame->color_matrix,
+		sizeof(copy->color_matrix));
+	memcpy(copy->color_range_min, frame->color_range_min,
+		sizeof(copy->color_range_min));
+	memcpy(copy->color_range_max, frame->color_range_max,
+		sizeof(copy->color_range_max));
+	copy->refs = 1;
+
+	obs_source_release_frame(source, source->async_pending);
+	source->async_pending = copy;
+	da_push_back(source->async_cache, &copy);
+}
+
+
+const struct obs_source_frame *stub_async_frame(obs_source_t *source)
+{
+	return source ? source->async_frame : NULL;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "obs.h"
+
+/*
+ * Harness side of the libobs stand-in: starting and stopping the fake core,
+ * driving frames, and what the stub recorded on the way.
+ */
+
+/* a plain input of the size in its "width" and "height" settings, which
+ * draws nothing */
+#define STUB_INPUT_ID                   "stub_input"
+
+/* an async input, sized by the last frame given to obs_source_output_video
+ * once its filters have seen it */
+#define STUB_ASYNC_INPUT_ID             "stub_async_input"
+
+/* counted on any thread */
+struct stub_record {
+	volatile long                  updates;
+	volatile long                  ticks;
+	volatile long                  draws;
+	volatile long                  skips;
+	volatile long                  property_updates;
+
+	/* graphics objects that were created and not destroyed yet */
+	volatile long                  resources;
+};
+
+extern struct stub_record stub_record;
+
+/* data_dir is where obs_module_file finds the module's files, config_dir
+ * where obs_module_config_path points. */
+extern void stub_startup(const char *data_dir, const char *config_dir);
+extern void stub_shutdown(void);
+
+/* Runs one frame: the tick callbacks, then for every source a pending
+ * update and its video_tick, in creation order. */
+extern void stub_video_tick(float seconds);
+
+/* The frame an async source would upload next, as its filters left it. */
+extern const struct obs_source_frame *stub_async_frame(obs_source_t *source);
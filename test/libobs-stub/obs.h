@@ -0,0 +1,364 @@
+#pragma once
+
+/*
+ * Headless stand-in for the parts of libobs the module uses, so that it
+ * can be built and exercised without OBS or a GPU.  Declarations follow
+ * libobs; what the stub does behind them is described in obs-stub.c.
+ */
+
+#include "util/c99defs.h"
+#include "util/bmem.h"
+#include "util/base.h"
+#include "graphics/graphics.h"
+#include "graphics/vec2.h"
+#include "callback/proc.h"
+
+#define MAX_AV_PLANES 8
+
+typedef struct obs_source              obs_source_t;
+typedef struct obs_weak_source         obs_weak_source_t;
+typedef struct obs_data                obs_data_t;
+typedef struct obs_data_array          obs_data_array_t;
+typedef struct obs_properties          obs_properties_t;
+typedef struct obs_property            obs_property_t;
+typedef struct obs_module              obs_module_t;
+
+enum obs_source_type {
+	OBS_SOURCE_TYPE_INPUT,
+	OBS_SOURCE_TYPE_FILTER,
+	OBS_SOURCE_TYPE_TRANSITION,
+	OBS_SOURCE_TYPE_SCENE
+};
+
+#define OBS_SOURCE_VIDEO                (1 << 0)
+#define OBS_SOURCE_AUDIO                (1 << 1)
+#define OBS_SOURCE_ASYNC                (1 << 2)
+#define OBS_SOURCE_ASYNC_VIDEO          (OBS_SOURCE_ASYNC | OBS_SOURCE_VIDEO)
+#define OBS_SOURCE_CUSTOM_DRAW          (1 << 3)
+
+enum obs_allow_direct_render {
+	OBS_NO_DIRECT_RENDERING,
+	OBS_ALLOW_DIRECT_RENDERING
+};
+
+enum obs_scale_type {
+	OBS_SCALE_DISABLE,
+	OBS_SCALE_POINT,
+	OBS_SCALE_BICUBIC,
+	OBS_SCALE_BILINEAR,
+	OBS_SCALE_LANCZOS,
+	OBS_SCALE_AREA
+};
+
+enum obs_base_effect {
+	OBS_EFFECT_DEFAULT,
+	OBS_EFFECT_DEFAULT_RECT,
+	OBS_EFFECT_OPAQUE,
+	OBS_EFFECT_SOLID,
+	OBS_EFFECT_BICUBIC,
+	OBS_EFFECT_LANCZOS,
+	OBS_EFFECT_BILINEAR_LOWRES,
+	OBS_EFFECT_PREMULTIPLIED_ALPHA,
+	OBS_EFFECT_REPEAT,
+	OBS_EFFECT_AREA
+};
+
+enum obs_deinterlace_mode {
+	OBS_DEINTERLACE_MODE_DISABLE,
+	OBS_DEINTERLACE_MODE_DISCARD
+};
+
+enum video_format {
+	VIDEO_FORMAT_NONE,
+	VIDEO_FORMAT_I420,
+	VIDEO_FORMAT_NV12,
+	VIDEO_FORMAT_YVYU,
+	VIDEO_FORMAT_YUY2,
+	VIDEO_FORMAT_UYVY,
+	VIDEO_FORMAT_RGBA,
+	VIDEO_FORMAT_BGRA,
+	VIDEO_FORMAT_BGRX,
+	VIDEO_FORMAT_Y800,
+	VIDEO_FORMAT_I444
+};
+
+struct obs_video_info {
+	const char                     *graphics_module;
+	uint32_t                       fps_num;
+	uint32_t                       fps_den;
+	uint32_t                       base_width;
+	uint32_t                       base_height;
+	uint32_t                       output_width;
+	uint32_t                       output_height;
+};
+
+struct obs_source_frame {
+	uint8_t                        *data[MAX_AV_PLANES];
+	uint32_t                       linesize[MAX_AV_PLANES];
+	uint32_t                       width;
+	uint32_t                       height;
+	uint64_t                       timestamp;
+
+	enum video_format              format;
+	float                          color_matrix[16];
+	bool                           full_range;
+	float                          color_range_min[3];
+	float                          color_range_max[3];
+	bool                           flip;
+
+	/* used internally by libobs */
+	volatile long                  refs;
+	bool                           prev_frame;
+};
+
+/* properties */
+
+enum obs_property_type {
+	OBS_PROPERTY_INVALID,
+	OBS_PROPERTY_BOOL,
+	OBS_PROPERTY_INT,
+	OBS_PROPERTY_FLOAT,
+	OBS_PROPERTY_TEXT,
+	OBS_PROPERTY_PATH,
+	OBS_PROPERTY_LIST,
+	OBS_PROPERTY_COLOR,
+	OBS_PROPERTY_BUTTON
+};
+
+enum obs_combo_type {
+	OBS_COMBO_TYPE_INVALID,
+	OBS_COMBO_TYPE_EDITABLE,
+	OBS_COMBO_TYPE_LIST
+};
+
+enum obs_combo_format {
+	OBS_COMBO_FORMAT_INVALID,
+	OBS_COMBO_FORMAT_INT,
+	OBS_COMBO_FORMAT_FLOAT,
+	OBS_COMBO_FORMAT_STRING
+};
+
+enum obs_text_type {
+	OBS_TEXT_DEFAULT,
+	OBS_TEXT_PASSWORD,
+	OBS_TEXT_MULTILINE,
+	OBS_TEXT_INFO
+};
+
+typedef bool (*obs_property_clicked_t)(obs_properties_t *props,
+	obs_property_t *property, void *data);
+typedef bool (*obs_property_modified_t)(obs_properties_t *props,
+	obs_property_t *property, obs_data_t *settings);
+
+extern obs_properties_t *obs_properties_create(void);
+extern void obs_properties_destroy(obs_properties_t *props);
+extern void obs_properties_set_param(obs_properties_t *props, void *param,
+	void (*destroy)(void *param));
+extern void *obs_properties_get_param(obs_properties_t *props);
+extern obs_property_t *obs_properties_first(obs_properties_t *props);
+extern obs_property_t *obs_properties_get(obs_properties_t *props,
+	const char *property);
+
+extern obs_property_t *obs_properties_add_bool(obs_properties_t *props,
+	const char *name, const char *description);
+extern obs_property_t *obs_properties_add_int_slider(obs_properties_t *props,
+	const char *name, const char *description, int min, int max,
+	int step);
+extern obs_property_t *obs_properties_add_float_slider(
+	obs_properties_t *props, const char *name, const char *description,
+	double min, double max, double step);
+extern obs_property_t *obs_properties_add_text(obs_properties_t *props,
+	const char *name, const char *description, enum obs_text_type type);
+extern obs_property_t *obs_properties_add_list(obs_properties_t *props,
+	const char *name, const char *description, enum obs_combo_type type,
+	enum obs_combo_format format);
+extern obs_property_t *obs_properties_add_button(obs_properties_t *props,
+	const char *name, const char *text, obs_property_clicked_t callback);
+
+extern bool obs_property_next(obs_property_t **p);
+extern const char *obs_property_name(obs_property_t *p);
+extern const char *obs_property_description(obs_property_t *p);
+extern enum obs_property_type obs_property_get_type(obs_property_t *p);
+extern bool obs_property_visible(obs_property_t *p);
+extern bool obs_property_enabled(obs_property_t *p);
+extern bool obs_property_modified(obs_property_t *p, obs_data_t *settings);
+extern bool obs_property_button_clicked(obs_property_t *p, void *obj);
+
+extern void obs_property_set_modified_callback(obs_property_t *p,
+	obs_property_modified_t modified);
+extern void obs_property_set_visible(obs_property_t *p, bool visible);
+extern void obs_property_set_enabled(obs_property_t *p, bool enabled);
+extern void obs_property_int_set_suffix(obs_property_t *p,
+	const char *suffix);
+
+extern size_t obs_property_list_add_string(obs_property_t *p,
+	const char *name, const char *val);
+extern size_t obs_property_list_add_int(obs_property_t *p, const char *name,
+	long long val);
+extern void obs_property_list_insert_string(obs_property_t *p, size_t idx,
+	const char *name, const char *val);
+extern void obs_property_list_item_remove(obs_property_t *p, size_t idx);
+extern void obs_property_list_clear(obs_property_t *p);
+extern size_t obs_property_list_item_count(obs_property_t *p);
+extern const char *obs_property_list_item_name(obs_property_t *p,
+	size_t idx);
+extern const char *obs_property_list_item_string(obs_property_t *p,
+	size_t idx);
+extern long long obs_property_list_item_int(obs_property_t *p, size_t idx);
+
+/* settings */
+
+extern obs_data_t *obs_data_create(void);
+extern obs_data_t *obs_data_create_from_json(const char *json_string);
+extern void obs_data_addref(obs_data_t *data);
+extern void obs_data_release(obs_data_t *data);
+extern const char *obs_data_get_json(obs_data_t *data);
+extern void obs_data_apply(obs_data_t *target, obs_data_t *apply_data);
+extern bool obs_data_has_user_value(obs_data_t *data, const char *name);
+
+extern void obs_data_set_string(obs_data_t *data, const char *name,
+	const char *val);
+extern void obs_data_set_int(obs_data_t *data, const char *name,
+	long long val);
+extern void obs_data_set_double(obs_data_t *data, const char *name,
+	double val);
+extern void obs_data_set_bool(obs_data_t *data, const char *name, bool val);
+extern void obs_data_set_obj(obs_data_t *data, const char *name,
+	obs_data_t *obj);
+extern void obs_data_set_array(obs_data_t *data, const char *name,
+	obs_data_array_t *array);
+
+extern void obs_data_set_default_string(obs_data_t *data, const char *name,
+	const char *val);
+extern void obs_data_set_default_int(obs_data_t *data, const char *name,
+	long long val);
+extern void obs_data_set_default_double(obs_data_t *data, const char *name,
+	double val);
+extern void obs_data_set_default_bool(obs_data_t *data, const char *name,
+	bool val);
+
+extern const char *obs_data_get_string(obs_data_t *data, const char *name);
+extern long long obs_data_get_int(obs_data_t *data, const char *name);
+extern double obs_data_get_double(obs_data_t *data, const char *name);
+extern bool obs_data_get_bool(obs_data_t *data, const char *name);
+extern obs_data_t *obs_data_get_obj(obs_data_t *data, const char *name);
+extern obs_data_array_t *obs_data_get_array(obs_data_t *data,
+	const char *name);
+
+extern obs_data_array_t *obs_data_array_create(void);
+extern void obs_data_array_release(obs_data_array_t *array);
+extern size_t obs_data_array_count(obs_data_array_t *array);
+extern obs_data_t *obs_data_array_item(obs_data_array_t *array, size_t idx);
+extern size_t obs_data_array_push_back(obs_data_array_t *array,
+	obs_data_t *obj);
+
+/* sources */
+
+typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
+	obs_source_t *child, void *param);
+
+struct obs_source_info {
+	const char                     *id;
+	enum obs_source_type           type;
+	uint32_t                       output_flags;
+
+	const char *(*get_name)(void *type_data);
+	void *(*create)(obs_data_t *settings, obs_source_t *source);
+	void (*destroy)(void *data);
+	uint32_t (*get_width)(void *data);
+	uint32_t (*get_height)(void *data);
+	void (*get_defaults)(obs_data_t *settings);
+	obs_properties_t *(*get_properties)(void *data);
+	void (*update)(void *data, obs_data_t *settings);
+	void (*activate)(void *data);
+	void (*deactivate)(void *data);
+	void (*show)(void *data);
+	void (*hide)(void *data);
+	void (*video_tick)(void *data, float seconds);
+	void (*video_render)(void *data, gs_effect_t *effect);
+	struct obs_source_frame *(*filter_video)(void *data,
+		struct obs_source_frame *frame);
+	void (*enum_active_sources)(void *data,
+		obs_source_enum_proc_t enum_callback, void *param);
+	void (*filter_remove)(void *data, obs_source_t *source);
+};
+
+extern void obs_register_source_s(const struct obs_source_info *info,
+	size_t size);
+
+#define obs_register_source(info) \
+	obs_register_source_s(info, sizeof(struct obs_source_info))
+
+extern obs_source_t *obs_source_create(const char *id, const char *name,
+	obs_data_t *settings, obs_data_t *hotkey_data);
+extern obs_source_t *obs_source_get_ref(obs_source_t *source);
+extern void obs_source_release(obs_source_t *source);
+extern obs_weak_source_t *obs_source_get_weak_source(obs_source_t *source);
+extern obs_source_t *obs_weak_source_get_source(obs_weak_source_t *weak);
+extern void obs_weak_source_release(obs_weak_source_t *weak);
+extern bool obs_weak_source_references_source(obs_weak_source_t *weak,
+	obs_source_t *source);
+
+extern void *obs_obj_get_data(void *obj);
+extern const char *obs_source_get_id(const obs_source_t *source);
+extern enum obs_source_type obs_source_get_type(const obs_source_t *source);
+extern const char *obs_source_get_name(const obs_source_t *source);
+extern uint32_t obs_source_get_output_flags(const obs_source_t *source);
+extern uint32_t obs_source_get_width(obs_source_t *source);
+extern uint32_t obs_source_get_height(obs_source_t *source);
+extern uint32_t obs_source_get_base_width(obs_source_t *source);
+extern uint32_t obs_source_get_base_height(obs_source_t *source);
+extern obs_data_t *obs_source_get_settings(const obs_source_t *source);
+extern void obs_source_update(obs_source_t *source, obs_data_t *settings);
+extern void obs_source_update_properties(obs_source_t *source);
+extern obs_properties_t *obs_source_properties(const obs_source_t *source);
+extern proc_handler_t *obs_source_get_proc_handler(
+	const obs_source_t *source);
+extern enum obs_deinterlace_mode obs_source_get_deinterlace_mode(
+	const obs_source_t *source);
+extern void obs_source_inc_showing(obs_source_t *source);
+extern void obs_source_dec_showing(obs_source_t *source);
+extern void obs_source_video_render(obs_source_t *source);
+
+extern void obs_source_filter_add(obs_source_t *source, obs_source_t *filter);
+extern void obs_source_filter_remove(obs_source_t *source,
+	obs_source_t *filter);
+extern void obs_source_enum_filters(obs_source_t *source,
+	obs_source_enum_proc_t callback, void *param);
+extern obs_source_t *obs_filter_get_parent(const obs_source_t *filter);
+extern obs_source_t *obs_filter_get_target(const obs_source_t *filter);
+
+extern bool obs_source_process_filter_begin(obs_source_t *filter,
+	enum gs_color_format format,
+	enum obs_allow_direct_render allow_direct);
+extern void obs_source_process_filter_end(obs_source_t *filter,
+	gs_effect_t *effect, uint32_t width, uint32_t height);
+extern void obs_source_process_filter_tech_end(obs_source_t *filter,
+	gs_effect_t *effect, uint32_t width, uint32_t height,
+	const char *tech_name);
+extern void obs_source_skip_video_filter(obs_source_t *filter);
+
+extern struct obs_source_frame *obs_source_frame_create(
+	enum video_format format, uint32_t width, uint32_t height);
+extern void obs_source_frame_destroy(struct obs_source_frame *frame);
+extern void obs_source_release_frame(obs_source_t *source,
+	struct obs_source_frame *frame);
+extern void obs_source_output_video(obs_source_t *source,
+	const struct obs_source_frame *frame);
+
+/* core */
+
+extern obs_source_t *obs_get_source_by_name(const char *name);
+extern void obs_enum_sources(bool (*enum_proc)(void *, obs_source_t *),
+	void *param);
+extern proc_handler_t *obs_get_proc_handler(void);
+extern void obs_add_tick_callback(void (*tick)(void *param, float seconds),
+	void *param);
+extern void obs_remove_tick_callback(
+	void (*tick)(void *param, float seconds), void *param);
+extern bool obs_get_video_info(struct obs_video_info *ovi);
+extern uint64_t obs_get_video_frame_time(void);
+extern gs_effect_t *obs_get_base_effect(enum obs_base_effect effect);
+
+extern void obs_enter_graphics(void);
+extern void obs_leave_graphics(void);
@@ -0,0 +1,408 @@
+#include <string.h>
+#include <util/darray.h>
+#include "obs-stub.h"
+
+/*
+ * Property lists, kept the way libobs keeps them: properties in the order
+ * they were added, names unique within a list, list items with either a
+ * string or an integer value.  Nothing is shown anywhere.
+ */
+
+struct list_item {
+	char                           *name;
+	char                           *str;
+	long long                      val;
+};
+
+struct obs_property {
+	char                           *name;
+	char                           *desc;
+	enum obs_property_type         type;
+	bool                           visible;
+	bool                           enabled;
+
+	obs_properties_t               *parent;
+	obs_property_modified_t        modified;
+	obs_property_clicked_t         clicked;
+
+	enum obs_combo_format          format;
+	DARRAY(struct list_item)       items;
+
+	struct obs_property            *next;
+};
+
+struct obs_properties {
+	void                           *param;
+	void                           (*destroy)(void *param);
+
+	struct obs_property            *first;
+	struct obs_property            **last;
+};
+
+
+obs_properties_t *obs_properties_create(void)
+{
+	struct obs_properties *props = bzalloc(sizeof(*props));
+
+	props->last = &props->first;
+	return props;
+}
+
+
+static void list_item_free(struct list_item *item)
+{
+	bfree(item->name);
+	bfree(item->str);
+}
+
+
+static void property_destroy(struct obs_property *p)
+{
+	for (size_t i = 0; i < p->items.num; i++)
+		list_item_free(&p->items.array[i]);
+
+	da_free(p->items);
+	bfree(p->name);
+	bfree(p->desc);
+	bfree(p);
+}
+
+
+void obs_properties_destroy(obs_properties_t *props)
+{
+	struct obs_property *p;
+
+	if (!props)
+		return;
+
+	if (props->destroy && props->param)
+		props->destroy(props->param);
+
+	p = props->first;
+	while (p) {
+		struct obs_property *next = p->next;
+
+		property_destroy(p);
+		p = next;
+	}
+
+	bfree(props);
+}
+
+
+void obs_properties_set_param(obs_properties_t *props, void *param,
+	void (*destroy)(void *param))
+{
+	if (!props)
+		return;
+
+	if (props->destroy && props->param)
+		props->destroy(props->param);
+
+	props->param = param;
+	props->destroy = destroy;
+}
+
+
+void *obs_properties_get_param(obs_properties_t *props)
+{
+	return props ? props->param : NULL;
+}
+
+
+obs_property_t *obs_properties_first(obs_properties_t *props)
+{
+	return props ? props->first : NULL;
+}
+
+
+obs_property_t *obs_properties_get(obs_properties_t *props,
+	const char *property)
+{
+	if (!props || !property)
+		return NULL;
+
+	for (struct obs_property *p = props->first; p; p = p->next)
+		if (strcmp(p->name, property) == 0)
+			return p;
+
+	return NULL;
+}
+
+
+/* NULL if the name is taken, as in libobs. */
+static struct obs_property *property_add(obs_properties_t *props,
+	const char *name, const char *desc, enum obs_property_type type)
+{
+	struct obs_property *p;
+
+	if (!props || obs_properties_get(props, name))
+		return NULL;
+
+	p = bzalloc(sizeof(*p));
+	p->name = bstrdup(name);
+	p->desc = bstrdup(desc);
+	p->type = type;
+	p->visible = true;
+	p->enabled = true;
+	p->parent = props;
+
+	*props->last = p;
+	props->last = &p->next;
+	return p;
+}
+
+
+obs_property_t *obs_properties_add_bool(obs_properties_t *props,
+	const char *name, const char *description)
+{
+	return property_add(props, name, description, OBS_PROPERTY_BOOL);
+}
+
+
+obs_property_t *obs_properties_add_int_slider(obs_properties_t *props,
+	const char *name, const char *description, int min, int max,
+	int step)
+{
+	UNUSED_PARAMETER(min);
+	UNUSED_PARAMETER(max);
+	UNUSED_PARAMETER(step);
+	return property_add(props, name, description, OBS_PROPERTY_INT);
+}
+
+
+obs_property_t *obs_properties_add_float_slider(obs_properties_t *props,
+	const char *name, const char *description, double min, double max,
+	double step)
+{
+	UNUSED_PARAMETER(min);
+	UNUSED_PARAMETER(max);
+	UNUSED_PARAMETER(step);
+	return property_add(props, name, description, OBS_PROPERTY_FLOAT);
+}
+
+
+obs_property_t *obs_properties_add_text(obs_properties_t *props,
+	const char *name, const char *description, enum obs_text_type type)
+{
+	UNUSED_PARAMETER(type);
+	return property_add(props, name, description, OBS_PROPERTY_TEXT);
+}
+
+
+obs_property_t *obs_properties_add_list(obs_properties_t *props,
+	const char *name, const char *description, enum obs_combo_type type,
+	enum obs_combo_format format)
+{
+	struct obs_property *p = property_add(props, name, description,
+		OBS_PROPERTY_LIST);
+
+	if (p)
+		p->format = format;
+
+	UNUSED_PARAMETER(type);
+	return p;
+}
+
+
+obs_property_t *obs_properties_add_button(obs_properties_t *props,
+	const char *name, const char *text, obs_property_clicked_t callback)
+{
+	struct obs_property *p = property_add(props, name, text,
+		OBS_PROPERTY_BUTTON);
+
+	if (p)
+		p->clicked = callback;
+	return p;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+bool obs_property_next(obs_property_t **p)
+{
+	if (!p || !*p)
+		return false;
+
+	*p = (*p)->next;
+	return *p != NULL;
+}
+
+
+const char *obs_property_name(obs_property_t *p)
+{
+	return p ? p->name : NULL;
+}
+
+
+const char *obs_property_description(obs_property_t *p)
+{
+	return p ? p->desc : NULL;
+}
+
+
+enum obs_property_type obs_property_get_type(obs_property_t *p)
+{
+	return p ? p->type : OBS_PROPERTY_INVALID;
+}
+
+
+bool obs_property_visible(obs_property_t *p)
+{
+	return p ? p->visible : false;
+}
+
+
+bool obs_property_enabled(obs_property_t *p)
+{
+	return p ? p->enabled : false;
+}
+
+
+/* What the UI does when the value changes; true if the list has to be
+ * refreshed. */
+bool obs_property_modified(obs_property_t *p, obs_data_t *settings)
+{
+	if (!p || !p->modified)
+		return false;
+
+	return p->modified(p->parent, p, settings);
+}
+
+
+bool obs_property_button_clicked(obs_property_t *p, void *obj)
+{
+	if (!p || !p->clicked)
+		return false;
+
+	return p->clicked(p->parent, p, obj);
+}
+
+
+void obs_property_set_modified_callback(obs_property_t *p,
+	obs_property_modified_t modified)
+{
+	if (p)
+		p->modified = modified;
+}
+
+
+void obs_property_set_visible(obs_property_t *p, bool visible)
+{
+	if (p)
+		p->visible = visible;
+}
+
+
+void obs_property_set_enabled(obs_property_t *p, bool enabled)
+{
+	if (p)
+		p->enabled = enabled;
+}
+
+
+void obs_property_int_set_suffix(obs_property_t *p, const char *suffix)
+{
+	UNUSED_PARAMETER(p);
+	UNUSED_PARAMETER(suffix);
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+static bool list_valid(obs_property_t *p, enum obs_combo_format format)
+{
+	return p && p->type == OBS_PROPERTY_LIST && p->format == format;
+}
+
+
+size_t obs_property_list_add_string(obs_property_t *p, const char *name,
+	const char *val)
+{
+	struct list_item item = {0};
+
+	if (!list_valid(p, OBS_COMBO_FORMAT_STRING))
+		return 0;
+
+	item.name = bstrdup(name);
+	item.str = bstrdup(val);
+	return da_push_back(p->items, &item);
+}
+
+
+size_t obs_property_list_add_int(obs_property_t *p, const char *name,
+	long long val)
+{
+	struct list_item item = {0};
+
+	if (!list_valid(p, OBS_COMBO_FORMAT_INT))
+		return 0;
+
+	item.name = bstrdup(name);
+	item.val = val;
+	return da_push_back(p->items, &item);
+}
+
+
+void obs_property_list_insert_string(obs_property_t *p, size_t idx,
+	const char *name, const char *val)
+{
+	struct list_item *items;
+
+	if (!list_valid(p, OBS_COMBO_FORMAT_STRING) || idx > p->items.num)
+		return;
+
+	da_push_back_new(p->items);
+	items = p->items.array;
+	memmove(&items[idx + 1], &items[idx],
+		(p->items.num - 1 - idx) * sizeof(*items));
+
+	memset(&items[idx], 0, sizeof(*items));
+	items[idx].name = bstrdup(name);
+	items[idx].str = bstrdup(val);
+}
+
+
+void obs_property_list_item_remove(obs_property_t *p, size_t idx)
+{
+	if (!p || idx >= p->items.num)
+		return;
+
+	list_item_free(&p->items.array[idx]);
+	da_erase(p->items, idx);
+}
+
+
+void obs_property_list_clear(obs_property_t *p)
+{
+	if (!p)
+		return;
+
+	for (size_t i = 0; i < p->items.num; i++)
+		list_item_free(&p->items.array[i]);
+	da_clear(p->items);
+}
+
+
+size_t obs_property_list_item_count(obs_property_t *p)
+{
+	return p ? p->items.num : 0;
+}
+
+
+const char *obs_property_list_item_name(obs_property_t *p, size_t idx)
+{
+	return p && idx < p->items.num ? p->items.array[idx].name : NULL;
+}
+
+
+const char *obs_property_list_item_string(obs_property_t *p, size_t idx)
+{
+	return p && idx < p->items.num ? p->items.array[idx].str : NULL;
+}
+
+
+long long obs_property_list_item_int(obs_property_t *p, size_t idx)
+{
+	return p && idx < p->items.num ? p->items.array[idx].val : 0;
+}
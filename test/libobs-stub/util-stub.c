@@ -0,0 +1,635 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <util/base.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <callback/proc.h>
+
+/*
+ * libobs' utility layer, on plain libc and pthreads: memory with an
+ * allocation count for leak checks, logging, strings, files, events,
+ * calldata and proc handlers.
+ */
+
+int stub_log_level = LOG_WARNING;
+
+static volatile long num_allocs;
+
+
+void *bmalloc(size_t size)
+{
+	void *ptr = malloc(size ? size : 1);
+
+	if (!ptr) {
+		fprintf(stderr, "out of memory allocating %zu bytes\n", size);
+		abort();
+	}
+
+	os_atomic_inc_long(&num_allocs);
+	return ptr;
+}
+
+
+void *brealloc(void *ptr, size_t size)
+{
+	if (!ptr)
+		os_atomic_inc_long(&num_allocs);
+
+	ptr = realloc(ptr, size ? size : 1);
+	if (!ptr) {
+		fprintf(stderr, "out of memory allocating %zu bytes\n", size);
+		abort();
+	}
+
+	return ptr;
+}
+
+
+void bfree(void *ptr)
+{
+	if (ptr) {
+		os_atomic_dec_long(&num_allocs);
+		free(ptr);
+	}
+}
+
+
+long bnum_allocs(void)
+{
+	return os_atomic_load_long(&num_allocs);
+}
+
+
+void blog(int log_level, const char *format, ...)
+{
+	va_list args;
+
+	if (log_level > stub_log_level)
+		return;
+
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	fputc('\n', stderr);
+	va_end(args);
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+void dstr_free(struct dstr *dst)
+{
+	bfree(dst->array);
+	dstr_init(dst);
+}
+
+
+static void dstr_ensure_capacity(struct dstr *dst, size_t size)
+{
+	size_t capacity;
+
+	if (size <= dst->capacity)
+		return;
+
+	capacity = dst->capacity ? dst->capacity * 2 : size;
+	if (capacity < size)
+		capacity = size;
+
+	dst->array = brealloc(dst->array, capacity);
+	dst->capacity = capacity;
+}
+
+
+void dstr_ncat(struct dstr *dst, const char *array, const size_t len)
+{
+	if (!array || !*array || !len)
+		return;
+
+	dstr_ensure_capacity(dst, dst->len + len + 1);
+	memcpy(dst->array + dst->len, array, len);
+	dst->len += len;
+	dst->array[dst->len] = 0;
+}
+
+
+void dstr_cat(struct dstr *dst, const char *array)
+{
+	if (array)
+		dstr_ncat(dst, array, strlen(array));
+}
+
+
+void dstr_cat_ch(struct dstr *dst, char ch)
+{
+	dstr_ensure_capacity(dst, dst->len + 2);
+	dst->array[dst->len++] = ch;
+	dst->array[dst->len] = 0;
+}
+
+
+void dstr_copy(struct dstr *dst, const char *array)
+{
+	if (dst->array)
+		dst->array[0] = 0;
+	dst->len = 0;
+	dstr_cat(dst, array);
+}
+
+
+void dstr_vcatf(struct dstr *dst, const char *format, va_list args)
+{
+	va_list copy;
+	int len;
+
+	va_copy(copy, args);
+	len = vsnprintf(NULL, 0, format, copy);
+	va_end(copy);
+
+	if (len <= 0)
+		return;
+
+	dstr_ensure_capacity(dst, dst->len + (size_t)len + 1);
+	vsnprintf(dst->array + dst->len, (size_t)len + 1, format, args);
+	dst->len += (size_t)len;
+}
+
+
+void dstr_catf(struct dstr *dst, const char *format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+	dstr_vcatf(dst, format, args);
+	va_end(args);
+}
+
+
+void dstr_printf(struct dstr *dst, const char *format, ...)
+{
+	va_list args;
+
+	dstr_copy(dst, NULL);
+
+	va_start(args, format);
+	dstr_vcatf(dst, format, args);
+	va_end(args);
+}
+
+
+void dstr_depad(struct dstr *dst)
+{
+	size_t start = 0;
+
+	if (!dst->array)
+		return;
+
+	while (dst->len && strchr(" \t\r\n", dst->array[dst->len - 1]))
+		dst->array[--dst->len] = 0;
+	while (start < dst->len && strchr(" \t\r\n", dst->array[start]))
+		start++;
+
+	if (start) {
+		dst->len -= start;
+		memmove(dst->array, dst->array + start, dst->len + 1);
+	}
+}
+
+
+int astrcmpi(const char *str1, const char *str2)
+{
+	if (!str1)
+		str1 = "";
+	if (!str2)
+		str2 = "";
+
+	return strcasecmp(str1, str2);
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+FILE *os_fopen(const char *path, const char *mode)
+{
+	return path ? fopen(path, mode) : NULL;
+}
+
+
+char *os_quick_read_utf8_file(const char *path)
+{
+	FILE *f = os_fopen(path, "rb");
+	char *str;
+	long size;
+	size_t offset = 0;
+
+	if (!f)
+		return NULL;
+
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	if (size < 0) {
+		fclose(f);
+		return NULL;
+	}
+
+	str = bmalloc((size_t)size + 1);
+	size = (long)fread(str, 1, (size_t)size, f);
+	str[size] = 0;
+	fclose(f);
+
+	/* libobs drops the byte order mark */
+	if (size >= 3 && memcmp(str, "\xEF\xBB\xBF", 3) == 0)
+		offset = 3;
+	if (offset)
+		memmove(str, str + offset, (size_t)size - offset + 1);
+
+	return str;
+}
+
+
+/* Writes to path.temp_ext, then renames it over path; backups are not
+ * kept. */
+bool os_quick_write_utf8_file_safe(const char *path, const char *str,
+	size_t len, bool marker, const char *temp_ext,
+	const char *backup_ext)
+{
+	struct dstr temp = {0};
+	bool success = false;
+	FILE *f;
+
+	if (!path || !temp_ext)
+		return false;
+
+	dstr_printf(&temp, "%s%s%s", path, *temp_ext == '.' ? "" : ".",
+		temp_ext);
+
+	f = os_fopen(temp.array, "wb");
+	if (f) {
+		success = (!marker || fwrite("\xEF\xBB\xBF", 3, 1, f) == 1) &&
+			(!len || fwrite(str, len, 1, f) == 1);
+		success = fclose(f) == 0 && success;
+	}
+
+	if (success)
+		success = rename(temp.array, path) == 0;
+	else
+		unlink(temp.array);
+
+	dstr_free(&temp);
+	UNUSED_PARAMETER(backup_ext);
+	return success;
+}
+
+
+int os_mkdirs(const char *path)
+{
+	struct dstr dir = {0};
+	int ret = 0;
+
+	dstr_copy(&dir, path);
+
+	for (char *p = dir.array ? dir.array + 1 : NULL; p && ret == 0; p++) {
+		bool end = !*p;
+
+		if (*p != '/' && !end)
+			continue;
+
+		*p = 0;
+		if (mkdir(dir.array, 0755) != 0 && errno != EEXIST)
+			ret = -1;
+		if (end)
+			break;
+		*p = '/';
+	}
+
+	dstr_free(&dir);
+	return ret;
+}
+
+
+int os_unlink(const char *path)
+{
+	return unlink(path);
+}
+
+
+bool os_file_exists(const char *path)
+{
+	return path && access(path, F_OK) == 0;
+}
+
+
+uint64_t os_gettime_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+void os_sleep_ms(uint32_t duration)
+{
+	usleep(duration * 1000);
+}
+
+
+int os_get_logical_cores(void)
+{
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return cores > 0 ? (int)cores : 1;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+struct os_event_data {
+	pthread_mutex_t                mutex;
+	pthread_cond_t                 cond;
+	volatile bool                  signalled;
+	bool                           manual;
+};
+
+
+int os_event_init(os_event_t **event, enum os_event_type type)
+{
+	struct os_event_data *data = bzalloc(sizeof(*data));
+
+	pthread_mutex_init(&data->mutex, NULL);
+	pthread_cond_init(&data->cond, NULL);
+	data->manual = type == OS_EVENT_TYPE_MANUAL;
+
+	*event = data;
+	return 0;
+}
+
+
+void os_event_destroy(os_event_t *event)
+{
+	if (!event)
+		return;
+
+	pthread_mutex_destroy(&event->mutex);
+	pthread_cond_destroy(&event->cond);
+	bfree(event);
+}
+
+
+int os_event_wait(os_event_t *event)
+{
+	pthread_mutex_lock(&event->mutex);
+	while (!event->signalled)
+		pthread_cond_wait(&event->cond, &event->mutex);
+	if (!event->manual)
+		event->signalled = false;
+	pthread_mutex_unlock(&event->mutex);
+
+	return 0;
+}
+
+
+int os_event_timedwait(os_event_t *event, unsigned long milliseconds)
+{
+	struct timespec ts;
+	int code = 0;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += (time_t)(milliseconds / 1000);
+	ts.tv_nsec += (long)(milliseconds % 1000) * 1000000;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(&event->mutex);
+	while (!event->signalled && code == 0)
+		code = pthread_cond_timedwait(&event->cond, &event->mutex, &ts);
+	if (event->signalled) {
+		if (!event->manual)
+			event->signalled = false;
+		code = 0;
+	}
+	pthread_mutex_unlock(&event->mutex);
+
+	return code;
+}
+
+
+int os_event_try(os_event_t *event)
+{
+	int ret = EAGAIN;
+
+	pthread_mutex_lock(&event->mutex);
+	if (event->signalled) {
+		if (!event->manual)
+			event->signalled = false;
+		ret = 0;
+	}
+	pthread_mutex_unlock(&event->mutex);
+
+	return ret;
+}
+
+
+int os_event_signal(os_event_t *event)
+{
+	pthread_mutex_lock(&event->mutex);
+	event->signalled = true;
+	pthread_cond_signal(&event->cond);
+	pthread_mutex_unlock(&event->mutex);
+
+	return 0;
+}
+
+
+void os_event_reset(os_event_t *event)
+{
+	pthread_mutex_lock(&event->mutex);
+	event->signalled = false;
+	pthread_mutex_unlock(&event->mutex);
+}
+
+
+void os_set_thread_name(const char *name)
+{
+	UNUSED_PARAMETER(name);
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+struct calldata_item {
+	char                           *name;
+	char                           *str;
+	long long                      val;
+};
+
+
+void calldata_free(calldata_t *data)
+{
+	for (size_t i = 0; i < data->num; i++) {
+		bfree(data->items[i].name);
+		bfree(data->items[i].str);
+	}
+
+	bfree(data->items);
+	calldata_init(data);
+}
+
+
+static struct calldata_item *calldata_find(const calldata_t *data,
+	const char *name)
+{
+	for (size_t i = 0; i < data->num; i++)
+		if (strcmp(data->items[i].name, name) == 0)
+			return &data->items[i];
+
+	return NULL;
+}
+
+
+static struct calldata_item *calldata_item_get(calldata_t *data,
+	const char *name)
+{
+	struct calldata_item *item = calldata_find(data, name);
+
+	if (item)
+		return item;
+
+	if (data->num == data->capacity) {
+		data->capacity = data->capacity ? data->capacity * 2 : 4;
+		data->items = brealloc(data->items,
+			data->capacity * sizeof(*data->items));
+	}
+
+	item = &data->items[data->num++];
+	memset(item, 0, sizeof(*item));
+	item->name = bstrdup(name);
+	return item;
+}
+
+
+void calldata_set_int(calldata_t *data, const char *name, long long val)
+{
+	calldata_item_get(data, name)->val = val;
+}
+
+
+void calldata_set_string(calldata_t *data, const char *name,
+	const char *str)
+{
+	struct calldata_item *item = calldata_item_get(data, name);
+
+	bfree(item->str);
+	item->str = bstrdup(str);
+}
+
+
+long long calldata_int(const calldata_t *data, const char *name)
+{
+	struct calldata_item *item = calldata_find(data, name);
+
+	return item ? item->val : 0;
+}
+
+
+const char *calldata_string(const calldata_t *data, const char *name)
+{
+	struct calldata_item *item = calldata_find(data, name);
+
+	return item ? item->str : NULL;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+struct proc_info {
+	char                           *name;
+	proc_handler_proc_t            proc;
+	void                           *data;
+};
+
+struct proc_handler {
+	pthread_mutex_t                mutex;
+	DARRAY(struct proc_info)       procs;
+};
+
+
+proc_handler_t *proc_handler_create(void)
+{
+	struct proc_handler *handler = bzalloc(sizeof(*handler));
+
+	pthread_mutex_init(&handler->mutex, NULL);
+	return handler;
+}
+
+
+void proc_handler_destroy(proc_handler_t *handler)
+{
+	if (!handler)
+		return;
+
+	for (size_t i = 0; i < handler->procs.num; i++)
+		bfree(handler->procs.array[i].name);
+	da_free(handler->procs);
+	pthread_mutex_destroy(&handler->mutex);
+	bfree(handler);
+}
+
+
+/* "void name(in string a, out int b)" is registered as "name". */
+void proc_handler_add(proc_handler_t *handler, const char *decl_string,
+	proc_handler_proc_t proc, void *data)
+{
+	const char *end = strchr(decl_string, '(');
+	const char *start = end;
+	struct proc_info info = {0};
+
+	if (!handler || !end)
+		return;
+
+	while (start > decl_string && start[-1] != ' ')
+		start--;
+
+	info.name = bstrdup_n(start, (size_t)(end - start));
+	info.proc = proc;
+	info.data = data;
+
+	pthread_mutex_lock(&handler->mutex);
+	da_push_back(handler->procs, &info);
+	pthread_mutex_unlock(&handler->mutex);
+}
+
+
+bool proc_handler_call(proc_handler_t *handler, const char *name,
+	calldata_t *params)
+{
+	struct proc_info info = {0};
+
+	if (!handler)
+		return false;
+
+	pthread_mutex_lock(&handler->mutex);
+	for (size_t i = 0; i < handler->procs.num; i++) {
+		if (strcmp(handler->procs.array[i].name, name) == 0) {
+			info = handler->procs.array[i];
+			break;
+		}
+	}
+	pthread_mutex_unlock(&handler->mutex);
+
+	if (!info.proc)
+		return false;
+
+	info.proc(info.data, params);
+	return true;
+}
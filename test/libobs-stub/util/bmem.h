@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string.h>
+#include "c99defs.h"
+
+extern void *bmalloc(size_t size);
+extern void *brealloc(void *ptr, size_t size);
+extern void bfree(void *ptr);
+extern long bnum_allocs(void);
+
+static inline void *bzalloc(size_t size)
+{
+	void *mem = bmalloc(size);
+	if (mem)
+		memset(mem, 0, size);
+	return mem;
+}
+
+static inline void *bmemdup(const void *ptr, size_t size)
+{
+	void *out = bmalloc(size);
+	if (size)
+		memcpy(out, ptr, size);
+
+	return out;
+}
+
+static inline char *bstrdup_n(const char *str, size_t n)
+{
+	char *dup;
+	if (!str)
+		return NULL;
+
+	dup = (char *)bmalloc(n + 1);
+	memcpy(dup, str, n);
+	dup[n] = 0;
+	return dup;
+}
+
+static inline char *bstrdup(const char *str)
+{
+	if (!str)
+		return NULL;
+
+	return bstrdup_n(str, strlen(str));
+}
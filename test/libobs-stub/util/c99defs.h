@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define UNUSED_PARAMETER(param) (void)param
+
+#define EXPORT
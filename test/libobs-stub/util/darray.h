@@ -0,0 +1,170 @@
+#pragma once
+
+#include "bmem.h"
+
+/*
+ * The subset of libobs' dynamic arrays the module uses, with the same
+ * layout and semantics.
+ */
+
+#define DARRAY_INVALID ((size_t)-1)
+
+struct darray {
+	void                           *array;
+	size_t                         num;
+	size_t                         capacity;
+};
+
+static inline void *darray_item(const size_t element_size,
+	const struct darray *da, size_t idx)
+{
+	return (void *)(((uint8_t *)da->array) + element_size * idx);
+}
+
+static inline void darray_reserve(const size_t element_size,
+	struct darray *dst, const size_t capacity)
+{
+	void *ptr;
+	if (capacity == 0 || capacity <= dst->capacity)
+		return;
+
+	/* num may already count the item being added */
+	ptr = bmalloc(element_size * capacity);
+	if (dst->array) {
+		size_t num = dst->num < dst->capacity ? dst->num : dst->capacity;
+
+		if (num)
+			memcpy(ptr, dst->array, element_size * num);
+		bfree(dst->array);
+	}
+	dst->array = ptr;
+	dst->capacity = capacity;
+}
+
+static inline void darray_ensure_capacity(const size_t element_size,
+	struct darray *dst, const size_t new_size)
+{
+	size_t new_cap;
+	if (new_size <= dst->capacity)
+		return;
+
+	new_cap = (!dst->capacity) ? new_size : dst->capacity * 2;
+	if (new_size > new_cap)
+		new_cap = new_size;
+
+	darray_reserve(element_size, dst, new_cap);
+}
+
+static inline void darray_resize(const size_t element_size,
+	struct darray *dst, const size_t size)
+{
+	if (size == dst->num)
+		return;
+
+	darray_ensure_capacity(element_size, dst, size);
+	if (size > dst->num)
+		memset(darray_item(element_size, dst, dst->num), 0,
+			element_size * (size - dst->num));
+	dst->num = size;
+}
+
+static inline void darray_copy(const size_t element_size, struct darray *dst,
+	const struct darray *da)
+{
+	if (da->num == 0) {
+		dst->num = 0;
+		return;
+	}
+
+	darray_resize(element_size, dst, da->num);
+	memcpy(dst->array, da->array, element_size * da->num);
+}
+
+static inline size_t darray_push_back(const size_t element_size,
+	struct darray *dst, const void *item)
+{
+	darray_ensure_capacity(element_size, dst, ++dst->num);
+	memcpy(darray_item(element_size, dst, dst->num - 1), item,
+		element_size);
+
+	return dst->num - 1;
+}
+
+static inline void *darray_push_back_new(const size_t element_size,
+	struct darray *dst)
+{
+	void *last;
+
+	darray_ensure_capacity(element_size, dst, ++dst->num);
+
+	last = darray_item(element_size, dst, dst->num - 1);
+	memset(last, 0, element_size);
+	return last;
+}
+
+static inline size_t darray_find(const size_t element_size,
+	const struct darray *da, const void *item, const size_t idx)
+{
+	for (size_t i = idx; i < da->num; i++) {
+		void *compare = darray_item(element_size, da, i);
+		if (memcmp(compare, item, element_size) == 0)
+			return i;
+	}
+
+	return DARRAY_INVALID;
+}
+
+static inline void darray_erase(const size_t element_size, struct darray *dst,
+	const size_t idx)
+{
+	if (idx >= dst->num || !--dst->num)
+		return;
+
+	memmove(darray_item(element_size, dst, idx),
+		darray_item(element_size, dst, idx + 1),
+		element_size * (dst->num - idx));
+}
+
+#define DARRAY(type)                     \
+	union {                          \
+		struct darray da;        \
+		struct {                 \
+			type *array;     \
+			size_t num;      \
+			size_t capacity; \
+		};                       \
+	}
+
+#define da_init(v) memset(&(v), 0, sizeof(v))
+
+#define da_free(v)                         \
+	do {                               \
+		bfree((v).da.array);       \
+		memset(&(v), 0, sizeof(v)); \
+	} while (false)
+
+#define da_end(v) ((v).num ? (v).array + ((v).num - 1) : NULL)
+
+#define da_reserve(v, capacity) \
+	darray_reserve(sizeof(*(v).array), &(v).da, capacity)
+
+#define da_resize(v, size) darray_resize(sizeof(*(v).array), &(v).da, size)
+
+#define da_copy(dst, src) \
+	darray_copy(sizeof(*(dst).array), &(dst).da, &(src).da)
+
+#define da_push_back(v, item) \
+	darray_push_back(sizeof(*(v).array), &(v).da, item)
+
+#define da_push_back_new(v) darray_push_back_new(sizeof(*(v).array), &(v).da)
+
+#define da_find(v, item, idx) \
+	darray_find(sizeof(*(v).array), &(v).da, item, idx)
+
+#define da_erase(v, idx) darray_erase(sizeof(*(v).array), &(v).da, idx)
+
+#define da_erase_item(v, item) da_erase(v, da_find(v, item, 0))
+
+#define da_clear(v) ((v).num = 0)
+
+#define da_pop_back(v) ((v).num ? (void)(v).num-- : (void)0)
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdarg.h>
+#include "c99defs.h"
+
+struct dstr {
+	char                           *array;
+	size_t                         len;
+	size_t                         capacity;
+};
+
+static inline void dstr_init(struct dstr *dst)
+{
+	dst->array = NULL;
+	dst->len = 0;
+	dst->capacity = 0;
+}
+
+static inline bool dstr_is_empty(const struct dstr *str)
+{
+	return !str->array || !str->len || !*str->array;
+}
+
+extern void dstr_free(struct dstr *dst);
+extern void dstr_copy(struct dstr *dst, const char *array);
+extern void dstr_ncat(struct dstr *dst, const char *array, const size_t len);
+extern void dstr_cat(struct dstr *dst, const char *array);
+extern void dstr_cat_ch(struct dstr *dst, char ch);
+extern void dstr_printf(struct dstr *dst, const char *format, ...);
+extern void dstr_catf(struct dstr *dst, const char *format, ...);
+extern void dstr_vcatf(struct dstr *dst, const char *format, va_list args);
+extern void dstr_depad(struct dstr *dst);
+
+extern int astrcmpi(const char *str1, const char *str2);
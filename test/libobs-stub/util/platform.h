@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdio.h>
+#include "c99defs.h"
+
+extern FILE *os_fopen(const char *path, const char *mode);
+extern char *os_quick_read_utf8_file(const char *path);
+extern bool os_quick_write_utf8_file_safe(const char *path, const char *str,
+	size_t len, bool marker, const char *temp_ext,
+	const char *backup_ext);
+
+extern int os_mkdirs(const char *path);
+extern int os_unlink(const char *path);
+extern bool os_file_exists(const char *path);
+
+extern uint64_t os_gettime_ns(void);
+extern void os_sleep_ms(uint32_t duration);
+extern int os_get_logical_cores(void);
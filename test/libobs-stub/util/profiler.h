@@ -0,0 +1,14 @@
+#pragma once
+
+#include "c99defs.h"
+
+/* the stub does not profile */
+static inline void profile_start(const char *name)
+{
+	UNUSED_PARAMETER(name);
+}
+
+static inline void profile_end(const char *name)
+{
+	UNUSED_PARAMETER(name);
+}
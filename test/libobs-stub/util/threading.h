@@ -0,0 +1,58 @@
+#pragma once
+
+#include <pthread.h>
+#include "c99defs.h"
+
+struct os_event_data;
+typedef struct os_event_data os_event_t;
+
+enum os_event_type {
+	OS_EVENT_TYPE_AUTO,
+	OS_EVENT_TYPE_MANUAL
+};
+
+extern int os_event_init(os_event_t **event, enum os_event_type type);
+extern void os_event_destroy(os_event_t *event);
+extern int os_event_wait(os_event_t *event);
+extern int os_event_timedwait(os_event_t *event, unsigned long milliseconds);
+extern int os_event_try(os_event_t *event);
+extern int os_event_signal(os_event_t *event);
+extern void os_event_reset(os_event_t *event);
+
+extern void os_set_thread_name(const char *name);
+
+/* libobs' atomics are all sequentially consistent */
+static inline long os_atomic_inc_long(volatile long *val)
+{
+	return __atomic_add_fetch(val, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline long os_atomic_dec_long(volatile long *val)
+{
+	return __atomic_sub_fetch(val, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline void os_atomic_set_long(volatile long *ptr, long val)
+{
+	__atomic_store_n(ptr, val, __ATOMIC_SEQ_CST);
+}
+
+static inline long os_atomic_load_long(const volatile long *ptr)
+{
+	return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+
+static inline long os_atomic_exchange_long(volatile long *ptr, long val)
+{
+	return __atomic_exchange_n(ptr, val, __ATOMIC_SEQ_CST);
+}
+
+static inline bool os_atomic_set_bool(volatile bool *ptr, bool val)
+{
+	return __atomic_exchange_n(ptr, val, __ATOMIC_SEQ_CST);
+}
+
+static inline bool os_atomic_load_bool(const volatile bool *ptr)
+{
+	return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}